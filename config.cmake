@@ -17,6 +17,9 @@ set(TASK2_LOG_LEVEL 3)
 
 # 是否在实验三复活，ON或OFF
 set(TASK3_REVIVE ON)
+# 实验三是否支持分层执行（task3 -tier），ON或OFF。分层执行要用实验四的源码，
+# 打开后 task3 不能单独打包提交
+set(TASK3_TIER OFF)
 
 # 是否在实验四复活，ON或OFF
 set(TASK4_REVIVE ON)
@@ -1,3 +1,4 @@
+#include "Asg2Bin.hpp"
 #include "Asg2Json.hpp"
 #include "Ast2Asg.hpp"
 #include "SYsULexer.hpp"
@@ -50,6 +51,13 @@ main(int argc, char* argv[])
   inferType(asg);
   mgr.gc();
 
+  // 输出文件以 .asg 结尾时写出二进制格式，否则写出供评测使用的 JSON
+  if (outPath.ends_with(".asg")) {
+    asg::Asg2Bin asg2bin;
+    asg2bin(asg, outFile);
+    return 0;
+  }
+
   asg::Asg2Json asg2json;
   llvm::json::Value json = asg2json(asg);
 
@@ -1,3 +1,4 @@
+#include "Asg2Bin.hpp"
 #include "Asg2Json.hpp"
 #include "Typing.hpp"
 #include "lex.l.hh"
@@ -46,10 +47,15 @@ main(int argc, char* argv[])
   typing.mTypeCache.clear();
   par::gMgr.gc();
 
-  // 将抽象语义图转换为 JSON 并输出
-  asg::Asg2Json asg2json;
-  llvm::json::Value json = asg2json(par::gTranslationUnit);
-  outFile << json << '\n';
+  // 输出文件以 .asg 结尾时写出二进制格式，否则转换为 JSON 输出
+  if (outPath.ends_with(".asg")) {
+    asg::Asg2Bin asg2bin;
+    asg2bin(par::gTranslationUnit, outFile);
+  } else {
+    asg::Asg2Json asg2json;
+    llvm::json::Value json = asg2json(par::gTranslationUnit);
+    outFile << json << '\n';
+  }
 
   fclose(yyin);
 }
@@ -0,0 +1,333 @@
+#include "Asg2Bin.hpp"
+
+#define self (*this)
+
+namespace asg {
+
+void
+Asg2Bin::operator()(TranslationUnit* tu, llvm::raw_ostream& os)
+{
+  auto root = alloc(tu, bin::Node::kTranslationUnit);
+  list(root, tu->decls);
+
+  bin::Header header{};
+  std::memcpy(header.magic, bin::kMagic, sizeof(header.magic));
+  header.version = bin::kVersion;
+  header.root = root;
+  header.nTypes = mTypes.size();
+  header.nTexps = mTexps.size();
+  header.nNodes = mNodes.size();
+  header.nLists = mLists.size();
+  header.nStrs = mStrs.size();
+
+  auto write = [&](const void* data, std::size_t size) {
+    os.write(reinterpret_cast<const char*>(data), size);
+  };
+  write(&header, sizeof(header));
+  write(mTypes.data(), mTypes.size() * sizeof(bin::Type));
+  write(mTexps.data(), mTexps.size() * sizeof(bin::Texp));
+  write(mNodes.data(), mNodes.size() * sizeof(bin::Node));
+  write(mLists.data(), mLists.size() * sizeof(std::uint32_t));
+  write(mStrs.data(), mStrs.size());
+}
+
+std::uint32_t
+Asg2Bin::alloc(const Obj* obj, bin::Node::Kind kind)
+{
+  std::uint32_t idx = mNodes.size();
+  mNodes.emplace_back().kind = kind;
+  mIdx.try_emplace(obj, idx);
+  return idx;
+}
+
+std::uint32_t
+Asg2Bin::ref(Obj* obj)
+{
+  if (obj == nullptr)
+    return bin::kNone;
+
+  auto iter = mIdx.find(obj);
+  if (iter != mIdx.end())
+    return iter->second;
+
+  if (auto p = obj->dcst<Expr>())
+    return self(p);
+  if (auto p = obj->dcst<Stmt>())
+    return self(p);
+  if (auto p = obj->dcst<Decl>())
+    return self(p);
+  ABORT();
+}
+
+template<typename T>
+void
+Asg2Bin::list(std::uint32_t idx, const std::vector<T*>& objs)
+{
+  // 子节点可能再产生列表，所以先收集下标，再整体追加到列表段中
+  std::vector<std::uint32_t> idxs;
+  idxs.reserve(objs.size());
+  for (auto&& i : objs)
+    idxs.push_back(ref(i));
+
+  mNodes[idx].c = mLists.size();
+  mNodes[idx].d = idxs.size();
+  mLists.insert(mLists.end(), idxs.begin(), idxs.end());
+}
+
+std::uint32_t
+Asg2Bin::str(const std::string& s)
+{
+  std::uint32_t off = mStrs.size();
+  std::uint32_t len = s.size();
+  mStrs.append(reinterpret_cast<const char*>(&len), sizeof(len));
+  mStrs += s;
+  mStrs.resize((mStrs.size() + 3) & ~std::size_t(3), '\0');
+  return off;
+}
+
+//==============================================================================
+// 类型
+//==============================================================================
+
+std::uint32_t
+Asg2Bin::operator()(const Type* type)
+{
+  if (type == nullptr)
+    return bin::kNone;
+
+  auto iter = mIdx.find(type);
+  if (iter != mIdx.end())
+    return iter->second;
+
+  bin::Type rec{};
+  rec.spec = std::uint8_t(type->spec);
+  rec.const_ = type->qual.const_;
+  rec.texp = type->texp ? self(type->texp) : bin::kNone;
+
+  std::uint32_t idx = mTypes.size();
+  mTypes.push_back(rec);
+  mIdx.try_emplace(type, idx);
+  return idx;
+}
+
+std::uint32_t
+Asg2Bin::operator()(TypeExpr* texp)
+{
+  auto iter = mIdx.find(texp);
+  if (iter != mIdx.end())
+    return iter->second;
+
+  bin::Texp rec{};
+  rec.sub = texp->sub ? self(texp->sub) : bin::kNone;
+
+  if (auto p = texp->dcst<PointerType>()) {
+    rec.kind = bin::Texp::kPointer;
+    rec.const_ = p->qual.const_;
+  }
+
+  else if (auto p = texp->dcst<ArrayType>()) {
+    rec.kind = bin::Texp::kArray;
+    rec.a = p->len;
+  }
+
+  else if (auto p = texp->dcst<FunctionType>()) {
+    rec.kind = bin::Texp::kFunction;
+    std::vector<std::uint32_t> idxs;
+    for (auto&& i : p->params)
+      idxs.push_back(self(i));
+    rec.a = mLists.size();
+    rec.b = idxs.size();
+    mLists.insert(mLists.end(), idxs.begin(), idxs.end());
+  }
+
+  else
+    ABORT();
+
+  std::uint32_t idx = mTexps.size();
+  mTexps.push_back(rec);
+  mIdx.try_emplace(texp, idx);
+  return idx;
+}
+
+//==============================================================================
+// 表达式
+//==============================================================================
+
+std::uint32_t
+Asg2Bin::operator()(Expr* obj)
+{
+  std::uint32_t idx;
+  std::uint32_t a = bin::kNone, b = bin::kNone;
+  std::uint8_t op = 0;
+
+  if (auto p = obj->dcst<IntegerLiteral>()) {
+    idx = alloc(obj, bin::Node::kIntegerLiteral);
+    a = std::uint32_t(p->val), b = std::uint32_t(p->val >> 32);
+  }
+
+  else if (auto p = obj->dcst<StringLiteral>()) {
+    idx = alloc(obj, bin::Node::kStringLiteral);
+    a = str(p->val);
+  }
+
+  else if (auto p = obj->dcst<DeclRefExpr>()) {
+    idx = alloc(obj, bin::Node::kDeclRefExpr);
+    a = ref(p->decl);
+  }
+
+  else if (auto p = obj->dcst<ParenExpr>()) {
+    idx = alloc(obj, bin::Node::kParenExpr);
+    a = ref(p->sub);
+  }
+
+  else if (auto p = obj->dcst<UnaryExpr>()) {
+    idx = alloc(obj, bin::Node::kUnaryExpr);
+    op = p->op;
+    a = ref(p->sub);
+  }
+
+  else if (auto p = obj->dcst<BinaryExpr>()) {
+    idx = alloc(obj, bin::Node::kBinaryExpr);
+    op = p->op;
+    a = ref(p->lft);
+    b = ref(p->rht);
+  }
+
+  else if (auto p = obj->dcst<CallExpr>()) {
+    idx = alloc(obj, bin::Node::kCallExpr);
+    a = ref(p->head);
+    list(idx, p->args);
+  }
+
+  else if (auto p = obj->dcst<InitListExpr>()) {
+    idx = alloc(obj, bin::Node::kInitListExpr);
+    list(idx, p->list);
+  }
+
+  else if (obj->dcst<ImplicitInitExpr>())
+    idx = alloc(obj, bin::Node::kImplicitInitExpr);
+
+  else if (auto p = obj->dcst<ImplicitCastExpr>()) {
+    idx = alloc(obj, bin::Node::kImplicitCastExpr);
+    op = p->kind;
+    a = ref(p->sub);
+  }
+
+  else
+    ABORT();
+
+  auto type = self(obj->type);
+  auto& rec = mNodes[idx];
+  rec.op = op;
+  rec.cate = std::uint8_t(obj->cate);
+  rec.type = type;
+  rec.a = a, rec.b = b;
+  return idx;
+}
+
+//==============================================================================
+// 语句
+//==============================================================================
+
+std::uint32_t
+Asg2Bin::operator()(Stmt* obj)
+{
+  std::uint32_t idx;
+  std::uint32_t a = bin::kNone, b = bin::kNone, c = bin::kNone;
+
+  if (obj->dcst<NullStmt>())
+    idx = alloc(obj, bin::Node::kNullStmt);
+
+  else if (auto p = obj->dcst<DeclStmt>()) {
+    idx = alloc(obj, bin::Node::kDeclStmt);
+    list(idx, p->decls);
+    return idx;
+  }
+
+  else if (auto p = obj->dcst<ExprStmt>()) {
+    idx = alloc(obj, bin::Node::kExprStmt);
+    a = ref(p->expr);
+  }
+
+  else if (auto p = obj->dcst<CompoundStmt>()) {
+    idx = alloc(obj, bin::Node::kCompoundStmt);
+    list(idx, p->subs);
+    return idx;
+  }
+
+  else if (auto p = obj->dcst<IfStmt>()) {
+    idx = alloc(obj, bin::Node::kIfStmt);
+    a = ref(p->cond);
+    b = ref(p->then);
+    c = ref(p->else_);
+  }
+
+  else if (auto p = obj->dcst<WhileStmt>()) {
+    idx = alloc(obj, bin::Node::kWhileStmt);
+    a = ref(p->cond);
+    b = ref(p->body);
+  }
+
+  else if (auto p = obj->dcst<DoStmt>()) {
+    idx = alloc(obj, bin::Node::kDoStmt);
+    a = ref(p->body);
+    b = ref(p->cond);
+  }
+
+  else if (auto p = obj->dcst<BreakStmt>()) {
+    idx = alloc(obj, bin::Node::kBreakStmt);
+    a = ref(p->loop);
+  }
+
+  else if (auto p = obj->dcst<ContinueStmt>()) {
+    idx = alloc(obj, bin::Node::kContinueStmt);
+    a = ref(p->loop);
+  }
+
+  else if (auto p = obj->dcst<ReturnStmt>()) {
+    idx = alloc(obj, bin::Node::kReturnStmt);
+    a = ref(p->func);
+    b = ref(p->expr);
+  }
+
+  else
+    ABORT();
+
+  auto& rec = mNodes[idx];
+  rec.type = bin::kNone;
+  rec.a = a, rec.b = b, rec.c = c;
+  return idx;
+}
+
+//==============================================================================
+// 声明
+//==============================================================================
+
+std::uint32_t
+Asg2Bin::operator()(Decl* obj)
+{
+  std::uint32_t idx;
+  std::uint32_t a = str(obj->name), b = bin::kNone;
+
+  if (auto p = obj->dcst<VarDecl>()) {
+    idx = alloc(obj, bin::Node::kVarDecl);
+    b = ref(p->init);
+  }
+
+  else if (auto p = obj->dcst<FunctionDecl>()) {
+    idx = alloc(obj, bin::Node::kFunctionDecl);
+    list(idx, p->params);
+    b = ref(p->body);
+  }
+
+  else
+    ABORT();
+
+  auto type = self(obj->type);
+  auto& rec = mNodes[idx];
+  rec.type = type;
+  rec.a = a, rec.b = b;
+  return idx;
+}
+
+} // namespace asg
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "AsgBin.hpp"
+#include "asg.hpp"
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace asg {
+
+/**
+ * @brief 将抽象语义图序列化为 AsgBin.hpp 中定义的二进制格式
+ *
+ * 各段先在内存中的数组里构建，最后一次性写出。节点在第一次遇到时分配下标，
+ * 之后的引用（如 DeclRefExpr 对声明的引用）直接复用该下标。
+ */
+class Asg2Bin
+{
+public:
+  void operator()(TranslationUnit* tu, llvm::raw_ostream& os);
+
+private:
+  llvm::DenseMap<const Obj*, std::uint32_t> mIdx;
+  std::vector<bin::Type> mTypes;
+  std::vector<bin::Texp> mTexps;
+  std::vector<bin::Node> mNodes;
+  std::vector<std::uint32_t> mLists;
+  std::string mStrs;
+
+  /// 为 \p obj 分配一个节点记录，返回其下标。
+  std::uint32_t alloc(const Obj* obj, bin::Node::Kind kind);
+
+  /// 返回 \p obj 的节点下标，尚未序列化的对象会在此时序列化。
+  std::uint32_t ref(Obj* obj);
+
+  /// 将一组节点写入下标列表段，设置节点 \p idx 的 c、d 字段。
+  template<typename T>
+  void list(std::uint32_t idx, const std::vector<T*>& objs);
+
+  std::uint32_t str(const std::string& s);
+
+  //============================================================================
+  // 类型
+  //============================================================================
+
+  std::uint32_t operator()(const Type* type);
+
+  std::uint32_t operator()(TypeExpr* texp);
+
+  //============================================================================
+  // 表达式
+  //============================================================================
+
+  std::uint32_t operator()(Expr* obj);
+
+  //============================================================================
+  // 语句
+  //============================================================================
+
+  std::uint32_t operator()(Stmt* obj);
+
+  //============================================================================
+  // 声明
+  //============================================================================
+
+  std::uint32_t operator()(Decl* obj);
+};
+
+} // namespace asg
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @brief 抽象语义图的二进制交换格式
+ *
+ * 文件由定长的文件头和紧随其后的五个段组成，依次为：类型记录、类型表达式
+ * 记录、节点记录、下标列表和字符串池。所有整数均为本机字节序，各段都按 4
+ * 字节对齐，因此文件可以直接 mmap 进内存后当作数组访问，读取时不需要逐字
+ * 符解析。
+ *
+ * 对象之间的引用（子节点、声明引用、所在循环、所在函数等）一律使用所在段
+ * 中的下标表示，kNone 表示空指针；节点列表存放在下标列表段中，以起始位置
+ * 和长度表示；字符串以字节偏移表示，指向字符串池中的“4 字节长度 + 内容”。
+ *
+ * 本文件在 task/2/common 与 task/3 中各有一份，两者必须保持一致。
+ */
+namespace asg::bin {
+
+constexpr char kMagic[8] = { 'S', 'Y', 's', 'U', 'A', 'S', 'G', '\0' };
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kNone = UINT32_MAX;
+
+struct Header
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t root; /// 翻译单元的节点下标
+  std::uint32_t nTypes;
+  std::uint32_t nTexps;
+  std::uint32_t nNodes;
+  std::uint32_t nLists; /// 下标列表段的元素个数
+  std::uint32_t nStrs;  /// 字符串池的字节数，是 4 的倍数
+  std::uint32_t reserved;
+};
+
+struct Type
+{
+  std::uint8_t spec; /// asg::Type::Spec
+  std::uint8_t const_;
+  std::uint16_t reserved;
+  std::uint32_t texp;
+};
+
+struct Texp
+{
+  enum Kind : std::uint8_t
+  {
+    kPointer,
+    kArray,
+    kFunction,
+  };
+
+  Kind kind;
+  std::uint8_t const_; /// 仅用于指针类型
+  std::uint16_t reserved;
+  std::uint32_t sub;
+  std::uint32_t a; /// 数组长度；函数参数类型列表的起始位置
+  std::uint32_t b; /// 函数参数个数
+};
+
+/**
+ * 节点记录，各种节点对字段 a、b、c、d 的用法如下，c、d 总是用来表示子节点
+ * 列表的起始位置和长度：
+ *
+ * | 节点             | op       | a        | b      | c、d       |
+ * |------------------|----------|----------|--------|------------|
+ * | IntegerLiteral   |          | 低 32 位 | 高 32 位 |            |
+ * | StringLiteral    |          | 字符串   |        |            |
+ * | DeclRefExpr      |          | 声明     |        |            |
+ * | ParenExpr        |          | 子表达式 |        |            |
+ * | UnaryExpr        | 运算符   | 子表达式 |        |            |
+ * | BinaryExpr       | 运算符   | 左操作数 | 右操作数 |            |
+ * | CallExpr         |          | 被调函数 |        | 实参       |
+ * | InitListExpr     |          |          |        | 元素       |
+ * | ImplicitCastExpr | 转换种类 | 子表达式 |        |            |
+ * | DeclStmt         |          |          |        | 声明       |
+ * | ExprStmt         |          | 表达式   |        |            |
+ * | CompoundStmt     |          |          |        | 子语句     |
+ * | IfStmt           |          | 条件     | then   | c 为 else  |
+ * | WhileStmt        |          | 条件     | 循环体 |            |
+ * | DoStmt           |          | 循环体   | 条件   |            |
+ * | Break/Continue   |          | 所在循环 |        |            |
+ * | ReturnStmt       |          | 所在函数 | 返回值 |            |
+ * | VarDecl          |          | 名字     | 初始值 |            |
+ * | FunctionDecl     |          | 名字     | 函数体 | 形参       |
+ * | TranslationUnit  |          |          |        | 顶层声明   |
+ */
+struct Node
+{
+  enum Kind : std::uint8_t
+  {
+    kIntegerLiteral,
+    kStringLiteral,
+    kDeclRefExpr,
+    kParenExpr,
+    kUnaryExpr,
+    kBinaryExpr,
+    kCallExpr,
+    kInitListExpr,
+    kImplicitInitExpr,
+    kImplicitCastExpr,
+
+    kNullStmt,
+    kDeclStmt,
+    kExprStmt,
+    kCompoundStmt,
+    kIfStmt,
+    kWhileStmt,
+    kDoStmt,
+    kBreakStmt,
+    kContinueStmt,
+    kReturnStmt,
+
+    kVarDecl,
+    kFunctionDecl,
+
+    kTranslationUnit,
+  };
+
+  Kind kind{};
+  std::uint8_t op{ 0 };
+  std::uint8_t cate{ 0 }; /// asg::Expr::Cate
+  std::uint8_t reserved{ 0 };
+  std::uint32_t type{ kNone }; /// 表达式和声明的类型下标
+  std::uint32_t a{ kNone }, b{ kNone }, c{ kNone }, d{ 0 };
+};
+
+static_assert(sizeof(Header) % 4 == 0 && sizeof(Type) % 4 == 0 &&
+              sizeof(Texp) % 4 == 0 && sizeof(Node) % 4 == 0);
+
+/// 检查 \p data 开头是否为二进制格式的魔数。
+inline bool
+is_bin(const char* data, std::size_t size)
+{
+  return size >= sizeof(Header) && std::memcmp(data, kMagic, 8) == 0;
+}
+
+} // namespace asg::bin
@@ -0,0 +1,278 @@
+#include "AsgDigest.hpp"
+
+#define self (*this)
+
+using namespace asg;
+
+namespace {
+
+/// 节点种类的标记，只要求互不相同
+enum Tag : std::uint8_t
+{
+  kNull,
+  kPointer,
+  kArray,
+  kFunction,
+
+  kIntegerLiteral,
+  kStringLiteral,
+  kLocalRef,
+  kGlobalRef,
+  kParenExpr,
+  kUnaryExpr,
+  kBinaryExpr,
+  kCallExpr,
+  kInitListExpr,
+  kImplicitInitExpr,
+  kImplicitCastExpr,
+
+  kNullStmt,
+  kDeclStmt,
+  kExprStmt,
+  kCompoundStmt,
+  kIfStmt,
+  kWhileStmt,
+  kDoStmt,
+  kBreakStmt,
+  kContinueStmt,
+  kReturnStmt,
+
+  kVarDecl,
+  kFunctionDecl,
+};
+
+} // namespace
+
+std::string
+AsgDigest::operator()(FunctionDecl* obj)
+{
+  mOut.clear();
+  mLocals.clear();
+
+  put(kFunctionDecl);
+  put(obj->name);
+  self(obj->type);
+  put(obj->params.size());
+  for (auto&& i : obj->params)
+    self(i);
+  self(obj->body);
+
+  return std::move(mOut);
+}
+
+void
+AsgDigest::put(std::uint64_t val)
+{
+  // 变长编码，绝大多数的标记和运算符只占一个字节
+  do {
+    char byte = val & 0x7f;
+    val >>= 7;
+    mOut += val ? char(byte | 0x80) : byte;
+  } while (val);
+}
+
+void
+AsgDigest::put(const std::string& str)
+{
+  put(str.size());
+  mOut += str;
+}
+
+void
+AsgDigest::operator()(const Type* type)
+{
+  if (type == nullptr) {
+    put(kNull);
+    return;
+  }
+
+  put(std::uint64_t(type->spec) << 8 | type->qual.const_);
+  for (auto texp = type->texp; texp; texp = texp->sub) {
+    if (auto p = texp->dcst<PointerType>()) {
+      put(kPointer);
+      put(p->qual.const_);
+    } else if (auto p = texp->dcst<ArrayType>()) {
+      put(kArray);
+      put(p->len);
+    } else if (auto p = texp->dcst<FunctionType>()) {
+      put(kFunction);
+      put(p->params.size());
+      for (auto&& i : p->params)
+        self(i);
+    } else
+      ABORT();
+  }
+  put(kNull);
+}
+
+void
+AsgDigest::operator()(Expr* obj)
+{
+  if (obj == nullptr) {
+    put(kNull);
+    return;
+  }
+
+  auto head = [&](Tag tag, std::uint64_t op = 0) {
+    put(tag);
+    put(op << 8 | std::uint64_t(obj->cate));
+    self(obj->type);
+  };
+
+  if (auto p = obj->dcst<IntegerLiteral>()) {
+    head(kIntegerLiteral);
+    put(p->val);
+  }
+
+  else if (auto p = obj->dcst<StringLiteral>()) {
+    head(kStringLiteral);
+    put(p->val);
+  }
+
+  else if (auto p = obj->dcst<DeclRefExpr>()) {
+    if (mLocals.count(p->decl)) {
+      head(kLocalRef);
+      put(p->decl->name);
+      return;
+    }
+
+    // 外部声明只记签名，常量的值可能被直接用在函数体中，也要记下
+    head(kGlobalRef);
+    put(p->decl->dcst<FunctionDecl>() ? kFunctionDecl : kVarDecl);
+    put(p->decl->name);
+    self(p->decl->type);
+    if (auto var = p->decl->dcst<VarDecl>())
+      if (var->type->qual.const_)
+        self(var->init);
+  }
+
+  else if (auto p = obj->dcst<ParenExpr>()) {
+    head(kParenExpr);
+    self(p->sub);
+  }
+
+  else if (auto p = obj->dcst<UnaryExpr>()) {
+    head(kUnaryExpr, p->op);
+    self(p->sub);
+  }
+
+  else if (auto p = obj->dcst<BinaryExpr>()) {
+    head(kBinaryExpr, p->op);
+    self(p->lft);
+    self(p->rht);
+  }
+
+  else if (auto p = obj->dcst<CallExpr>()) {
+    head(kCallExpr);
+    self(p->head);
+    put(p->args.size());
+    for (auto&& i : p->args)
+      self(i);
+  }
+
+  else if (auto p = obj->dcst<InitListExpr>()) {
+    head(kInitListExpr);
+    put(p->list.size());
+    for (auto&& i : p->list)
+      self(i);
+  }
+
+  else if (obj->dcst<ImplicitInitExpr>())
+    head(kImplicitInitExpr);
+
+  else if (auto p = obj->dcst<ImplicitCastExpr>()) {
+    head(kImplicitCastExpr, p->kind);
+    self(p->sub);
+  }
+
+  else
+    ABORT();
+}
+
+void
+AsgDigest::operator()(Stmt* obj)
+{
+  if (obj == nullptr) {
+    put(kNull);
+    return;
+  }
+
+  if (obj->dcst<NullStmt>())
+    put(kNullStmt);
+
+  else if (auto p = obj->dcst<DeclStmt>()) {
+    put(kDeclStmt);
+    put(p->decls.size());
+    for (auto&& i : p->decls)
+      self(i);
+  }
+
+  else if (auto p = obj->dcst<ExprStmt>()) {
+    put(kExprStmt);
+    self(p->expr);
+  }
+
+  else if (auto p = obj->dcst<CompoundStmt>()) {
+    put(kCompoundStmt);
+    put(p->subs.size());
+    for (auto&& i : p->subs)
+      self(i);
+  }
+
+  else if (auto p = obj->dcst<IfStmt>()) {
+    put(kIfStmt);
+    self(p->cond);
+    self(p->then);
+    self(p->else_);
+  }
+
+  else if (auto p = obj->dcst<WhileStmt>()) {
+    put(kWhileStmt);
+    self(p->cond);
+    self(p->body);
+  }
+
+  else if (auto p = obj->dcst<DoStmt>()) {
+    put(kDoStmt);
+    self(p->body);
+    self(p->cond);
+  }
+
+  // 跳转的目标由所在的位置决定，不需要记录
+  else if (obj->dcst<BreakStmt>())
+    put(kBreakStmt);
+
+  else if (obj->dcst<ContinueStmt>())
+    put(kContinueStmt);
+
+  else if (auto p = obj->dcst<ReturnStmt>()) {
+    put(kReturnStmt);
+    self(p->expr);
+  }
+
+  else
+    ABORT();
+}
+
+void
+AsgDigest::operator()(Decl* obj)
+{
+  mLocals.insert(obj);
+
+  if (auto p = obj->dcst<VarDecl>()) {
+    put(kVarDecl);
+    put(p->name);
+    self(p->type);
+    self(p->init);
+  }
+
+  else if (auto p = obj->dcst<FunctionDecl>()) {
+    // 函数内的函数声明
+    put(kFunctionDecl);
+    put(p->name);
+    self(p->type);
+  }
+
+  else
+    ABORT();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "asg.hpp"
+#include <unordered_set>
+
+/**
+ * @brief 函数的内容摘要，供增量编译判断函数是否需要重新翻译
+ *
+ * 把函数声明的子树按固定的格式序列化为字节串：节点种类、运算符、值类别、类
+ * 型和名字等决定翻译结果的内容都会写入，对象地址等每次运行都不同的内容则不
+ * 会。函数引用到的外部声明（全局变量和其他函数）只写入它们的签名，即种类、
+ * 名字和类型，常量全局变量再加上初始值，所以修改别的函数的函数体不会改变这
+ * 个函数的摘要。
+ */
+class AsgDigest
+{
+public:
+  std::string operator()(asg::FunctionDecl* obj);
+
+private:
+  std::string mOut;
+  std::unordered_set<asg::Decl*> mLocals; /// 当前函数内的形参与局部变量
+
+  void put(std::uint64_t val);
+
+  void put(const std::string& str);
+
+  void operator()(const asg::Type* type);
+
+  void operator()(asg::Expr* obj);
+
+  void operator()(asg::Stmt* obj);
+
+  void operator()(asg::Decl* obj);
+};
@@ -0,0 +1,812 @@
+#include "Baseline.hpp"
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+
+// 生成的代码调用运行时库时遵循 System V 的调用约定，只支持类 Unix 系统上的
+// x86-64
+#if defined(__x86_64__) && !defined(_WIN32)
+#define BASELINE_X86_64 1
+#endif
+
+#ifdef BASELINE_X86_64
+
+namespace {
+
+enum Reg : int
+{
+  kRax,
+  kRcx,
+  kRdx,
+  kRbx,
+  kRsp,
+  kRbp,
+  kRsi,
+  kRdi,
+  kR8,
+  kR9,
+  kR10,
+  kR11,
+  kR12,
+  kR13,
+  kR14,
+  kR15,
+};
+
+/// 生成的代码中固定用途的寄存器，都是被调用者保存的
+constexpr Reg kFp = kRbx;     /// 寄存器窗口
+constexpr Reg kFm = kR12;     /// 局部数组栈帧
+constexpr Reg kGp = kR13;     /// 全局内存
+constexpr Reg kRegEnd = kR14; /// 寄存器栈的上界
+constexpr Reg kMemEnd = kR15; /// 局部数组栈的上界
+
+/// 缓存字节码寄存器的宿主寄存器个数：rax、rcx、rdx
+constexpr int kCached = 3;
+
+/// 条件码
+enum Cond : std::uint8_t
+{
+  kCondA = 0x7,
+  kCondE = 0x4,
+  kCondNe = 0x5,
+  kCondL = 0xC,
+  kCondGe = 0xD,
+  kCondLe = 0xE,
+  kCondG = 0xF,
+};
+
+/// 比较并跳转指令 JEq…JGe 与 JEqI…JGeI 对应的条件码
+constexpr Cond kJumpCond[] = { kCondE, kCondNe, kCondL,
+                               kCondLe, kCondG, kCondGe };
+
+/// 内存操作数 base + index * scale + disp，index 为 rsp 表示没有
+struct Mem
+{
+  Reg base;
+  Reg index{ kRsp };
+  int scale{ 1 };
+  std::int32_t disp{ 0 };
+};
+
+bool
+fits8(std::int32_t val)
+{
+  return val == std::int8_t(val);
+}
+
+/// 按字节写出的 x86-64 指令编码，只有用得到的几种格式
+class Asm
+{
+public:
+  std::vector<std::uint8_t> mBuf;
+
+  std::size_t pos() const { return mBuf.size(); }
+
+  void byte(unsigned val) { mBuf.push_back(std::uint8_t(val)); }
+
+  void imm32(std::int32_t val)
+  {
+    auto pos = mBuf.size();
+    mBuf.resize(pos + 4);
+    std::memcpy(mBuf.data() + pos, &val, 4);
+  }
+
+  void imm64(std::int64_t val)
+  {
+    auto pos = mBuf.size();
+    mBuf.resize(pos + 8);
+    std::memcpy(mBuf.data() + pos, &val, 8);
+  }
+
+  /// 寄存器 reg 与内存操作数 m 的指令，\p w 表示 64 位操作数
+  void op(bool w, std::initializer_list<std::uint8_t> opc, int reg, Mem m)
+  {
+    rex(w, reg, m.index, m.base);
+    for (auto i : opc)
+      byte(i);
+
+    int mod = m.disp == 0 && (m.base & 7) != kRbp ? 0 : fits8(m.disp) ? 1 : 2;
+    if (m.index == kRsp && (m.base & 7) != kRsp)
+      byte(mod << 6 | (reg & 7) << 3 | (m.base & 7));
+    else {
+      int ss = m.scale == 8 ? 3 : m.scale == 4 ? 2 : m.scale == 2 ? 1 : 0;
+      byte(mod << 6 | (reg & 7) << 3 | 4);
+      byte(ss << 6 | (m.index & 7) << 3 | (m.base & 7));
+    }
+    if (mod == 1)
+      byte(std::uint8_t(m.disp));
+    else if (mod == 2)
+      imm32(m.disp);
+  }
+
+  /// 两个寄存器的指令，reg 也可以是操作码的扩展
+  void op(bool w, std::initializer_list<std::uint8_t> opc, int reg, Reg rm)
+  {
+    rex(w, reg, 0, rm);
+    for (auto i : opc)
+      byte(i);
+    byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+  }
+
+  /// 立即数的算术指令，\p ext 是操作码扩展：0 为 add，5 为 sub，7 为 cmp
+  void alu(bool w, int ext, Reg rm, std::int32_t imm)
+  {
+    if (fits8(imm)) {
+      op(w, { 0x83 }, ext, rm);
+      byte(std::uint8_t(imm));
+    } else {
+      op(w, { 0x81 }, ext, rm);
+      imm32(imm);
+    }
+  }
+
+  void mov(Reg dst, Reg src) { op(true, { 0x8B }, dst, src); }
+
+  void movabs(Reg dst, std::int64_t imm)
+  {
+    rex(true, 0, 0, dst);
+    byte(0xB8 | (dst & 7));
+    imm64(imm);
+  }
+
+  void push(Reg reg)
+  {
+    rex(false, 0, 0, reg);
+    byte(0x50 | (reg & 7));
+  }
+
+  void pop(Reg reg)
+  {
+    rex(false, 0, 0, reg);
+    byte(0x58 | (reg & 7));
+  }
+
+  void ret() { byte(0xC3); }
+
+  /// 跳转与调用，返回待回填的 32 位偏移的位置
+  std::size_t jmp()
+  {
+    byte(0xE9);
+    return rel32();
+  }
+
+  std::size_t jcc(Cond cond)
+  {
+    byte(0x0F);
+    byte(0x80 | cond);
+    return rel32();
+  }
+
+  std::size_t call()
+  {
+    byte(0xE8);
+    return rel32();
+  }
+
+  /// 把 \p at 处的偏移回填为跳到 \p target
+  void patch(std::size_t at, std::size_t target)
+  {
+    auto rel = std::int32_t(std::int64_t(target) - std::int64_t(at + 4));
+    std::memcpy(mBuf.data() + at, &rel, 4);
+  }
+
+private:
+  void rex(bool w, int reg, int index, int base)
+  {
+    unsigned val = 0x40 | unsigned(w) << 3 | (reg >> 3 & 1) << 2 |
+                   (index >> 3 & 1) << 1 | (base >> 3 & 1);
+    if (val != 0x40)
+      byte(val);
+  }
+
+  std::size_t rel32()
+  {
+    imm32(0);
+    return pos() - 4;
+  }
+};
+
+/// 生成的代码调用运行时库函数的入口，程序要求退出时直接结束进程
+std::int64_t
+call_native(Vm* vm, std::int32_t id, std::int64_t* args)
+{
+  bool halt = false;
+  auto ret = vm->native(id, args, halt);
+  if (halt)
+    vm->exit(int(ret));
+  return ret;
+}
+
+/// 栈溢出时的出口，与解释器的输出和返回码相同
+[[noreturn]] void
+stack_overflow(Vm* vm)
+{
+  std::fflush(stdout);
+  std::fprintf(stderr, "Error: stack overflow\n");
+  vm->exit(-1);
+}
+
+bool
+returns_void(const Vm::Func& func)
+{
+  if (func.decl == nullptr)
+    return false;
+  auto ftype = func.decl->type->texp->dcst<asg::FunctionType>();
+  return func.decl->type->spec == asg::Type::Spec::kVoid &&
+         ftype->sub == nullptr;
+}
+
+/// 逐条翻译字节码，一遍生成，最后回填跳转
+class Emitter
+{
+public:
+  explicit Emitter(Vm& vm)
+    : mVm(vm)
+    , mFuncs(vm.funcs())
+    , mCode(vm.code())
+  {
+  }
+
+  std::vector<std::uint8_t> operator()();
+
+private:
+  Vm& mVm;
+  const std::vector<Vm::Func>& mFuncs;
+  const std::vector<Vm::Insn>& mCode;
+  Asm mAsm;
+
+  /// rax、rcx、rdx 中现在是哪个字节码寄存器的值，-1 表示不确定
+  std::int32_t mHeld[kCached]{ -1, -1, -1 };
+
+  std::vector<std::size_t> mInsnAt, mFuncAt;
+  std::vector<bool> mTarget;
+  std::vector<std::pair<std::size_t, std::int32_t>> mJumps, mCalls;
+  std::vector<std::size_t> mOverflows;
+
+  static Mem slot(std::int32_t reg) { return { kFp, kRsp, 1, reg * 8 }; }
+
+  /// 把字节码寄存器 \p reg 读到 \p host 中，已经在某个宿主寄存器中时不读内存
+  void get(Reg host, std::int32_t reg);
+
+  /// 把 \p host 写回字节码寄存器 \p reg
+  void put(std::int32_t reg, Reg host);
+
+  void clobber(Reg host)
+  {
+    if (host < kCached)
+      mHeld[host] = -1;
+  }
+
+  void forget() { std::fill(std::begin(mHeld), std::end(mHeld), -1); }
+
+  /// 在对齐的栈上调用 C 函数，之后缓存全部作废
+  void callC(const void* fn);
+
+  void prologue(const Vm::Func& func);
+  void insn(const Vm::Func& func, const Vm::Insn& insn);
+};
+
+void
+Emitter::get(Reg host, std::int32_t reg)
+{
+  if (host < kCached && mHeld[host] == reg)
+    return;
+  auto src = std::find(std::begin(mHeld), std::end(mHeld), reg);
+  if (src != std::end(mHeld))
+    mAsm.mov(host, Reg(src - std::begin(mHeld)));
+  else
+    mAsm.op(true, { 0x8B }, host, slot(reg));
+  if (host < kCached)
+    mHeld[host] = reg;
+}
+
+void
+Emitter::put(std::int32_t reg, Reg host)
+{
+  mAsm.op(true, { 0x89 }, host, slot(reg));
+  for (auto& i : mHeld) {
+    if (i == reg)
+      i = -1;
+  }
+  if (host < kCached)
+    mHeld[host] = reg;
+}
+
+void
+Emitter::callC(const void* fn)
+{
+  // 生成的代码之间的调用只压入返回地址，栈不一定对齐，用 rbp 记住原来的值
+  mAsm.op(true, { 0x89 }, kRsp, kRbp);
+  mAsm.op(true, { 0x83 }, 4, kRsp);
+  mAsm.byte(0xF0);
+  mAsm.movabs(kRax, reinterpret_cast<std::int64_t>(fn));
+  mAsm.op(false, { 0xFF }, 2, kRax);
+  mAsm.op(true, { 0x89 }, kRbp, kRsp);
+  forget();
+}
+
+std::vector<std::uint8_t>
+Emitter::operator()()
+{
+  mInsnAt.assign(mCode.size(), 0);
+  mFuncAt.assign(mFuncs.size(), 0);
+  mTarget.assign(mCode.size() + 1, false);
+  for (auto&& i : mCode) {
+    if (i.op >= Vm::kJmp && i.op <= Vm::kJGeI)
+      mTarget[i.d] = true;
+  }
+
+  // 入口：保存被调用者保存的寄存器，设置固定用途的寄存器，调用初始化函数
+  const Reg saved[] = { kRbx, kRbp, kR12, kR13, kR14, kR15 };
+  for (auto i : saved)
+    mAsm.push(i);
+  mAsm.alu(true, 5, kRsp, 8);
+  const Reg params[] = { kRdi, kRsi, kRdx, kRcx, kR8 };
+  const Reg fixed[] = { kFp, kFm, kGp, kRegEnd, kMemEnd };
+  for (int i = 0; i < 5; ++i)
+    mAsm.mov(fixed[i], params[i]);
+  mCalls.emplace_back(mAsm.call(), mVm.init());
+  mAsm.alu(true, 0, kRsp, 8);
+  for (auto i = std::rbegin(saved); i != std::rend(saved); ++i)
+    mAsm.pop(*i);
+  mAsm.ret();
+
+  // 函数的字节码连续存放，按入口的顺序依次翻译
+  std::vector<std::int32_t> order;
+  for (std::size_t i = 0; i < mFuncs.size(); ++i) {
+    if (mFuncs[i].entry >= 0)
+      order.push_back(std::int32_t(i));
+  }
+  std::sort(order.begin(), order.end(), [&](auto a, auto b) {
+    return mFuncs[a].entry < mFuncs[b].entry;
+  });
+
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    auto& func = mFuncs[order[i]];
+    auto end = i + 1 < order.size() ? mFuncs[order[i + 1]].entry
+                                    : std::int32_t(mCode.size());
+    mFuncAt[order[i]] = mAsm.pos();
+    prologue(func);
+    for (auto j = func.entry; j < end; ++j) {
+      if (mTarget[j])
+        forget();
+      mInsnAt[j] = mAsm.pos();
+      insn(func, mCode[j]);
+    }
+  }
+
+  // 栈溢出的出口
+  auto overflow = mAsm.pos();
+  mAsm.movabs(kRdi, reinterpret_cast<std::int64_t>(&mVm));
+  callC(reinterpret_cast<const void*>(stack_overflow));
+  mAsm.byte(0x0F);
+  mAsm.byte(0x0B);
+
+  for (auto&& [at, target] : mJumps)
+    mAsm.patch(at, mInsnAt[target]);
+  for (auto&& [at, func] : mCalls)
+    mAsm.patch(at, mFuncAt[func]);
+  for (auto at : mOverflows)
+    mAsm.patch(at, overflow);
+  return std::move(mAsm.mBuf);
+}
+
+void
+Emitter::prologue(const Vm::Func& func)
+{
+  // 与解释器一样在进入函数时检查两个栈是否够用
+  forget();
+  mAsm.op(true, { 0x8D }, kRax, slot(func.nregs));
+  mAsm.op(true, { 0x3B }, kRax, kRegEnd);
+  mOverflows.push_back(mAsm.jcc(kCondA));
+  if (func.fmem) {
+    mAsm.op(true, { 0x8D }, kRax, Mem{ kFm, kRsp, 1, func.fmem });
+    mAsm.op(true, { 0x3B }, kRax, kMemEnd);
+    mOverflows.push_back(mAsm.jcc(kCondA));
+  }
+}
+
+void
+Emitter::insn(const Vm::Func& func, const Vm::Insn& insn)
+{
+  auto& a = mAsm;
+  auto sext = [&] { a.op(true, { 0x63 }, kRax, kRax); };
+  auto jump = [&](Cond cond) { mJumps.emplace_back(a.jcc(cond), insn.d); };
+  auto gmem = [&](std::int32_t off) { return Mem{ kGp, kRsp, 1, off }; };
+
+  switch (insn.op) {
+    case Vm::kHalt:
+      // 只出现在初始化函数中，返回到入口
+      get(kRax, insn.a);
+      a.ret();
+      forget();
+      break;
+    case Vm::kMov:
+      get(kRax, insn.b);
+      put(insn.a, kRax);
+      break;
+    case Vm::kLi:
+      a.op(true, { 0xC7 }, 0, kRax);
+      a.imm32(insn.b);
+      put(insn.a, kRax);
+      break;
+    case Vm::kLi64:
+      a.movabs(kRax,
+               std::int64_t(std::uint64_t(std::uint32_t(insn.c)) << 32 |
+                            std::uint32_t(insn.b)));
+      put(insn.a, kRax);
+      break;
+
+    // 32 位运算在低 32 位上进行，结果再符号扩展
+    case Vm::kAdd:
+    case Vm::kSub:
+    case Vm::kMul:
+    case Vm::kAdd64:
+    case Vm::kSub64:
+    case Vm::kMul64: {
+      bool w = insn.op >= Vm::kAdd64;
+      get(kRax, insn.b);
+      get(kRcx, insn.c);
+      if (insn.op == Vm::kAdd || insn.op == Vm::kAdd64)
+        a.op(w, { 0x03 }, kRax, kRcx);
+      else if (insn.op == Vm::kSub || insn.op == Vm::kSub64)
+        a.op(w, { 0x2B }, kRax, kRcx);
+      else
+        a.op(w, { 0x0F, 0xAF }, kRax, kRcx);
+      if (!w)
+        sext();
+      put(insn.a, kRax);
+      break;
+    }
+    case Vm::kDiv:
+    case Vm::kRem:
+    case Vm::kDivI:
+    case Vm::kRemI:
+    case Vm::kDiv64:
+    case Vm::kRem64: {
+      bool w = insn.op == Vm::kDiv64 || insn.op == Vm::kRem64;
+      bool rem =
+        insn.op == Vm::kRem || insn.op == Vm::kRemI || insn.op == Vm::kRem64;
+      get(kRax, insn.b);
+      if (insn.op == Vm::kDivI || insn.op == Vm::kRemI) {
+        a.byte(0xB8 | kRcx);
+        a.imm32(insn.c);
+        clobber(kRcx);
+      } else
+        get(kRcx, insn.c);
+      if (w)
+        a.byte(0x48);
+      a.byte(0x99); // cdq 或 cqo
+      a.op(w, { 0xF7 }, 7, kRcx);
+      clobber(kRdx);
+      if (rem)
+        a.mov(kRax, kRdx);
+      if (!w)
+        sext();
+      put(insn.a, kRax);
+      break;
+    }
+    case Vm::kNeg:
+    case Vm::kNeg64:
+      get(kRax, insn.b);
+      a.op(insn.op == Vm::kNeg64, { 0xF7 }, 3, kRax);
+      if (insn.op == Vm::kNeg)
+        sext();
+      put(insn.a, kRax);
+      break;
+    case Vm::kAddI:
+    case Vm::kAddI64:
+      get(kRax, insn.b);
+      a.alu(insn.op == Vm::kAddI64, 0, kRax, insn.c);
+      if (insn.op == Vm::kAddI)
+        sext();
+      put(insn.a, kRax);
+      break;
+    case Vm::kMulI:
+    case Vm::kMulI64:
+      get(kRax, insn.b);
+      a.op(insn.op == Vm::kMulI64, { 0x69 }, kRax, kRax);
+      a.imm32(insn.c);
+      if (insn.op == Vm::kMulI)
+        sext();
+      put(insn.a, kRax);
+      break;
+
+    case Vm::kNot:
+      get(kRax, insn.b);
+      a.op(true, { 0x85 }, kRax, kRax);
+      a.op(false, { 0x0F, 0x94 }, 0, kRax);
+      a.op(false, { 0x0F, 0xB6 }, kRax, kRax);
+      put(insn.a, kRax);
+      break;
+    case Vm::kTrunc8:
+      get(kRax, insn.b);
+      a.op(true, { 0x0F, 0xBE }, kRax, kRax);
+      put(insn.a, kRax);
+      break;
+    case Vm::kTrunc32:
+      get(kRax, insn.b);
+      sext();
+      put(insn.a, kRax);
+      break;
+
+    case Vm::kJmp:
+      mJumps.emplace_back(a.jmp(), insn.d);
+      forget();
+      break;
+    case Vm::kJz:
+    case Vm::kJnz:
+      get(kRax, insn.a);
+      a.op(true, { 0x85 }, kRax, kRax);
+      jump(insn.op == Vm::kJz ? kCondE : kCondNe);
+      break;
+    case Vm::kJEq:
+    case Vm::kJNe:
+    case Vm::kJLt:
+    case Vm::kJLe:
+    case Vm::kJGt:
+    case Vm::kJGe:
+      get(kRax, insn.a);
+      get(kRcx, insn.b);
+      a.op(true, { 0x3B }, kRax, kRcx);
+      jump(kJumpCond[insn.op - Vm::kJEq]);
+      break;
+    case Vm::kJEqI:
+    case Vm::kJNeI:
+    case Vm::kJLtI:
+    case Vm::kJLeI:
+    case Vm::kJGtI:
+    case Vm::kJGeI:
+      get(kRax, insn.a);
+      a.alu(true, 7, kRax, insn.b);
+      jump(kJumpCond[insn.op - Vm::kJEqI]);
+      break;
+
+    case Vm::kLd8:
+      get(kRcx, insn.b);
+      a.op(true, { 0x0F, 0xBE }, kRax, Mem{ kRcx, kRsp, 1, insn.c });
+      put(insn.a, kRax);
+      break;
+    case Vm::kLd32:
+      get(kRcx, insn.b);
+      a.op(true, { 0x63 }, kRax, Mem{ kRcx, kRsp, 1, insn.c });
+      put(insn.a, kRax);
+      break;
+    case Vm::kLd64:
+      get(kRcx, insn.b);
+      a.op(true, { 0x8B }, kRax, Mem{ kRcx, kRsp, 1, insn.c });
+      put(insn.a, kRax);
+      break;
+    case Vm::kSt8:
+    case Vm::kSt32:
+    case Vm::kSt64: {
+      get(kRax, insn.a);
+      get(kRcx, insn.b);
+      Mem m{ kRcx, kRsp, 1, insn.c };
+      if (insn.op == Vm::kSt8)
+        a.op(false, { 0x88 }, kRax, m);
+      else
+        a.op(insn.op == Vm::kSt64, { 0x89 }, kRax, m);
+      break;
+    }
+    case Vm::kLdG32:
+      a.op(true, { 0x63 }, kRax, gmem(insn.b));
+      put(insn.a, kRax);
+      break;
+    case Vm::kLdG64:
+      a.op(true, { 0x8B }, kRax, gmem(insn.b));
+      put(insn.a, kRax);
+      break;
+    case Vm::kStG32:
+    case Vm::kStG64:
+      get(kRax, insn.a);
+      a.op(insn.op == Vm::kStG64, { 0x89 }, kRax, gmem(insn.b));
+      break;
+    case Vm::kLdX32:
+    case Vm::kLdX64: {
+      bool w = insn.op == Vm::kLdX64;
+      std::uint8_t opc = w ? 0x8B : 0x63;
+      get(kRcx, insn.b);
+      get(kRdx, insn.c);
+      a.op(true, { opc }, kRax, Mem{ kRcx, kRdx, w ? 8 : 4 });
+      put(insn.a, kRax);
+      break;
+    }
+    case Vm::kStX32:
+    case Vm::kStX64: {
+      bool w = insn.op == Vm::kStX64;
+      get(kRax, insn.a);
+      get(kRcx, insn.b);
+      get(kRdx, insn.c);
+      a.op(w, { 0x89 }, kRax, Mem{ kRcx, kRdx, w ? 8 : 4 });
+      break;
+    }
+    case Vm::kLdGX32:
+    case Vm::kLdGX64: {
+      bool w = insn.op == Vm::kLdGX64;
+      std::uint8_t opc = w ? 0x8B : 0x63;
+      get(kRcx, insn.c);
+      a.op(true, { opc }, kRax, Mem{ kGp, kRcx, w ? 8 : 4, insn.b });
+      put(insn.a, kRax);
+      break;
+    }
+    case Vm::kStGX32:
+    case Vm::kStGX64: {
+      bool w = insn.op == Vm::kStGX64;
+      get(kRax, insn.a);
+      get(kRcx, insn.c);
+      a.op(w, { 0x89 }, kRax, Mem{ kGp, kRcx, w ? 8 : 4, insn.b });
+      break;
+    }
+
+    case Vm::kAddG32:
+      get(kRax, insn.b);
+      a.op(false, { 0x01 }, kRax, gmem(insn.a));
+      break;
+    case Vm::kAddM32:
+      get(kRcx, insn.a);
+      get(kRax, insn.c);
+      a.op(false, { 0x01 }, kRax, Mem{ kRcx, kRsp, 1, insn.b });
+      break;
+    case Vm::kAddX32:
+      get(kRcx, insn.a);
+      get(kRdx, insn.b);
+      get(kRax, insn.c);
+      a.op(false, { 0x01 }, kRax, Mem{ kRcx, kRdx, 4 });
+      break;
+    case Vm::kAddGX32:
+      get(kRcx, insn.b);
+      get(kRax, insn.c);
+      a.op(false, { 0x01 }, kRax, Mem{ kGp, kRcx, 4, insn.a });
+      break;
+
+    case Vm::kGaddr:
+      a.op(true, { 0x8D }, kRax, gmem(insn.b));
+      put(insn.a, kRax);
+      break;
+    case Vm::kFaddr:
+      a.op(true, { 0x8D }, kRax, Mem{ kFm, kRsp, 1, insn.b });
+      put(insn.a, kRax);
+      break;
+    case Vm::kIdx:
+    case Vm::kGIdx: {
+      // 比例是 1、2、4、8 时用一条 lea 完成
+      bool global = insn.op == Vm::kGIdx;
+      get(kRax, insn.c);
+      int scale = insn.d;
+      if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+        a.op(true, { 0x69 }, kRax, kRax);
+        a.imm32(insn.d);
+        scale = 1;
+      }
+      if (global)
+        a.op(true, { 0x8D }, kRax, Mem{ kGp, kRax, scale, insn.b });
+      else {
+        get(kRcx, insn.b);
+        a.op(true, { 0x8D }, kRax, Mem{ kRcx, kRax, scale });
+      }
+      put(insn.a, kRax);
+      break;
+    }
+    case Vm::kMemzero:
+      get(kRdi, insn.a);
+      a.op(false, { 0x31 }, kRsi, kRsi);
+      a.byte(0xB8 | kRdx);
+      a.imm32(insn.b);
+      callC(reinterpret_cast<const void*>(std::memset));
+      break;
+
+    case Vm::kCall: {
+      // 被调用者的寄存器窗口从实参开始，局部数组栈帧在调用者的之上
+      auto& callee = mFuncs[insn.c];
+      a.op(true, { 0x8D }, kFp, slot(insn.b));
+      if (func.fmem)
+        a.alu(true, 0, kFm, func.fmem);
+      mCalls.emplace_back(a.call(), insn.c);
+      if (func.fmem)
+        a.alu(true, 5, kFm, func.fmem);
+      a.op(true, { 0x8D }, kFp, slot(-insn.b));
+      forget();
+      if (!returns_void(callee))
+        put(insn.a, kRax);
+      break;
+    }
+    case Vm::kCallN:
+      a.op(true, { 0x8D }, kRdx, slot(insn.b));
+      a.byte(0xB8 | kRsi);
+      a.imm32(insn.c);
+      a.movabs(kRdi, reinterpret_cast<std::int64_t>(&mVm));
+      callC(reinterpret_cast<const void*>(call_native));
+      put(insn.a, kRax);
+      break;
+    case Vm::kRet:
+      get(kRax, insn.a);
+      a.ret();
+      forget();
+      break;
+    case Vm::kRetV:
+      a.ret();
+      forget();
+      break;
+
+    // 只在分层执行时生成
+    case Vm::kCallJ:
+    case Vm::kProf:
+    case Vm::kOpCount:
+      ABORT();
+  }
+}
+
+/// 入口的类型：寄存器栈、局部数组栈、全局内存、两个栈的上界
+using Entry = std::int64_t (*)(std::int64_t* regs,
+                               std::uint8_t* mem,
+                               std::uint8_t* gp,
+                               std::int64_t* regEnd,
+                               std::uint8_t* memEnd);
+
+} // namespace
+
+bool
+Baseline::operator()()
+{
+  auto code = Emitter(mVm)();
+
+  std::error_code ec;
+  auto block = llvm::sys::Memory::allocateMappedMemory(
+    code.size(),
+    nullptr,
+    llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_WRITE,
+    ec);
+  if (ec) {
+    std::cout << "Error: unable to allocate executable memory: "
+              << ec.message() << '\n';
+    return false;
+  }
+  mMem = llvm::sys::OwningMemoryBlock(block);
+  std::memcpy(block.base(), code.data(), code.size());
+  ec = llvm::sys::Memory::protectMappedMemory(
+    block, llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_EXEC);
+  if (ec) {
+    std::cout << "Error: unable to allocate executable memory: "
+              << ec.message() << '\n';
+    return false;
+  }
+  llvm::sys::Memory::InvalidateInstructionCache(block.base(), code.size());
+  mSize = code.size();
+  return true;
+}
+
+int
+Baseline::run()
+{
+  // 与解释器一样只分配不初始化
+  std::unique_ptr<std::int64_t[]> regs(new std::int64_t[mVm.mStackRegs]);
+  std::unique_ptr<std::uint8_t[]> mem(new std::uint8_t[mVm.mStackBytes]);
+
+  auto entry = reinterpret_cast<Entry>(mMem.base());
+  auto ret = entry(regs.get(),
+                   mem.get(),
+                   mVm.globals(),
+                   regs.get() + mVm.mStackRegs,
+                   mem.get() + mVm.mStackBytes);
+  mVm.printTimer();
+  return int(ret);
+}
+
+#else
+
+bool
+Baseline::operator()()
+{
+  std::cout << "Error: the baseline compiler only supports x86-64\n";
+  return false;
+}
+
+int
+Baseline::run()
+{
+  ABORT();
+}
+
+#endif
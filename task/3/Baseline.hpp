@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Vm.hpp"
+#include <llvm/Support/Memory.h>
+
+/**
+ * @brief 基线编译器
+ *
+ * 不经过 LLVM，把 Vm 翻译好的字节码逐条直接翻译为 x86-64 机器码，写进一块
+ * 可执行内存后运行，编译速度与解释器的翻译相当。
+ *
+ * 数据布局与解释器完全相同：寄存器窗口仍在单独的寄存器栈上，每个字节码寄存
+ * 器就是一个 8 字节的栈槽，局部数组仍在局部数组栈上，全局内存就是解释器的全
+ * 局内存。生成的代码固定用 rbx 指向寄存器窗口，r12 指向局部数组栈帧，r13 指
+ * 向全局内存，r14、r15 是两个栈的上界；调用时移动 rbx 和 r12，本机栈上只有返
+ * 回地址。
+ *
+ * 寄存器分配只做窥孔级别的缓存：记住 rax、rcx、rdx 中现在是哪个字节码寄存器
+ * 的值，顺序执行时可以省去重复的读取；写回总是立即进行，跳转目标和调用之后缓
+ * 存全部作废。运行时库函数经由 Vm::native 调用，计时器和输入输出都与解释执
+ * 行时一致。
+ */
+class Baseline
+{
+public:
+  explicit Baseline(Vm& vm)
+    : mVm(vm)
+  {
+  }
+
+  /// 翻译全部字节码，失败时在标准输出打印错误信息并返回 false
+  bool operator()();
+
+  /// 运行翻译好的程序，返回进程应当使用的返回码
+  int run();
+
+  /// 生成的机器码的字节数
+  std::size_t size() const { return mSize; }
+
+private:
+  Vm& mVm;
+  llvm::sys::OwningMemoryBlock mMem;
+  std::size_t mSize{ 0 };
+};
@@ -0,0 +1,320 @@
+#include "Bin2Asg.hpp"
+
+using namespace asg;
+
+TranslationUnit*
+Bin2Asg::operator()(llvm::StringRef buf)
+{
+  ASSERT(is_bin(buf));
+  // 各段都是 4 字节对齐的数组，缓冲区本身也要满足对齐要求
+  ASSERT(reinterpret_cast<std::uintptr_t>(buf.data()) % 4 == 0);
+
+  mHeader = reinterpret_cast<const bin::Header*>(buf.data());
+  ASSERT(mHeader->version == bin::kVersion);
+
+  auto p = buf.data() + sizeof(bin::Header);
+  mTypeRecs = reinterpret_cast<const bin::Type*>(p);
+  p += mHeader->nTypes * sizeof(bin::Type);
+  mTexpRecs = reinterpret_cast<const bin::Texp*>(p);
+  p += mHeader->nTexps * sizeof(bin::Texp);
+  mNodeRecs = reinterpret_cast<const bin::Node*>(p);
+  p += mHeader->nNodes * sizeof(bin::Node);
+  mLists = reinterpret_cast<const std::uint32_t*>(p);
+  p += mHeader->nLists * sizeof(std::uint32_t);
+  mStrs = p;
+  p += mHeader->nStrs;
+  ASSERT(p <= buf.end());
+
+  // 第一遍：创建全部对象
+  mTypes.resize(mHeader->nTypes);
+  for (auto& i : mTypes)
+    i = mMgr.make<Type>();
+
+  mTexps.resize(mHeader->nTexps);
+  for (std::uint32_t i = 0; i < mHeader->nTexps; ++i) {
+    switch (mTexpRecs[i].kind) {
+      case bin::Texp::kPointer:
+        mTexps[i] = mMgr.make<PointerType>();
+        break;
+      case bin::Texp::kArray:
+        mTexps[i] = mMgr.make<ArrayType>();
+        break;
+      case bin::Texp::kFunction:
+        mTexps[i] = mMgr.make<FunctionType>();
+        break;
+      default:
+        ABORT();
+    }
+  }
+
+  mNodes.resize(mHeader->nNodes);
+  for (std::uint32_t i = 0; i < mHeader->nNodes; ++i)
+    mNodes[i] = create(mNodeRecs[i]);
+
+  // 第二遍：填充字段
+  for (std::uint32_t i = 0; i < mHeader->nTypes; ++i) {
+    auto& rec = mTypeRecs[i];
+    auto ty = mTypes[i];
+    ty->spec = Type::Spec(rec.spec);
+    ty->qual.const_ = rec.const_;
+    ty->texp = texp(rec.texp);
+  }
+
+  for (std::uint32_t i = 0; i < mHeader->nTexps; ++i) {
+    auto& rec = mTexpRecs[i];
+    auto te = mTexps[i];
+    te->sub = texp(rec.sub);
+    switch (rec.kind) {
+      case bin::Texp::kPointer:
+        te->scst<PointerType>()->qual.const_ = rec.const_;
+        break;
+      case bin::Texp::kArray:
+        te->scst<ArrayType>()->len = rec.a;
+        break;
+      case bin::Texp::kFunction: {
+        ASSERT(rec.a <= mHeader->nLists && rec.b <= mHeader->nLists - rec.a);
+        auto& params = te->scst<FunctionType>()->params;
+        params.reserve(rec.b);
+        for (std::uint32_t j = 0; j < rec.b; ++j)
+          params.push_back(type(mLists[rec.a + j]));
+      } break;
+    }
+  }
+
+  for (std::uint32_t i = 0; i < mHeader->nNodes; ++i)
+    fill(mNodes[i], mNodeRecs[i]);
+
+  return node<TranslationUnit>(mHeader->root);
+}
+
+const Type*
+Bin2Asg::type(std::uint32_t idx)
+{
+  if (idx == bin::kNone)
+    return nullptr;
+  ASSERT(idx < mTypes.size());
+  return mTypes[idx];
+}
+
+TypeExpr*
+Bin2Asg::texp(std::uint32_t idx)
+{
+  if (idx == bin::kNone)
+    return nullptr;
+  ASSERT(idx < mTexps.size());
+  return mTexps[idx];
+}
+
+template<typename T>
+T*
+Bin2Asg::node(std::uint32_t idx)
+{
+  if (idx == bin::kNone)
+    return nullptr;
+  ASSERT(idx < mNodes.size());
+  auto ret = mNodes[idx]->dcst<T>();
+  ASSERT(ret);
+  return ret;
+}
+
+template<typename T>
+void
+Bin2Asg::list(const bin::Node& rec, std::vector<T*>& v)
+{
+  ASSERT(rec.d == 0 || (rec.c <= mHeader->nLists &&
+                        rec.d <= mHeader->nLists - rec.c));
+  v.reserve(rec.d);
+  for (std::uint32_t i = 0; i < rec.d; ++i)
+    v.push_back(node<T>(mLists[rec.c + i]));
+}
+
+std::string
+Bin2Asg::str(std::uint32_t off)
+{
+  ASSERT(off + sizeof(std::uint32_t) <= mHeader->nStrs);
+  auto len = *reinterpret_cast<const std::uint32_t*>(mStrs + off);
+  ASSERT(off + sizeof(std::uint32_t) + len <= mHeader->nStrs);
+  return std::string(mStrs + off + sizeof(std::uint32_t), len);
+}
+
+Obj*
+Bin2Asg::create(const bin::Node& rec)
+{
+  switch (rec.kind) {
+    case bin::Node::kIntegerLiteral:
+      return mMgr.make<IntegerLiteral>();
+    case bin::Node::kStringLiteral:
+      return mMgr.make<StringLiteral>();
+    case bin::Node::kDeclRefExpr:
+      return mMgr.make<DeclRefExpr>();
+    case bin::Node::kParenExpr:
+      return mMgr.make<ParenExpr>();
+    case bin::Node::kUnaryExpr:
+      return mMgr.make<UnaryExpr>();
+    case bin::Node::kBinaryExpr:
+      return mMgr.make<BinaryExpr>();
+    case bin::Node::kCallExpr:
+      return mMgr.make<CallExpr>();
+    case bin::Node::kInitListExpr:
+      return mMgr.make<InitListExpr>();
+    case bin::Node::kImplicitInitExpr:
+      return mMgr.make<ImplicitInitExpr>();
+    case bin::Node::kImplicitCastExpr:
+      return mMgr.make<ImplicitCastExpr>();
+
+    case bin::Node::kNullStmt:
+      return mMgr.make<NullStmt>();
+    case bin::Node::kDeclStmt:
+      return mMgr.make<DeclStmt>();
+    case bin::Node::kExprStmt:
+      return mMgr.make<ExprStmt>();
+    case bin::Node::kCompoundStmt:
+      return mMgr.make<CompoundStmt>();
+    case bin::Node::kIfStmt:
+      return mMgr.make<IfStmt>();
+    case bin::Node::kWhileStmt:
+      return mMgr.make<WhileStmt>();
+    case bin::Node::kDoStmt:
+      return mMgr.make<DoStmt>();
+    case bin::Node::kBreakStmt:
+      return mMgr.make<BreakStmt>();
+    case bin::Node::kContinueStmt:
+      return mMgr.make<ContinueStmt>();
+    case bin::Node::kReturnStmt:
+      return mMgr.make<ReturnStmt>();
+
+    case bin::Node::kVarDecl:
+      return mMgr.make<VarDecl>();
+    case bin::Node::kFunctionDecl:
+      return mMgr.make<FunctionDecl>();
+
+    case bin::Node::kTranslationUnit:
+      return mMgr.make<TranslationUnit>();
+  }
+  ABORT();
+}
+
+void
+Bin2Asg::fill(Obj* obj, const bin::Node& rec)
+{
+  if (auto p = obj->dcst<Expr>()) {
+    p->type = type(rec.type);
+    p->cate = Expr::Cate(rec.cate);
+  } else if (auto p = obj->dcst<Decl>()) {
+    p->type = type(rec.type);
+    p->name = str(rec.a);
+  }
+
+  switch (rec.kind) {
+    case bin::Node::kIntegerLiteral:
+      obj->scst<IntegerLiteral>()->val =
+        std::uint64_t(rec.a) | std::uint64_t(rec.b) << 32;
+      break;
+
+    case bin::Node::kStringLiteral:
+      obj->scst<StringLiteral>()->val = str(rec.a);
+      break;
+
+    case bin::Node::kDeclRefExpr:
+      obj->scst<DeclRefExpr>()->decl = node<Decl>(rec.a);
+      break;
+
+    case bin::Node::kParenExpr:
+      obj->scst<ParenExpr>()->sub = node<Expr>(rec.a);
+      break;
+
+    case bin::Node::kUnaryExpr: {
+      auto p = obj->scst<UnaryExpr>();
+      p->op = UnaryExpr::Op(rec.op);
+      p->sub = node<Expr>(rec.a);
+    } break;
+
+    case bin::Node::kBinaryExpr: {
+      auto p = obj->scst<BinaryExpr>();
+      p->op = BinaryExpr::Op(rec.op);
+      p->lft = node<Expr>(rec.a);
+      p->rht = node<Expr>(rec.b);
+    } break;
+
+    case bin::Node::kCallExpr: {
+      auto p = obj->scst<CallExpr>();
+      p->head = node<Expr>(rec.a);
+      list(rec, p->args);
+    } break;
+
+    case bin::Node::kInitListExpr:
+      list(rec, obj->scst<InitListExpr>()->list);
+      break;
+
+    case bin::Node::kImplicitInitExpr:
+      break;
+
+    case bin::Node::kImplicitCastExpr: {
+      auto p = obj->scst<ImplicitCastExpr>();
+      p->kind = decltype(p->kind)(rec.op);
+      p->sub = node<Expr>(rec.a);
+    } break;
+
+    case bin::Node::kNullStmt:
+      break;
+
+    case bin::Node::kDeclStmt:
+      list(rec, obj->scst<DeclStmt>()->decls);
+      break;
+
+    case bin::Node::kExprStmt:
+      obj->scst<ExprStmt>()->expr = node<Expr>(rec.a);
+      break;
+
+    case bin::Node::kCompoundStmt:
+      list(rec, obj->scst<CompoundStmt>()->subs);
+      break;
+
+    case bin::Node::kIfStmt: {
+      auto p = obj->scst<IfStmt>();
+      p->cond = node<Expr>(rec.a);
+      p->then = node<Stmt>(rec.b);
+      p->else_ = node<Stmt>(rec.c);
+    } break;
+
+    case bin::Node::kWhileStmt: {
+      auto p = obj->scst<WhileStmt>();
+      p->cond = node<Expr>(rec.a);
+      p->body = node<Stmt>(rec.b);
+    } break;
+
+    case bin::Node::kDoStmt: {
+      auto p = obj->scst<DoStmt>();
+      p->body = node<Stmt>(rec.a);
+      p->cond = node<Expr>(rec.b);
+    } break;
+
+    case bin::Node::kBreakStmt:
+      obj->scst<BreakStmt>()->loop = node<Stmt>(rec.a);
+      break;
+
+    case bin::Node::kContinueStmt:
+      obj->scst<ContinueStmt>()->loop = node<Stmt>(rec.a);
+      break;
+
+    case bin::Node::kReturnStmt: {
+      auto p = obj->scst<ReturnStmt>();
+      p->func = node<FunctionDecl>(rec.a);
+      p->expr = node<Expr>(rec.b);
+    } break;
+
+    case bin::Node::kVarDecl:
+      obj->scst<VarDecl>()->init = node<Expr>(rec.b);
+      break;
+
+    case bin::Node::kFunctionDecl: {
+      auto p = obj->scst<FunctionDecl>();
+      list(rec, p->params);
+      p->body = node<CompoundStmt>(rec.b);
+    } break;
+
+    case bin::Node::kTranslationUnit:
+      list(rec, obj->scst<TranslationUnit>()->decls);
+      break;
+  }
+}
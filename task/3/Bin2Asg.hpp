@@ -0,0 +1,61 @@
+#pragma once
+
+#include "AsgBin.hpp"
+#include "asg.hpp"
+#include <llvm/ADT/StringRef.h>
+
+/**
+ * @brief 从 AsgBin.hpp 定义的二进制格式读取抽象语义图
+ *
+ * 输入缓冲区通常直接来自 mmap，各段按数组原地访问。读取分两遍：第一遍按
+ * 记录种类创建全部对象，第二遍按下标填充对象之间的引用，因此不需要关心
+ * 记录之间的先后顺序。
+ */
+class Bin2Asg
+{
+public:
+  Obj::Mgr& mMgr;
+
+  Bin2Asg(Obj::Mgr& mgr)
+    : mMgr(mgr)
+  {
+  }
+
+  /// 检查 \p buf 是否为二进制格式。
+  static bool is_bin(llvm::StringRef buf)
+  {
+    return asg::bin::is_bin(buf.data(), buf.size());
+  }
+
+  asg::TranslationUnit* operator()(llvm::StringRef buf);
+
+private:
+  const asg::bin::Header* mHeader{ nullptr };
+  const asg::bin::Type* mTypeRecs{ nullptr };
+  const asg::bin::Texp* mTexpRecs{ nullptr };
+  const asg::bin::Node* mNodeRecs{ nullptr };
+  const std::uint32_t* mLists{ nullptr };
+  const char* mStrs{ nullptr };
+
+  std::vector<asg::Type*> mTypes;
+  std::vector<asg::TypeExpr*> mTexps;
+  std::vector<Obj*> mNodes;
+
+  const asg::Type* type(std::uint32_t idx);
+
+  asg::TypeExpr* texp(std::uint32_t idx);
+
+  template<typename T>
+  T* node(std::uint32_t idx);
+
+  template<typename T>
+  void list(const asg::bin::Node& rec, std::vector<T*>& v);
+
+  std::string str(std::uint32_t off);
+
+  /// 按记录种类创建空对象
+  Obj* create(const asg::bin::Node& rec);
+
+  /// 填充对象的字段
+  void fill(Obj* obj, const asg::bin::Node& rec);
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <initializer_list>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+/**
+ * @brief 内容寻址的磁盘编译缓存
+ *
+ * 缓存项以键命名为 llvmcache-<键>，键是输入内容、编译阶段、流水线描述和编译
+ * 器构建标识的 SHA1。写入时先写临时文件再原子地重命名，多个进程同时写同一
+ * 项也只会留下某个完整的版本；命中时刷新文件时间，超出容量时由
+ * llvm::pruneCache 按最近访问时间淘汰。命中与未命中的累计次数以两个定宽的十
+ * 进制数记在缓存目录的 stats 中，文件大小固定，加锁后读出、累加、写回，并发
+ * 运行也不会丢失计数；一次运行中的计数先记在内存里，析构时一并写入。
+ *
+ * 缓存只影响速度不影响结果，所以读写缓存时遇到的错误都直接忽略。
+ *
+ * 本文件在 task/3 与 task/4 中各有一份，两者必须保持一致。
+ */
+class Cache
+{
+public:
+  std::string mDir;
+  std::uint64_t mMaxBytes;
+
+  Cache(std::string dir, std::uint64_t maxBytes);
+
+  ~Cache();
+
+  /**
+   * 计算缓存键：\p parts 依次参与哈希，再加上编译器可执行文件的构建标识，重
+   * 新构建编译器后旧的缓存项自然失效。构建标识取链接器生成的 GNU build ID，
+   * 没有时取由 \p argv0 找到的可执行文件内容的 SHA1，内容相同的编译器在不同
+   * 的机器上可以共享缓存。
+   */
+  static std::string key(const char* argv0,
+                         std::initializer_list<llvm::StringRef> parts);
+
+  /// 查找缓存项，未命中时返回空。
+  std::unique_ptr<llvm::MemoryBuffer> lookup(llvm::StringRef key);
+
+  /**
+   * 写入缓存项，\p prune 为真时随后检查容量，淘汰最久未用的项。检查需要扫描
+   * 整个目录，连续写入多项时只需在最后一次写入时检查。
+   */
+  void store(llvm::StringRef key, llvm::StringRef data, bool prune = true);
+
+  /// 打印累计的命中统计。
+  void print_stats(llvm::raw_ostream& os);
+
+private:
+  std::uint64_t mHits{ 0 }, mMisses{ 0 }; /// 尚未写入统计文件的计数
+
+  std::string entry_path(llvm::StringRef key);
+
+  /// 把内存中的计数累加到统计文件，返回累计的命中与未命中次数
+  std::pair<std::uint64_t, std::uint64_t> flush_stats();
+};
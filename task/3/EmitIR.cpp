@@ -1,6 +1,7 @@
 #include "EmitIR.hpp"
-#include <stack>
 #include <iostream>
+#include <llvm/IR/CFG.h>
+#include <llvm/Transforms/Utils/Local.h>
 #include <llvm/Transforms/Utils/ModuleUtils.h>
 #include <llvm/IR/ValueSymbolTable.h>
 
@@ -52,44 +53,58 @@ EmitIR::operator()(asg::TranslationUnit* tu)
 llvm::Type*
 EmitIR::operator()(const Type* type)
 {
-  if (type->texp == nullptr) {
-    switch (type->spec) {
+  return lowerType(type->spec, type->texp);
+}
+
+llvm::Type*
+EmitIR::lowerType(Type::Spec spec, TypeExpr* texp)
+{
+  // 递归时可能插入新的项，查找和插入要分开，不能持有 DenseMap 的引用
+  std::pair<unsigned, const TypeExpr*> key(unsigned(spec), texp);
+  if (auto it = mTypes.find(key); it != mTypes.end())
+    return it->second;
+
+  llvm::Type* ty;
+  if (texp == nullptr) {
+    switch (spec) {
       case Type::Spec::kInt:
-        return llvm::Type::getInt32Ty(mCtx);
+        ty = llvm::Type::getInt32Ty(mCtx);
+        break;
       // TODO: 在此添加对更多基础类型的处理
       case Type::Spec::kVoid:
-        return llvm::Type::getVoidTy(mCtx);
+        ty = llvm::Type::getVoidTy(mCtx);
+        break;
       default:
         ABORT();
     }
   }
 
-  Type subt;
-  subt.spec = type->spec;
-  subt.qual = type->qual;
-  subt.texp = type->texp->sub;
-
   // TODO: 在此添加对指针类型、数组类型和函数类型的处理
 
-  if (auto p = type->texp->dcst<PointerType>()) {
-    return self(&subt)->getPointerTo();
+  else if (auto p = texp->dcst<PointerType>()) {
+    ty = lowerType(spec, p->sub)->getPointerTo();
   }
 
-  if (auto p = type->texp->dcst<ArrayType>()) {
+  else if (auto p = texp->dcst<ArrayType>()) {
     if (p->len == ArrayType::kUnLen)
-      return self(&subt)->getPointerTo();
-    return llvm::ArrayType::get(self(&subt), p->len);
+      ty = lowerType(spec, p->sub)->getPointerTo();
+    else
+      ty = llvm::ArrayType::get(lowerType(spec, p->sub), p->len);
   }
 
-  if (auto p = type->texp->dcst<FunctionType>()) {
+  else if (auto p = texp->dcst<FunctionType>()) {
     std::vector<llvm::Type*> pty;
     // TODO: 在此添加对函数参数类型的处理
     for (auto &param : p->params)
       pty.push_back(self(param));
-    return llvm::FunctionType::get(self(&subt), std::move(pty), false);
+    ty = llvm::FunctionType::get(lowerType(spec, p->sub), std::move(pty), false);
   }
 
-  ABORT();
+  else
+    ABORT();
+
+  mTypes.try_emplace(key, ty);
+  return ty;
 }
 
 //==============================================================================
@@ -137,6 +152,10 @@ llvm::Value* EmitIR::operator()(ParenExpr* obj) {
 }
 
 llvm::Value* EmitIR::operator()(UnaryExpr* obj) {
+  // 逻辑非的结果是 0 或 1，求出 i1 后再扩展为表达式的类型
+  if (obj->op == UnaryExpr::Op::kNot)
+    return mCurIrb->CreateZExt(condValue(obj), self(obj->type));
+
   auto sub = self(obj->sub);
 
   auto &irb = *mCurIrb;
@@ -146,10 +165,6 @@ llvm::Value* EmitIR::operator()(UnaryExpr* obj) {
       return sub;
     case UnaryExpr::Op::kNeg:
       return irb.CreateNeg(sub);
-    case UnaryExpr::Op::kNot: {
-      llvm::Value* toBool = sub->getType()->isIntegerTy(1) ? sub : irb.CreateICmpNE(sub, llvm::Constant::getNullValue(sub->getType()));
-      return irb.CreateNot(toBool);
-    }
     default:
       ABORT();
   }
@@ -159,21 +174,11 @@ llvm::Value* EmitIR::operator()(UnaryExpr* obj) {
 llvm::Value* EmitIR::operator()(BinaryExpr* obj) {
   auto& irb = *mCurIrb;
 
-  auto lft = self(obj->lft);
+  // 比较和逻辑运算的结果是 int 类型的 0 或 1
+  if (isCond(obj))
+    return irb.CreateZExt(condValue(obj), self(obj->type));
 
-  switch (obj->op) {
-    case BinaryExpr::Op::kOr: {
-
-      auto rht = self(obj->rht);
-      return irb.CreateOr(lft, rht);
-
-    }
-
-    case BinaryExpr::Op::kAnd: {
-      auto rht = self(obj->rht);
-      return irb.CreateAnd(lft, rht);
-    }    
-  }
+  auto lft = self(obj->lft);
   auto rht = self(obj->rht);
   switch (obj->op)
   {
@@ -187,18 +192,6 @@ llvm::Value* EmitIR::operator()(BinaryExpr* obj) {
       return irb.CreateSDiv(lft, rht);
     case BinaryExpr::Op::kMod:
       return irb.CreateSRem(lft, rht);
-    case BinaryExpr::Op::kEq:
-      return irb.CreateICmpEQ(lft, rht);
-    case BinaryExpr::Op::kNe:
-      return irb.CreateICmpNE(lft, rht);
-    case BinaryExpr::Op::kLt:
-      return irb.CreateICmpSLT(lft, rht);
-    case BinaryExpr::Op::kLe:
-      return irb.CreateICmpSLE(lft, rht);
-    case BinaryExpr::Op::kGt:
-      return irb.CreateICmpSGT(lft, rht);
-    case BinaryExpr::Op::kGe:
-      return irb.CreateICmpSGE(lft, rht);
     case BinaryExpr::Op::kComma:
       return rht;
     case BinaryExpr::Op::kAssign:
@@ -267,6 +260,155 @@ llvm::Value* EmitIR::operator()(CallExpr* obj) {
 
 }
 
+//==============================================================================
+// 条件
+//==============================================================================
+
+// 条件的翻译过程中只移动 mCurIrb 的插入点，不替换 mCurIrb，外层表达式先前取
+// 得的 IRBuilder 引用仍然有效
+
+bool
+EmitIR::isCond(Expr* obj)
+{
+  if (auto p = obj->dcst<ParenExpr>())
+    return isCond(p->sub);
+
+  if (auto p = obj->dcst<UnaryExpr>())
+    return p->op == UnaryExpr::kNot;
+
+  if (auto p = obj->dcst<BinaryExpr>()) {
+    switch (p->op) {
+      case BinaryExpr::kEq:
+      case BinaryExpr::kNe:
+      case BinaryExpr::kLt:
+      case BinaryExpr::kLe:
+      case BinaryExpr::kGt:
+      case BinaryExpr::kGe:
+      case BinaryExpr::kAnd:
+      case BinaryExpr::kOr:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  return false;
+}
+
+void
+EmitIR::condBr(Expr* obj, llvm::BasicBlock* trueBb, llvm::BasicBlock* falseBb)
+{
+  auto& irb = *mCurIrb;
+
+  if (auto p = obj->dcst<ParenExpr>())
+    return condBr(p->sub, trueBb, falseBb);
+
+  if (auto p = obj->dcst<UnaryExpr>()) {
+    if (p->op == UnaryExpr::kNot)
+      return condBr(p->sub, falseBb, trueBb);
+  }
+
+  if (auto p = obj->dcst<BinaryExpr>()) {
+    if (p->op == BinaryExpr::kAnd || p->op == BinaryExpr::kOr) {
+      auto rhtBb = llvm::BasicBlock::Create(mCtx, "cond.rhs", mCurFunc);
+      if (p->op == BinaryExpr::kAnd)
+        condBr(p->lft, rhtBb, falseBb);
+      else
+        condBr(p->lft, trueBb, rhtBb);
+      irb.SetInsertPoint(rhtBb);
+      return condBr(p->rht, trueBb, falseBb);
+    }
+  }
+
+  // 常量条件（例如 while (1)）直接跳转，另一个分支不可达
+  auto cond = condValue(obj);
+  if (auto c = llvm::dyn_cast<llvm::ConstantInt>(cond))
+    irb.CreateBr(c->isZero() ? falseBb : trueBb);
+  else
+    irb.CreateCondBr(cond, trueBb, falseBb);
+}
+
+llvm::Value*
+EmitIR::condValue(Expr* obj)
+{
+  auto& irb = *mCurIrb;
+
+  if (auto p = obj->dcst<ParenExpr>())
+    return condValue(p->sub);
+
+  if (auto p = obj->dcst<UnaryExpr>()) {
+    if (p->op == UnaryExpr::kNot) {
+      // 刚生成的比较没有其他使用者，直接取反谓词，省掉一条 xor
+      auto sub = condValue(p->sub);
+      if (auto cmp = llvm::dyn_cast<llvm::ICmpInst>(sub)) {
+        if (cmp->use_empty()) {
+          cmp->setPredicate(cmp->getInversePredicate());
+          return cmp;
+        }
+      }
+      return irb.CreateNot(sub);
+    }
+  }
+
+  if (auto p = obj->dcst<BinaryExpr>()) {
+    auto pred = llvm::CmpInst::BAD_ICMP_PREDICATE;
+    switch (p->op) {
+      case BinaryExpr::kEq:
+        pred = llvm::CmpInst::ICMP_EQ;
+        break;
+      case BinaryExpr::kNe:
+        pred = llvm::CmpInst::ICMP_NE;
+        break;
+      case BinaryExpr::kLt:
+        pred = llvm::CmpInst::ICMP_SLT;
+        break;
+      case BinaryExpr::kLe:
+        pred = llvm::CmpInst::ICMP_SLE;
+        break;
+      case BinaryExpr::kGt:
+        pred = llvm::CmpInst::ICMP_SGT;
+        break;
+      case BinaryExpr::kGe:
+        pred = llvm::CmpInst::ICMP_SGE;
+        break;
+
+      case BinaryExpr::kAnd:
+      case BinaryExpr::kOr: {
+        // 左操作数决定结果时跳过右操作数，在汇合处用 phi 选出结果
+        auto endBb = llvm::BasicBlock::Create(mCtx, "cond.end", mCurFunc);
+        auto rhtBb = llvm::BasicBlock::Create(mCtx, "cond.rhs", mCurFunc);
+        bool isAnd = p->op == BinaryExpr::kAnd;
+        if (isAnd)
+          condBr(p->lft, rhtBb, endBb);
+        else
+          condBr(p->lft, endBb, rhtBb);
+        irb.SetInsertPoint(rhtBb);
+        auto rht = condValue(p->rht);
+        auto rhtEnd = irb.GetInsertBlock();
+        irb.CreateBr(endBb);
+
+        irb.SetInsertPoint(endBb);
+        auto phi = irb.CreatePHI(irb.getInt1Ty(), 2);
+        auto skipped = irb.getInt1(!isAnd);
+        for (auto pred : llvm::predecessors(endBb))
+          phi->addIncoming(pred == rhtEnd ? rht : skipped, pred);
+        return phi;
+      }
+
+      default:
+        break;
+    }
+    if (pred != llvm::CmpInst::BAD_ICMP_PREDICATE) {
+      auto lft = self(p->lft);
+      auto rht = self(p->rht);
+      return irb.CreateICmp(pred, lft, rht);
+    }
+  }
+
+  auto val = self(obj);
+  return irb.CreateICmpNE(val, llvm::Constant::getNullValue(val->getType()));
+}
+
 //==============================================================================
 // 语句
 //==============================================================================
@@ -278,6 +420,9 @@ EmitIR::operator()(Stmt* obj)
   auto& irb = *mCurIrb;
 
   if (auto p = obj->dcst<CompoundStmt>()) {
+    // alloca 都在入口块里时，块作用域不需要保存和恢复栈指针
+    if (mEntryAllocas)
+      return self(p);
     auto sp = irb.CreateIntrinsic(llvm::Intrinsic::stacksave, {}, {}, nullptr, "sp");
     return self(p);
     irb.CreateIntrinsic(llvm::Intrinsic::stackrestore, {}, {sp});
@@ -344,29 +489,32 @@ void EmitIR::operator()(WhileStmt* obj) {
   irb.CreateBr(condBb);
 
   mCurIrb = std::make_unique<llvm::IRBuilder<>>(condBb);
-  auto cond = self(obj->cond);
-  if (mCurIrb->GetInsertBlock()->getTerminator() == nullptr)
-    mCurIrb->CreateCondBr(cond, bodyBb, exitBb);
+  condBr(obj->cond, bodyBb, exitBb);
 
   mCurIrb = std::make_unique<llvm::IRBuilder<>>(bodyBb);
   self(obj->body);
   if (mCurIrb->GetInsertBlock()->getTerminator() == nullptr)
     mCurIrb->CreateBr(condBb);
 
+  // 条件恒真且没有 break 时循环之后不可达，插入点留在已终结的块上
+  if (llvm::pred_empty(exitBb)) {
+    exitBb->eraseFromParent();
+    return;
+  }
   mCurIrb = std::make_unique<llvm::IRBuilder<>>(exitBb);
 
 }
 
 void EmitIR::operator()(IfStmt* obj) {
-  auto &irb = *mCurIrb;
-
-  auto cond = self(obj->cond);
-  auto thenBb = llvm::BasicBlock::Create(mCtx, "then", mCurFunc);
-  auto elseBb = llvm::BasicBlock::Create(mCtx, "else", mCurFunc);
-  auto exitBb = llvm::BasicBlock::Create(mCtx, "exit", mCurFunc);
+  // 先生成条件里的基本块，分支的基本块在跳转目标确定后再放进函数，保持
+  // 条件、then、else、exit 的顺序
+  auto thenBb = llvm::BasicBlock::Create(mCtx, "then");
+  auto elseBb = obj->else_ ? llvm::BasicBlock::Create(mCtx, "else") : nullptr;
+  auto exitBb = llvm::BasicBlock::Create(mCtx, "exit");
 
-  irb.CreateCondBr(cond, thenBb, elseBb);
+  condBr(obj->cond, thenBb, elseBb ? elseBb : exitBb);
 
+  thenBb->insertInto(mCurFunc);
   mCurIrb = std::make_unique<llvm::IRBuilder<>>(thenBb);
   if (obj->then) {
     self(obj->then);
@@ -374,14 +522,20 @@ void EmitIR::operator()(IfStmt* obj) {
   if (mCurIrb->GetInsertBlock()->getTerminator() == nullptr)
     mCurIrb->CreateBr(exitBb);
 
-
-  mCurIrb = std::make_unique<llvm::IRBuilder<>>(elseBb);
-  if (obj->else_) {
+  if (elseBb) {
+    elseBb->insertInto(mCurFunc);
+    mCurIrb = std::make_unique<llvm::IRBuilder<>>(elseBb);
     self(obj->else_);
+    if (mCurIrb->GetInsertBlock()->getTerminator() == nullptr)
+      mCurIrb->CreateBr(exitBb);
   }
-  if (mCurIrb->GetInsertBlock()->getTerminator() == nullptr)
-    mCurIrb->CreateBr(exitBb);
 
+  // 两个分支都已经返回或跳出时 if 之后不可达，插入点留在已终结的块上
+  if (llvm::pred_empty(exitBb)) {
+    delete exitBb;
+    return;
+  }
+  exitBb->insertInto(mCurFunc);
   mCurIrb = std::make_unique<llvm::IRBuilder<>>(exitBb);
 }
 
@@ -394,11 +548,14 @@ EmitIR::operator()(ExprStmt* obj)
 void
 EmitIR::operator()(CompoundStmt* obj)
 {
-  auto& irb = *mCurIrb;
   // TODO: 可以在此添加对符号重名的处理
-  
-  for (auto&& stmt : obj->subs)
+
+  for (auto&& stmt : obj->subs) {
+    // return、break、continue 之后的语句不可达，不再生成
+    if (mCurIrb->GetInsertBlock()->getTerminator())
+      break;
     self(stmt);
+  }
 }
 
 void EmitIR::operator()(DeclStmt* obj) {
@@ -409,30 +566,16 @@ void EmitIR::operator()(DeclStmt* obj) {
 void
 EmitIR::operator()(ReturnStmt* obj)
 {
-  auto& irb = *mCurIrb;
-
-  llvm::Value* retVal;
-  if (!obj->expr)
-    retVal = nullptr;
-  else
-    retVal = self(obj->expr);
-
-  mCurIrb->CreateRet(retVal);
-
-  auto exitBb = llvm::BasicBlock::Create(mCtx, "return_exit", mCurFunc);
-  mCurIrb = std::make_unique<llvm::IRBuilder<>>(exitBb);
+  // 返回值先存入返回槽，再跳到统一的出口块
+  if (obj->expr)
+    mCurIrb->CreateStore(self(obj->expr), mRetSlot);
+  mCurIrb->CreateBr(mRetBb);
 }
 
 //==============================================================================
 // 声明
 //==============================================================================
 
-struct element {
-  InitListExpr* initList;
-  llvm::Type* type;
-  llvm::Value* dst;
-};
-
 void EmitIR::transInit(llvm::Value* dst, Expr* src, VarDecl* obj) {
   auto& irb = *mCurIrb;
 
@@ -441,37 +584,6 @@ void EmitIR::transInit(llvm::Value* dst, Expr* src, VarDecl* obj) {
     irb.CreateStore(initVal, dst);
     return;
   }
-  if (auto p = src->dcst<InitListExpr>()) {
-    std::stack<element> stack;
-    stack.push({p, self(obj->type), dst});
-
-    while (!stack.empty()) {
-      auto element = stack.top();
-      stack.pop();
-      auto type = element.type;
-      auto initList = element.initList;
-      auto dst = element.dst;
-
-      for (int i = type->getArrayNumElements()-1; i>=0; i--) {
-        int listsize = initList->list.size();
-        if (i < initList->list.size()) {
-          auto sub = initList->list[i];
-          auto subDst = irb.CreateInBoundsGEP(type, dst, {irb.getInt64(0), irb.getInt64(i)});
-          if (auto p = sub->dcst<InitListExpr>()) {
-            stack.push({p,type->getArrayElementType() ,subDst});
-          } else {
-            transInit(subDst, sub, obj);
-          }
-        }
-        else {
-          auto initVal = llvm::Constant::getNullValue(type->getArrayElementType());
-          auto subDst = irb.CreateInBoundsGEP(type, dst, {irb.getInt64(0), irb.getInt64(i)});
-          irb.CreateStore(initVal, subDst);
-        }
-      }
-    }
-    return;
-  }
 
   if (auto p = src->dcst<ImplicitInitExpr>()) {
     auto initVal = llvm::Constant::getNullValue(self(obj->type));
@@ -518,6 +630,297 @@ void EmitIR::transInit(llvm::Value* dst, Expr* src, VarDecl* obj) {
   ABORT();
 }
 
+llvm::Constant*
+EmitIR::constInit(llvm::Type* type, Expr* obj)
+{
+  if (obj->dcst<ImplicitInitExpr>())
+    return llvm::Constant::getNullValue(type);
+
+  if (auto p = obj->dcst<InitListExpr>()) {
+    auto arrTy = llvm::dyn_cast<llvm::ArrayType>(type);
+    if (arrTy == nullptr) {
+      if (p->list.empty())
+        return llvm::Constant::getNullValue(type);
+      return constInit(type, p->list[0]);
+    }
+
+    auto elemTy = arrTy->getElementType();
+    std::vector<llvm::Constant*> elems;
+    elems.reserve(arrTy->getNumElements());
+    for (std::uint64_t i = 0; i < arrTy->getNumElements(); ++i) {
+      if (i >= p->list.size()) {
+        elems.push_back(llvm::Constant::getNullValue(elemTy));
+        continue;
+      }
+      auto elem = constInit(elemTy, p->list[i]);
+      if (elem == nullptr)
+        return nullptr;
+      elems.push_back(elem);
+    }
+    // 全零时得到 zeroinitializer，元素都是整数时得到 ConstantDataArray
+    return llvm::ConstantArray::get(arrTy, elems);
+  }
+
+  if (!type->isIntegerTy())
+    return nullptr;
+  auto val = constEval(obj);
+  if (!val)
+    return nullptr;
+  return llvm::ConstantInt::get(type, val->sextOrTrunc(type->getIntegerBitWidth()));
+}
+
+std::optional<llvm::APInt>
+EmitIR::constEval(Expr* obj)
+{
+  auto type = self(obj->type);
+  if (!type->isIntegerTy())
+    return std::nullopt;
+  auto bits = type->getIntegerBitWidth();
+
+  if (auto p = obj->dcst<IntegerLiteral>())
+    return llvm::APInt(bits, p->val);
+
+  if (auto p = obj->dcst<ParenExpr>())
+    return constEval(p->sub);
+
+  if (auto p = obj->dcst<ImplicitCastExpr>()) {
+    if (p->kind == ImplicitCastExpr::kLValueToRValue) {
+      auto val = llvm::dyn_cast_or_null<llvm::ConstantInt>(constLoad(p->sub));
+      if (val == nullptr)
+        return std::nullopt;
+      return val->getValue().sextOrTrunc(bits);
+    }
+    if (p->kind != ImplicitCastExpr::kIntegralCast &&
+        p->kind != ImplicitCastExpr::kNoOp)
+      return std::nullopt;
+    auto sub = constEval(p->sub);
+    if (!sub)
+      return std::nullopt;
+    return sub->sextOrTrunc(bits);
+  }
+
+  if (auto p = obj->dcst<UnaryExpr>()) {
+    auto sub = constEval(p->sub);
+    if (!sub)
+      return std::nullopt;
+    switch (p->op) {
+      case UnaryExpr::kPos:
+        return sub->sextOrTrunc(bits);
+      case UnaryExpr::kNeg:
+        return -sub->sextOrTrunc(bits);
+      case UnaryExpr::kNot:
+        return llvm::APInt(bits, sub->isZero());
+      default:
+        return std::nullopt;
+    }
+  }
+
+  if (auto p = obj->dcst<BinaryExpr>()) {
+    auto lft = constEval(p->lft);
+    auto rht = constEval(p->rht);
+    if (!lft || !rht)
+      return std::nullopt;
+
+    // 比较和逻辑运算的两个操作数位宽可能与结果不同
+    switch (p->op) {
+      case BinaryExpr::kAnd:
+        return llvm::APInt(bits, !lft->isZero() && !rht->isZero());
+      case BinaryExpr::kOr:
+        return llvm::APInt(bits, !lft->isZero() || !rht->isZero());
+      case BinaryExpr::kComma:
+        return rht->sextOrTrunc(bits);
+      default:
+        break;
+    }
+    if (lft->getBitWidth() != rht->getBitWidth())
+      return std::nullopt;
+    switch (p->op) {
+      case BinaryExpr::kEq:
+        return llvm::APInt(bits, lft->eq(*rht));
+      case BinaryExpr::kNe:
+        return llvm::APInt(bits, lft->ne(*rht));
+      case BinaryExpr::kLt:
+        return llvm::APInt(bits, lft->slt(*rht));
+      case BinaryExpr::kLe:
+        return llvm::APInt(bits, lft->sle(*rht));
+      case BinaryExpr::kGt:
+        return llvm::APInt(bits, lft->sgt(*rht));
+      case BinaryExpr::kGe:
+        return llvm::APInt(bits, lft->sge(*rht));
+      default:
+        break;
+    }
+
+    if (lft->getBitWidth() != bits)
+      return std::nullopt;
+    switch (p->op) {
+      case BinaryExpr::kAdd:
+        return *lft + *rht;
+      case BinaryExpr::kSub:
+        return *lft - *rht;
+      case BinaryExpr::kMul:
+        return *lft * *rht;
+      case BinaryExpr::kDiv:
+      case BinaryExpr::kMod: {
+        // 除零和溢出是未定义行为，留到运行时
+        bool overflow = false;
+        if (rht->isZero())
+          return std::nullopt;
+        auto quot = lft->sdiv_ov(*rht, overflow);
+        if (overflow)
+          return std::nullopt;
+        return p->op == BinaryExpr::kDiv ? quot : lft->srem(*rht);
+      }
+      default:
+        return std::nullopt;
+    }
+  }
+
+  return std::nullopt;
+}
+
+llvm::Constant*
+EmitIR::constLoad(Expr* obj)
+{
+  if (auto p = obj->dcst<ParenExpr>())
+    return constLoad(p->sub);
+
+  if (auto p = obj->dcst<DeclRefExpr>()) {
+    // 只有初始值在编译期已知的常量全局变量会被标记为 constant
+    auto var = p->decl->dcst<VarDecl>();
+    if (var == nullptr)
+      return nullptr;
+    auto it = mGlobalVars.find(var);
+    if (it == mGlobalVars.end() || !it->second->isConstant())
+      return nullptr;
+    return it->second->getInitializer();
+  }
+
+  if (auto p = obj->dcst<BinaryExpr>()) {
+    if (p->op != BinaryExpr::kIndex)
+      return nullptr;
+    // 数组元素：左操作数是数组退化得到的指针
+    auto decay = p->lft->dcst<ImplicitCastExpr>();
+    if (decay == nullptr ||
+        decay->kind != ImplicitCastExpr::kArrayToPointerDecay)
+      return nullptr;
+    auto arr = constLoad(decay->sub);
+    auto idx = constEval(p->rht);
+    if (arr == nullptr || !idx || idx->isNegative())
+      return nullptr;
+    return arr->getAggregateElement(idx->getZExtValue());
+  }
+
+  return nullptr;
+}
+
+namespace {
+
+/// 常量中非零的标量个数
+std::uint64_t
+count_nonzero(llvm::Constant* c)
+{
+  if (c->isNullValue())
+    return 0;
+  if (auto seq = llvm::dyn_cast<llvm::ConstantDataSequential>(c)) {
+    std::uint64_t n = 0;
+    for (unsigned i = 0; i < seq->getNumElements(); ++i)
+      n += !seq->getElementAsConstant(i)->isNullValue();
+    return n;
+  }
+  if (auto arr = llvm::dyn_cast<llvm::ConstantArray>(c)) {
+    std::uint64_t n = 0;
+    for (auto& op : arr->operands())
+      n += count_nonzero(llvm::cast<llvm::Constant>(op));
+    return n;
+  }
+  return 1;
+}
+
+/// 数组中的标量个数
+std::uint64_t
+count_scalars(llvm::Type* type)
+{
+  std::uint64_t n = 1;
+  while (auto arrTy = llvm::dyn_cast<llvm::ArrayType>(type)) {
+    n *= arrTy->getNumElements();
+    type = arrTy->getElementType();
+  }
+  return n;
+}
+
+} // namespace
+
+void
+EmitIR::arrayInit(llvm::ArrayType* type,
+                  llvm::Value* dst,
+                  Expr* init,
+                  bool zeroed)
+{
+  auto& irb = *mCurIrb;
+  auto size = mMod.getDataLayout().getTypeAllocSize(type);
+  auto align = mMod.getDataLayout().getPrefTypeAlign(type);
+
+  // 非零元素不少于四分之一时，memcpy 比 memset 加上逐个 store 更划算
+  if (auto c = constInit(type, init)) {
+    auto nonzero = count_nonzero(c);
+    if (nonzero > 8 && nonzero * 4 >= count_scalars(type)) {
+      auto src = new llvm::GlobalVariable(mMod,
+                                          type,
+                                          true,
+                                          llvm::GlobalValue::PrivateLinkage,
+                                          c,
+                                          dst->getName() + ".init");
+      src->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+      src->setAlignment(align);
+      irb.CreateMemCpy(dst, align, src, align, size);
+      return;
+    }
+  }
+
+  if (!zeroed)
+    irb.CreateMemSet(dst, irb.getInt8(0), size, align);
+  std::vector<llvm::Value*> idx{ irb.getInt64(0) };
+  sparseStore(type, dst, idx, type, init);
+}
+
+void
+EmitIR::sparseStore(llvm::ArrayType* rootTy,
+                    llvm::Value* dst,
+                    std::vector<llvm::Value*>& idx,
+                    llvm::Type* type,
+                    Expr* init)
+{
+  auto& irb = *mCurIrb;
+
+  if (init->dcst<ImplicitInitExpr>())
+    return;
+
+  if (auto p = init->dcst<InitListExpr>()) {
+    auto arrTy = llvm::dyn_cast<llvm::ArrayType>(type);
+    if (arrTy == nullptr) {
+      if (!p->list.empty())
+        sparseStore(rootTy, dst, idx, type, p->list[0]);
+      return;
+    }
+    for (std::uint64_t i = 0; i < p->list.size() && i < arrTy->getNumElements();
+         ++i) {
+      idx.push_back(irb.getInt64(i));
+      sparseStore(rootTy, dst, idx, arrTy->getElementType(), p->list[i]);
+      idx.pop_back();
+    }
+    return;
+  }
+
+  ASSERT(!type->isArrayTy());
+  llvm::Value* val = constInit(type, init);
+  if (val && llvm::cast<llvm::Constant>(val)->isNullValue())
+    return;
+  if (val == nullptr)
+    val = self(init);
+  irb.CreateStore(val, irb.CreateInBoundsGEP(rootTy, dst, idx));
+}
+
 void EmitIR::operator()(Decl* obj) {
   if (auto p = obj->dcst<FunctionDecl>())
     return self(p);
@@ -528,17 +931,27 @@ void EmitIR::operator()(Decl* obj) {
   ABORT();
 }
 
+llvm::AllocaInst*
+EmitIR::createAlloca(llvm::Type* type, const llvm::Twine& name)
+{
+  if (mAllocaIrb)
+    return mAllocaIrb->CreateAlloca(type, nullptr, name);
+  return mCurIrb->CreateAlloca(type, nullptr, name);
+}
+
 void EmitIR::operator()(VarDecl* obj) {
 
   // 通过判断变量声明是否在基本块中，来判断变量是全局变量还是局部变量
   if (mCurFunc) {
     auto type = self(obj->type);
-    auto alloca = mCurIrb->CreateAlloca(type, nullptr, obj->name);
+    auto alloca = createAlloca(type, obj->name);
     obj->any = alloca;
 
     if (obj->init == nullptr)
       return;
-    if (obj->init) 
+    if (auto arrTy = llvm::dyn_cast<llvm::ArrayType>(type))
+      arrayInit(arrTy, alloca, obj->init, false);
+    else if (obj->init) 
       transInit(alloca, obj->init,obj);
     else
       mCurIrb->CreateStore(llvm::Constant::getNullValue(type), alloca);
@@ -549,18 +962,24 @@ void EmitIR::operator()(VarDecl* obj) {
 
   auto preFunc = mCurFunc;
 
-  auto type = llvm::Type::getInt64Ty(mCtx);
+  auto type = self(obj->type);
 
   auto gvar = new llvm::GlobalVariable(
     mMod, type, false, llvm::GlobalValue::ExternalLinkage, nullptr, obj->name);
 
-  obj->any = gvar;
+  mGlobalVars[obj] = gvar;
 
-  gvar->setInitializer(llvm::ConstantInt::get(type, 0));
-
-  if (obj->init == nullptr)
+  // 能在编译期求值的初始值直接写进全局变量，程序启动时不需要再执行任何代码
+  auto init = obj->init ? constInit(type, obj->init)
+                        : llvm::Constant::getNullValue(type);
+  if (init) {
+    gvar->setInitializer(init);
+    gvar->setConstant(obj->type->qual.const_);
     return;
-  
+  }
+
+  gvar->setInitializer(llvm::Constant::getNullValue(type));
+
   // 生成构造函数
   // 生成构造函数的理由是：全局变量的初始化是在main函数之前的，而全局变量的初始化是在main函数之后的
   mCurFunc = llvm::Function::Create(
@@ -576,7 +995,10 @@ void EmitIR::operator()(VarDecl* obj) {
   // IRBuilder的参数是一个BasicBlock，表示在这个BasicBlock中生成IR
   mCurIrb = std::make_unique<llvm::IRBuilder<>>(entryBb);
   // transinit的作用是：将一个表达式的值赋给一个变量
-  transInit(gvar, obj->init,obj);
+  if (auto arrTy = llvm::dyn_cast<llvm::ArrayType>(type))
+    arrayInit(arrTy, gvar, obj->init, true);
+  else
+    transInit(gvar, obj->init,obj);
   mCurIrb->CreateRet(nullptr);
   mCurFunc = preFunc;
   return;
@@ -590,10 +1012,13 @@ EmitIR::operator()(FunctionDecl* obj)
   auto fty = llvm::dyn_cast<llvm::FunctionType>(self(obj->type));
   std::string testName = obj->name;
   // std::cout<<"test-----cout:"<<testName<<std::endl;
-  auto func = llvm::Function::Create(fty, llvm::GlobalVariable::ExternalLinkage, obj->name, mMod);
+  // 先声明后定义的函数沿用已有的声明
+  auto func = mMod.getFunction(obj->name);
+  if (func == nullptr)
+    func = llvm::Function::Create(
+      fty, llvm::GlobalVariable::ExternalLinkage, obj->name, mMod);
 
   // std::cout<<"test-----cout:"<<func<<std::endl;
-  obj->any = func;
 
   // if (fty) {
   //   fty->getReturnType()->print(llvm::errs());
@@ -603,12 +1028,30 @@ EmitIR::operator()(FunctionDecl* obj)
   //   }
   // }
 
-  if (obj->body == nullptr)
+  if (obj->body == nullptr || mDeclOnly.count(obj))
     return;
+  define(obj);
+}
+
+llvm::Function*
+EmitIR::define(FunctionDecl* obj)
+{
+  auto func = mMod.getFunction(obj->name);
+  ASSERT(func && func->isDeclaration());
+  auto fty = func->getFunctionType();
+
   auto entryBb = llvm::BasicBlock::Create(mCtx, "entry", func);
   mCurIrb = std::make_unique<llvm::IRBuilder<>>(entryBb);
   auto& entryIrb = *mCurIrb;
 
+  // alloca 都插到占位指令前面，其余代码都在它后面，入口块开头因而是连续的
+  // 一串 alloca。占位指令也在函数的符号表里，名字不能是合法的标识符
+  if (mEntryAllocas) {
+    mAllocaPt = new llvm::BitCastInst(
+      llvm::UndefValue::get(mIntTy), mIntTy, "alloca.pt", entryBb);
+    mAllocaIrb = std::make_unique<llvm::IRBuilder<>>(mAllocaPt);
+  }
+
   // TODO: 添加对函数参数的处理
 
   auto argIter = func->arg_begin();
@@ -616,21 +1059,63 @@ EmitIR::operator()(FunctionDecl* obj)
   // std::cout<<"test-----cout:"<<argIter<<std::endl;
   for (int i = 0; i < obj->params.size(); i++) {
     auto param = obj->params[i];
-    auto paramVar = mCurIrb->CreateAlloca(self(param->type), nullptr, param->name);
+    auto paramVar = createAlloca(self(param->type), param->name);
     argIter->setName(param->name);
     entryIrb.CreateStore(argIter,paramVar);
     argIter++;
   }
 
+  // 所有 return 都跳到同一个出口块，非 void 函数经返回槽传递返回值
+  auto retTy = fty->getReturnType();
+  mRetSlot = retTy->isVoidTy() ? nullptr : createAlloca(retTy, "return.slot");
+  mRetBb = llvm::BasicBlock::Create(mCtx, "return");
+
   // 翻译函数体
   mCurFunc = func;
   self(obj->body);
   auto& exitIrb = *mCurIrb;
 
-  if (fty->getReturnType()->isVoidTy())
-    exitIrb.CreateRetVoid();
-  else
-    exitIrb.CreateUnreachable();
+  if (exitIrb.GetInsertBlock()->getTerminator() == nullptr) {
+    if (retTy->isVoidTy())
+      exitIrb.CreateBr(mRetBb);
+    else
+      exitIrb.CreateUnreachable();
+  }
+
+  if (llvm::pred_empty(mRetBb))
+    delete mRetBb;
+  else if (auto pred = mRetBb->getSinglePredecessor();
+           pred && (mRetSlot == nullptr || mRetSlot->hasOneUse())) {
+    // 只有一处返回时不需要出口块和返回槽，直接在原处返回
+    pred->getTerminator()->eraseFromParent();
+    delete mRetBb;
+    llvm::IRBuilder<> retIrb(pred);
+    if (mRetSlot) {
+      auto store = llvm::cast<llvm::StoreInst>(mRetSlot->user_back());
+      retIrb.CreateRet(store->getValueOperand());
+      store->eraseFromParent();
+      mRetSlot->eraseFromParent();
+    } else
+      retIrb.CreateRetVoid();
+  } else {
+    mRetBb->insertInto(func);
+    llvm::IRBuilder<> retIrb(mRetBb);
+    if (mRetSlot)
+      retIrb.CreateRet(retIrb.CreateLoad(retTy, mRetSlot));
+    else
+      retIrb.CreateRetVoid();
+  }
+
+  if (mAllocaPt) {
+    mAllocaPt->eraseFromParent();
+    mAllocaPt = nullptr;
+    mAllocaIrb.reset();
+  }
+  // 常量条件等留下的无前驱的基本块
+  llvm::removeUnreachableBlocks(*func);
+  // 之后的顶层变量声明是全局变量
+  mCurFunc = nullptr;
+  return func;
 }
 
 
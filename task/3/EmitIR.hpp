@@ -1,7 +1,11 @@
 #include "asg.hpp"
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
 
 class EmitIR
 {
@@ -9,25 +13,60 @@ public:
   Obj::Mgr& mMgr;
   llvm::Module mMod;
 
+  /// 只生成声明、不翻译函数体的函数，增量编译时用来跳过命中缓存的函数
+  std::unordered_set<asg::FunctionDecl*> mDeclOnly;
+
+  /// 把局部变量的 alloca 统一放到函数的入口块，初始化仍留在声明处，这样
+  /// Mem2Reg 能把它们全部提升为寄存器；关闭时 alloca 生成在声明所在的块
+  bool mEntryAllocas{ true };
+
   EmitIR(Obj::Mgr& mgr, llvm::LLVMContext& ctx, llvm::StringRef mid = "-");
 
   llvm::Module& operator()(asg::TranslationUnit* tu);
 
+  /**
+   * 翻译 \p obj 的函数体，返回定义好的函数。函数原型必须已经在模块中，例如
+   * 翻译整个翻译单元时 \p obj 在 mDeclOnly 中。
+   */
+  llvm::Function* define(asg::FunctionDecl* obj);
+
 private:
   llvm::LLVMContext& mCtx;
 
+  /// 全局变量声明对应的 LLVM 全局变量。不记在 ASG 节点的 any 中，这样多个
+  /// EmitIR 可以同时翻译同一棵 ASG
+  std::unordered_map<asg::VarDecl*, llvm::GlobalVariable*> mGlobalVars;
+
   llvm::Type* mIntTy;
   llvm::FunctionType* mCtorTy;
 
   llvm::Function* mCurFunc;
   std::unique_ptr<llvm::IRBuilder<>> mCurIrb;
 
+  /// 入口块中 alloca 的插入点，是一条翻译完函数后删除的占位指令
+  llvm::Instruction* mAllocaPt{ nullptr };
+  std::unique_ptr<llvm::IRBuilder<>> mAllocaIrb;
+
+  /// 当前函数的返回槽（void 函数为空）和统一的出口块
+  llvm::AllocaInst* mRetSlot{ nullptr };
+  llvm::BasicBlock* mRetBb{ nullptr };
+
   //============================================================================
   // 类型
   //============================================================================
 
   llvm::Type* operator()(const asg::Type* type);
 
+  /**
+   * 类型翻译的缓存。LLVM 类型只由说明和类型表达式决定，与限定无关，所以以
+   * 这两者为键；指针、数组等逐层剥下的子类型也能直接用类型表达式的子节点
+   * 查找，不需要构造临时的 asg::Type。
+   */
+  llvm::DenseMap<std::pair<unsigned, const asg::TypeExpr*>, llvm::Type*>
+    mTypes;
+
+  llvm::Type* lowerType(asg::Type::Spec spec, asg::TypeExpr* texp);
+
   //============================================================================
   // 表达式
   //============================================================================
@@ -50,6 +89,24 @@ private:
 
   // TODO: 添加表达式处理相关声明
 
+  //============================================================================
+  // 条件
+  //============================================================================
+
+  /// 判断表达式的值是否只有 0 和 1 两种，即比较、逻辑与或非
+  bool isCond(asg::Expr* obj);
+
+  /**
+   * 把 \p obj 作为条件翻译为跳转，为真时到 \p trueBb，为假时到 \p falseBb。
+   * &&、||、! 直接展开成跳转，不求出中间的布尔值，右操作数只在需要时求值。
+   */
+  void condBr(asg::Expr* obj,
+              llvm::BasicBlock* trueBb,
+              llvm::BasicBlock* falseBb);
+
+  /// 求 \p obj 作为条件时的 i1 值，&& 和 || 在汇合处用 phi 合并
+  llvm::Value* condValue(asg::Expr* obj);
+
   //============================================================================
   // 语句
   //============================================================================
@@ -84,6 +141,39 @@ private:
 
   void varInit(llvm::Type*type , llvm::Value* var, asg::Expr* obj);
 
+  /**
+   * 尝试在编译期把初始值 \p obj 求值为 \p type 类型的常量，嵌套的初始化列表
+   * 求值为常量数组，缺省的元素补零。含有函数调用、变量读取等需要在运行时求
+   * 值的内容时返回空。
+   */
+  llvm::Constant* constInit(llvm::Type* type, asg::Expr* obj);
+
+  /// 在编译期对整数表达式求值，位宽与表达式的类型一致
+  std::optional<llvm::APInt> constEval(asg::Expr* obj);
+
+  /// 在编译期读取左值的值，目前只支持常量全局变量及其元素
+  llvm::Constant* constLoad(asg::Expr* obj);
+
+  /**
+   * 用 \p init 初始化数组 \p dst。初始值全是常量且非零元素足够稠密时，从一
+   * 个私有的常量全局变量 memcpy 过来；否则先用一次 memset 清零（\p zeroed
+   * 表示 \p dst 已经是零，例如全局变量），再只为非零的元素生成 store。
+   */
+  void arrayInit(llvm::ArrayType* type,
+                 llvm::Value* dst,
+                 asg::Expr* init,
+                 bool zeroed);
+
+  /// 按初始化列表的顺序为非零的元素生成 store，\p idx 是当前元素的下标
+  void sparseStore(llvm::ArrayType* rootTy,
+                   llvm::Value* dst,
+                   std::vector<llvm::Value*>& idx,
+                   llvm::Type* type,
+                   asg::Expr* init);
+
+  /// 为局部变量或形参分配栈空间，位置由 mEntryAllocas 决定
+  llvm::AllocaInst* createAlloca(llvm::Type* type, const llvm::Twine& name);
+
   void operator()(asg::VarDecl* obj);
 
   void operator()(asg::Decl* obj);
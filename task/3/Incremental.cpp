@@ -0,0 +1,195 @@
+#include "Incremental.hpp"
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+namespace {
+
+/// 在 \p mod 中为 \p gv 生成同名的外部声明
+llvm::GlobalValue*
+declare(llvm::Module& mod, const llvm::GlobalValue& gv)
+{
+  if (auto func = llvm::dyn_cast<llvm::Function>(&gv)) {
+    auto decl = llvm::Function::Create(func->getFunctionType(),
+                                       llvm::GlobalValue::ExternalLinkage,
+                                       func->getName(),
+                                       mod);
+    decl->copyAttributesFrom(func);
+    return decl;
+  }
+
+  auto var = llvm::cast<llvm::GlobalVariable>(&gv);
+  auto decl = new llvm::GlobalVariable(mod,
+                                       var->getValueType(),
+                                       var->isConstant(),
+                                       llvm::GlobalValue::ExternalLinkage,
+                                       nullptr,
+                                       var->getName());
+  decl->copyAttributesFrom(var);
+  return decl;
+}
+
+} // namespace
+
+std::unique_ptr<llvm::Module>
+Incremental::extract(const llvm::Function& func)
+{
+  if (func.isDeclaration() || func.hasLocalLinkage())
+    return nullptr;
+
+  auto& src = *func.getParent();
+  auto mod = std::make_unique<llvm::Module>(func.getName(), func.getContext());
+  mod->setDataLayout(src.getDataLayout());
+  mod->setTargetTriple(src.getTargetTriple());
+
+  // 找出函数体引用的全局对象，包括藏在常量表达式里的
+  llvm::ValueToValueMapTy vmap;
+  llvm::SmallVector<const llvm::Constant*, 16> work;
+  llvm::SmallPtrSet<const llvm::Constant*, 16> seen;
+  for (auto& bb : func)
+    for (auto& inst : bb)
+      for (auto& op : inst.operands())
+        if (auto c = llvm::dyn_cast<llvm::Constant>(op))
+          if (seen.insert(c).second)
+            work.push_back(c);
+
+  while (!work.empty()) {
+    auto c = work.pop_back_val();
+    if (auto gv = llvm::dyn_cast<llvm::GlobalValue>(c)) {
+      if (gv == &func)
+        continue;
+      if (gv->hasLocalLinkage() ||
+          !llvm::isa<llvm::Function, llvm::GlobalVariable>(gv))
+        return nullptr;
+      vmap[gv] = declare(*mod, *gv);
+      continue;
+    }
+    for (auto& op : c->operands())
+      if (auto sub = llvm::dyn_cast<llvm::Constant>(op))
+        if (seen.insert(sub).second)
+          work.push_back(sub);
+  }
+
+  auto clone = llvm::Function::Create(func.getFunctionType(),
+                                      func.getLinkage(),
+                                      func.getAddressSpace(),
+                                      func.getName(),
+                                      mod.get());
+  clone->copyAttributesFrom(&func);
+  vmap[&func] = clone;
+  auto arg = clone->arg_begin();
+  for (auto& i : func.args()) {
+    arg->setName(i.getName());
+    vmap[&i] = &*arg++;
+  }
+
+  llvm::SmallVector<llvm::ReturnInst*, 4> returns;
+  llvm::CloneFunctionInto(clone,
+                          &func,
+                          vmap,
+                          llvm::CloneFunctionChangeType::DifferentModule,
+                          returns);
+
+  // 跨模块克隆时总会建立 llvm.dbg.cu，为空时删掉，否则读回时会报告调试信息
+  // 的版本无效
+  if (auto cu = mod->getNamedMetadata("llvm.dbg.cu"))
+    if (cu->getNumOperands() == 0)
+      mod->eraseNamedMetadata(cu);
+  return mod;
+}
+
+bool
+Incremental::fingerprint(const llvm::Function& func, std::string& out)
+{
+  auto mod = extract(func);
+  if (!mod)
+    return false;
+
+  llvm::raw_string_ostream os(out);
+  llvm::WriteBitcodeToFile(*mod, os);
+  for (auto& decl : mod->globals()) {
+    auto var = func.getParent()->getNamedGlobal(decl.getName());
+    if (var && var->hasInitializer()) {
+      os << '\n' << var->getName() << " = ";
+      var->getInitializer()->print(os);
+    }
+  }
+  return true;
+}
+
+bool
+Incremental::lookup(llvm::StringRef key)
+{
+  auto hit = mCache.lookup(key);
+  if (!hit)
+    return false;
+  mHits.push_back(std::move(hit));
+  ++mReused;
+  return true;
+}
+
+void
+Incremental::store(const llvm::Function& func, llvm::StringRef key)
+{
+  ++mRebuilt;
+  auto mod = extract(func);
+  if (!mod)
+    return;
+
+  std::string data;
+  llvm::raw_string_ostream os(data);
+  llvm::WriteBitcodeToFile(*mod, os);
+  // 调用者最后还会写入整个文件的结果，容量留到那时再检查
+  mCache.store(key, os.str(), /*prune=*/false);
+}
+
+bool
+Incremental::link(llvm::Module& mod)
+{
+  bool ok = link(mod, mHits);
+  mHits.clear();
+  return ok;
+}
+
+bool
+Incremental::link(llvm::Module& mod,
+                  llvm::ArrayRef<std::unique_ptr<llvm::MemoryBuffer>> frags)
+{
+  std::vector<std::string> varOrder, funcOrder;
+  for (auto& var : mod.globals())
+    varOrder.push_back(var.getName().str());
+  for (auto& func : mod)
+    funcOrder.push_back(func.getName().str());
+
+  llvm::Linker linker(mod);
+  for (auto& buf : frags) {
+    auto frag = llvm::parseBitcodeFile(buf->getMemBufferRef(), mod.getContext());
+    if (!frag) {
+      llvm::consumeError(frag.takeError());
+      return false;
+    }
+    if (linker.linkInModule(std::move(*frag)))
+      return false;
+  }
+
+  // 链接器会把一些全局对象重新创建在模块末尾，这里恢复原来的顺序
+  for (auto& name : varOrder)
+    if (auto var = mod.getNamedGlobal(name)) {
+      mod.removeGlobalVariable(var);
+      mod.insertGlobalVariable(var);
+    }
+  auto& funcs = mod.getFunctionList();
+  for (auto& name : funcOrder)
+    if (auto func = mod.getFunction(name))
+      funcs.splice(funcs.end(), funcs, func->getIterator());
+  return true;
+}
+
+void
+Incremental::print_stats(llvm::raw_ostream& os)
+{
+  os << "增量编译复用 " << mReused << " 个函数，重新编译 " << mRebuilt
+     << " 个函数\n";
+}
@@ -2,12 +2,217 @@
 
 using namespace asg;
 
+namespace {
+
+/// 结点种类。JSON 里的 "kind" 字段先经 kind_of 映射为枚举值，之后统一用
+/// switch 分派，而不是逐个比较字符串。
+enum struct Kind : std::uint8_t
+{
+  kUnknown,
+
+  // 表达式
+  kIntegerLiteral,
+  kBinaryOperator,
+  kUnaryOperator,
+  kDeclRefExpr,
+  kImplicitCastExpr,
+  kParenExpr,
+  kInitListExpr,
+  kImplicitValueInitExpr,
+  kArraySubscriptExpr,
+  kCallExpr,
+
+  // 语句
+  kDeclStmt,
+  kReturnStmt,
+  kIfStmt,
+  kWhileStmt,
+  kNullStmt,
+  kCompoundStmt,
+  kContinueStmt,
+  kBreakStmt,
+
+  // 声明
+  kVarDecl,
+  kFunctionDecl,
+  kParmVarDecl,
+  kTypedefDecl,
+  kTranslationUnitDecl,
+};
+
+/**
+ * @brief 将结点种类字符串映射为 Kind。
+ *
+ * 先按字符串长度分桶，同一长度的再按首个不同的字符区分，这样每个字符串最多
+ * 只需要做一次完整比较来确认，相当于一张手工构造的完美哈希表。
+ */
+Kind
+kind_of(llvm::StringRef s)
+{
+#define KIND_CASE(name)                                                        \
+  return s == #name ? Kind::k##name : Kind::kUnknown
+
+  switch (s.size()) {
+    case 6:
+      KIND_CASE(IfStmt);
+    case 7:
+      KIND_CASE(VarDecl);
+    case 8:
+      switch (s[0]) {
+        case 'C':
+          KIND_CASE(CallExpr);
+        case 'D':
+          KIND_CASE(DeclStmt);
+        case 'N':
+          KIND_CASE(NullStmt);
+      }
+      break;
+    case 9:
+      switch (s[0]) {
+        case 'B':
+          KIND_CASE(BreakStmt);
+        case 'P':
+          KIND_CASE(ParenExpr);
+        case 'W':
+          KIND_CASE(WhileStmt);
+      }
+      break;
+    case 10:
+      KIND_CASE(ReturnStmt);
+    case 11:
+      switch (s[0]) {
+        case 'D':
+          KIND_CASE(DeclRefExpr);
+        case 'P':
+          KIND_CASE(ParmVarDecl);
+        case 'T':
+          KIND_CASE(TypedefDecl);
+      }
+      break;
+    case 12:
+      switch (s[0]) {
+        case 'C':
+          if (s[3] == 'p')
+            KIND_CASE(CompoundStmt);
+          KIND_CASE(ContinueStmt);
+        case 'F':
+          KIND_CASE(FunctionDecl);
+        case 'I':
+          KIND_CASE(InitListExpr);
+      }
+      break;
+    case 13:
+      KIND_CASE(UnaryOperator);
+    case 14:
+      switch (s[0]) {
+        case 'B':
+          KIND_CASE(BinaryOperator);
+        case 'I':
+          KIND_CASE(IntegerLiteral);
+      }
+      break;
+    case 16:
+      KIND_CASE(ImplicitCastExpr);
+    case 18:
+      KIND_CASE(ArraySubscriptExpr);
+    case 19:
+      KIND_CASE(TranslationUnitDecl);
+    case 21:
+      KIND_CASE(ImplicitValueInitExpr);
+  }
+  return Kind::kUnknown;
+
+#undef KIND_CASE
+}
+
+Kind
+jobj_kind(const llvm::json::Object& jobj)
+{
+  auto kind = jobj.getString("kind");
+  ASSERT(kind);
+  return kind_of(*kind);
+}
+
+/// 二元运算符的操作码，同样按长度和字符直接分派。
+BinaryExpr::Op
+binary_op_of(llvm::StringRef s)
+{
+  if (s.size() == 1) {
+    switch (s[0]) {
+      case '*':
+        return BinaryExpr::kMul;
+      case '/':
+        return BinaryExpr::kDiv;
+      case '%':
+        return BinaryExpr::kMod;
+      case '+':
+        return BinaryExpr::kAdd;
+      case '-':
+        return BinaryExpr::kSub;
+      case '>':
+        return BinaryExpr::kGt;
+      case '<':
+        return BinaryExpr::kLt;
+      case '=':
+        return BinaryExpr::kAssign;
+      case ',':
+        return BinaryExpr::kComma;
+    }
+  }
+
+  else if (s.size() == 2) {
+    switch (s[0]) {
+      case '>':
+        if (s[1] == '=')
+          return BinaryExpr::kGe;
+        break;
+      case '<':
+        if (s[1] == '=')
+          return BinaryExpr::kLe;
+        break;
+      case '=':
+        if (s[1] == '=')
+          return BinaryExpr::kEq;
+        break;
+      case '!':
+        if (s[1] == '=')
+          return BinaryExpr::kNe;
+        break;
+      case '&':
+        if (s[1] == '&')
+          return BinaryExpr::kAnd;
+        break;
+      case '|':
+        if (s[1] == '|')
+          return BinaryExpr::kOr;
+        break;
+    }
+  }
+
+  return BinaryExpr::kINVALID;
+}
+
+std::size_t
+jobj_id(const llvm::json::Object& jobj)
+{
+  auto id = jobj.getString("id");
+  ASSERT(id);
+  ASSERT(id->starts_with("0x"));
+  // 直接在原字符串上解析，不构造临时的 std::string
+  std::size_t ret;
+  bool fail = id->drop_front(2).getAsInteger(16, ret);
+  ASSERT(!fail);
+  return ret;
+}
+
+} // namespace
+
 TranslationUnit*
 Json2Asg::operator()(const llvm::json::Value& jval)
 {
   auto jobj = jval.getAsObject();
   ASSERT(jobj);
-  ASSERT(jobj->getString("kind") == "TranslationUnitDecl");
+  ASSERT(jobj_kind(*jobj) == Kind::kTranslationUnitDecl);
 
   auto inner = jobj->getArray("inner");
   ASSERT(inner);
@@ -23,20 +228,6 @@ Json2Asg::operator()(const llvm::json::Value& jval)
   return ret;
 }
 
-namespace {
-
-std::size_t
-jobj_id(const llvm::json::Object& jobj)
-{
-  auto id = jobj.getString("id");
-  ASSERT(id);
-  ASSERT(id->starts_with("0x"));
-  auto hexStr = id->substr(2).str();
-  return std::stoull(hexStr, nullptr, 16);
-}
-
-} // namespace
-
 //==============================================================================
 // 类型
 //==============================================================================
@@ -48,16 +239,18 @@ Json2Asg::getty(const llvm::json::Object& jobj)
   ASSERT(a);
   auto b = a->getString("qualType");
   ASSERT(b);
-  auto texpStr = b->str();
 
-  auto iter = mTyMap.find(texpStr);
+  // 绝大多数类型字符串都已经见过，查找时直接以 StringRef 为键，只有第一次
+  // 遇到时才需要复制一份以 '\0' 结尾的字符串交给解析器。
+  auto iter = mTyMap.find(*b);
   if (iter != mTyMap.end())
     return iter->second;
 
+  auto texpStr = b->str();
   const Type* ty;
   auto s = parse_type(texpStr.c_str(), ty);
   ASSERT(s && *s == '\0');
-  mTyMap.emplace(texpStr, ty);
+  mTyMap.try_emplace(*b, ty);
   return ty;
 }
 
@@ -68,43 +261,49 @@ Json2Asg::getty(const llvm::json::Object& jobj)
 Expr*
 Json2Asg::expr(const llvm::json::Object& jobj)
 {
-  auto kind = jobj.getString("kind");
-  ASSERT(kind);
-
   Expr* ret;
 
-  if (kind == "IntegerLiteral")
-    ret = integer_literal(jobj);
-
-  else if (kind == "BinaryOperator")
-    ret = binary_expr(jobj);
+  switch (jobj_kind(jobj)) {
+    case Kind::kIntegerLiteral:
+      ret = integer_literal(jobj);
+      break;
 
-  else if (kind == "UnaryOperator")
-    ret = unary_expr(jobj);
+    case Kind::kBinaryOperator:
+    case Kind::kArraySubscriptExpr:
+      ret = binary_expr(jobj);
+      break;
 
-  else if (kind == "DeclRefExpr")
-    ret = decl_ref_expr(jobj);
+    case Kind::kUnaryOperator:
+      ret = unary_expr(jobj);
+      break;
 
-  else if (kind == "ImplicitCastExpr")
-    ret = implicit_cast_expr(jobj);
+    case Kind::kDeclRefExpr:
+      ret = decl_ref_expr(jobj);
+      break;
 
-  else if (kind == "ParenExpr")
-    ret = paren_expr(jobj);
+    case Kind::kImplicitCastExpr:
+      ret = implicit_cast_expr(jobj);
+      break;
 
-  else if (kind == "InitListExpr")
-    ret = init_list_expr(jobj);
+    case Kind::kParenExpr:
+      ret = paren_expr(jobj);
+      break;
 
-  else if (kind == "ImplicitValueInitExpr")
-    ret = implicit_init_expr(jobj);
+    case Kind::kInitListExpr:
+      ret = init_list_expr(jobj);
+      break;
 
-  else if (kind == "ArraySubscriptExpr")
-    ret = binary_expr(jobj);
+    case Kind::kImplicitValueInitExpr:
+      ret = implicit_init_expr(jobj);
+      break;
 
-  else if (kind == "CallExpr")
-    ret = call_expr(jobj);
+    case Kind::kCallExpr:
+      ret = call_expr(jobj);
+      break;
 
-  else
-    ABORT();
+    default:
+      ABORT();
+  }
 
   auto cateVal = jobj.get("valueCategory");
   ASSERT(cateVal);
@@ -130,7 +329,8 @@ Json2Asg::integer_literal(const llvm::json::Object& jobj)
   auto value = jobj.getString("value");
   ASSERT(value);
 
-  integerLiteral->val = std::stoull(value->str());
+  bool fail = value->getAsInteger(10, integerLiteral->val);
+  ASSERT(!fail);
 
   return integerLiteral;
 }
@@ -196,49 +396,18 @@ Json2Asg::unary_expr(const llvm::json::Object& jobj)
 BinaryExpr*
 Json2Asg::binary_expr(const llvm::json::Object& jobj)
 {
-  auto kind = jobj.getString("kind");
-  ASSERT(kind);
-
   auto binaryExpr = make<BinaryExpr>();
   binaryExpr->type = getty(jobj);
 
-  if (kind == "ArraySubscriptExpr")
+  if (jobj_kind(jobj) == Kind::kArraySubscriptExpr)
     binaryExpr->op = BinaryExpr::Op::kIndex;
   else {
     auto opCode = jobj.getString("opcode");
     ASSERT(opCode);
 
-    if (opCode == "*")
-      binaryExpr->op = BinaryExpr::Op::kMul;
-    else if (opCode == "/")
-      binaryExpr->op = BinaryExpr::Op::kDiv;
-    else if (opCode == "%")
-      binaryExpr->op = BinaryExpr::Op::kMod;
-    else if (opCode == "+")
-      binaryExpr->op = BinaryExpr::Op::kAdd;
-    else if (opCode == "-")
-      binaryExpr->op = BinaryExpr::Op::kSub;
-    else if (opCode == ">")
-      binaryExpr->op = BinaryExpr::Op::kGt;
-    else if (opCode == "<")
-      binaryExpr->op = BinaryExpr::Op::kLt;
-    else if (opCode == ">=")
-      binaryExpr->op = BinaryExpr::Op::kGe;
-    else if (opCode == "<=")
-      binaryExpr->op = BinaryExpr::Op::kLe;
-    else if (opCode == "==")
-      binaryExpr->op = BinaryExpr::Op::kEq;
-    else if (opCode == "!=")
-      binaryExpr->op = BinaryExpr::Op::kNe;
-    else if (opCode == "&&")
-      binaryExpr->op = BinaryExpr::Op::kAnd;
-    else if (opCode == "||")
-      binaryExpr->op = BinaryExpr::Op::kOr;
-    else if (opCode == "=")
-      binaryExpr->op = BinaryExpr::Op::kAssign;
-    else {
+    binaryExpr->op = binary_op_of(*opCode);
+    if (binaryExpr->op == BinaryExpr::Op::kINVALID)
       ABORT();
-    }
   }
 
   auto inner = jobj.getArray("inner");
@@ -333,22 +502,20 @@ Json2Asg::implicit_cast_expr(const llvm::json::Object& jobj)
 Decl*
 Json2Asg::decl(const llvm::json::Object& jobj)
 {
-  auto kind = jobj.getString("kind");
-  ASSERT(kind);
-
-  if (kind == "VarDecl")
-    return var_decl(jobj);
-
-  if (kind == "FunctionDecl")
-    return function_decl(jobj);
+  switch (jobj_kind(jobj)) {
+    case Kind::kVarDecl:
+    case Kind::kParmVarDecl:
+      return var_decl(jobj);
 
-  if (kind == "ParmVarDecl")
-    return var_decl(jobj);
+    case Kind::kFunctionDecl:
+      return function_decl(jobj);
 
-  if (kind == "TypedefDecl")
-    return nullptr;
+    case Kind::kTypedefDecl:
+      return nullptr;
 
-  ABORT();
+    default:
+      ABORT();
+  }
 }
 
 VarDecl*
@@ -395,20 +562,19 @@ Json2Asg::function_decl(const llvm::json::Object& jobj)
     auto object = value.getAsObject();
     ASSERT(object);
 
-    auto kind = object->getString("kind");
-    ASSERT(kind);
+    switch (jobj_kind(*object)) {
+      case Kind::kParmVarDecl:
+        funcDecl->params.push_back(decl(*object));
+        break;
 
-    if (kind == "ParmVarDecl") {
-      funcDecl->params.push_back(decl(*object));
-      continue;
-    }
+      case Kind::kCompoundStmt:
+        ASSERT(funcDecl->body == nullptr);
+        funcDecl->body = compound_stmt(*object);
+        break;
 
-    if (kind == "CompoundStmt") {
-      ASSERT(funcDecl->body == nullptr);
-      funcDecl->body = compound_stmt(*object);
-      continue;
+      default:
+        ABORT();
     }
-    ABORT();
   }
 
   return funcDecl;
@@ -421,43 +587,39 @@ Json2Asg::function_decl(const llvm::json::Object& jobj)
 Stmt*
 Json2Asg::stmt(const llvm::json::Object& jobj)
 {
-  auto kind = jobj.getString("kind");
-  ASSERT(kind);
-
-  if (kind == "DeclStmt")
-    return decl_stmt(jobj);
-
-  if (kind == "ReturnStmt")
-    return return_stmt(jobj);
+  switch (jobj_kind(jobj)) {
+    case Kind::kDeclStmt:
+      return decl_stmt(jobj);
 
-  if (kind == "BinaryOperator")
-    return expr_stmt(jobj);
+    case Kind::kReturnStmt:
+      return return_stmt(jobj);
 
-  if (kind == "UnaryOperator")
-    return expr_stmt(jobj);
+    case Kind::kBinaryOperator:
+    case Kind::kUnaryOperator:
+    case Kind::kCallExpr:
+      return expr_stmt(jobj);
 
-  if (kind == "CallExpr")
-    return expr_stmt(jobj);
+    case Kind::kIfStmt:
+      return if_stmt(jobj);
 
-  if (kind == "IfStmt")
-    return if_stmt(jobj);
+    case Kind::kWhileStmt:
+      return while_stmt(jobj);
 
-  if (kind == "WhileStmt")
-    return while_stmt(jobj);
+    case Kind::kNullStmt:
+      return null_stmt(jobj);
 
-  if (kind == "NullStmt")
-    return null_stmt(jobj);
+    case Kind::kCompoundStmt:
+      return compound_stmt(jobj);
 
-  if (kind == "CompoundStmt")
-    return compound_stmt(jobj);
+    case Kind::kContinueStmt:
+      return continue_stmt(jobj);
 
-  if (kind == "ContinueStmt")
-    return continue_stmt(jobj);
+    case Kind::kBreakStmt:
+      return break_stmt(jobj);
 
-  if (kind == "BreakStmt")
-    return break_stmt(jobj);
-
-  ABORT();
+    default:
+      ABORT();
+  }
 }
 
 CompoundStmt*
@@ -2,6 +2,7 @@
 
 #include "asg.hpp"
 #include <any>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/Support/JSON.h>
 #include <regex>
 #include <unordered_map>
@@ -20,7 +21,9 @@ public:
 
 private:
   std::unordered_map<std::size_t, Obj*> mIdMap;
-  std::unordered_map<std::string, const asg::Type*> mTyMap;
+  /// 以类型字符串为键的类型表，StringMap 可以直接用 StringRef 查找，不必先
+  /// 构造 std::string。
+  llvm::StringMap<const asg::Type*> mTyMap;
 
   /**
    * 在遍历函数体时指向当前的函数声明，从而给函数体内返回语句的 ReturnStmt
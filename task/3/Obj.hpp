@@ -1,4 +1,7 @@
-#pragma once
+// task/2/common 与 task/3 中各有一份相同的 Obj.hpp，编译驱动会同时包含两者，
+// 所以用同名的宏而不是 #pragma once 防止重复定义。
+#ifndef SYSU_OBJ_HPP
+#define SYSU_OBJ_HPP
 
 #include <cassert>
 #include <cstdio>
@@ -155,3 +158,5 @@ struct Obj::Walked
     reinterpret_cast<uintptr_t&>(mObj->__next__) &= ~uintptr_t(0b10);
   }
 };
+
+#endif // SYSU_OBJ_HPP
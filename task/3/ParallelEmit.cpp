@@ -0,0 +1,72 @@
+#include "ParallelEmit.hpp"
+#include "EmitIR.hpp"
+#include "Incremental.hpp"
+#include <algorithm>
+#include <atomic>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <thread>
+
+std::unordered_set<asg::FunctionDecl*>
+ParallelEmit::operator()(asg::TranslationUnit* tu,
+                         const std::unordered_set<asg::FunctionDecl*>& skip)
+{
+  std::unordered_set<asg::FunctionDecl*> bodies;
+  std::vector<asg::FunctionDecl*> funcs;
+  for (auto&& i : tu->decls) {
+    auto func = i->dcst<asg::FunctionDecl>();
+    if (func == nullptr || func->body == nullptr)
+      continue;
+    bodies.insert(func);
+    if (!skip.count(func))
+      funcs.push_back(func);
+  }
+  if (funcs.empty())
+    return {};
+
+  // 片段按函数在翻译单元中的下标存放，链接顺序与线程的调度无关
+  std::vector<std::string> frags(funcs.size());
+  std::atomic<std::size_t> next{ 0 };
+
+  auto worker = [&]() {
+    llvm::LLVMContext ctx;
+    EmitIR emitIR(mMgr, ctx);
+    emitIR.mEntryAllocas = mEntryAllocas;
+    emitIR.mDeclOnly = bodies;
+    emitIR(tu);
+
+    for (std::size_t i; (i = next++) < funcs.size();) {
+      auto func = emitIR.define(funcs[i]);
+      if (auto mod = Incremental::extract(*func)) {
+        llvm::raw_string_ostream os(frags[i]);
+        llvm::WriteBitcodeToFile(*mod, os);
+      }
+      // 片段已经独立，这里只留下声明，后面的函数仍然可以引用它
+      func->deleteBody();
+    }
+  };
+
+  unsigned nThreads =
+    std::max(1u, std::min<unsigned>(mJobs, funcs.size()));
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < nThreads; ++i)
+    threads.emplace_back(worker);
+  for (auto& i : threads)
+    i.join();
+
+  std::unordered_set<asg::FunctionDecl*> done;
+  for (std::size_t i = 0; i < funcs.size(); ++i) {
+    if (frags[i].empty())
+      continue;
+    mFrags.push_back(llvm::MemoryBuffer::getMemBufferCopy(frags[i]));
+    done.insert(funcs[i]);
+  }
+  return done;
+}
+
+bool
+ParallelEmit::link(llvm::Module& mod)
+{
+  bool ok = Incremental::link(mod, mFrags);
+  mFrags.clear();
+  return ok;
+}
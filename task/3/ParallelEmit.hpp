@@ -0,0 +1,49 @@
+#pragma once
+
+#include "asg.hpp"
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <unordered_set>
+
+/**
+ * @brief 多线程翻译函数体
+ *
+ * 每个工作线程独占一个 LLVMContext 和一个 EmitIR：先翻译整个翻译单元，但所
+ * 有函数都只生成声明，再从共享的计数器领取函数逐个翻译函数体，翻译完后像增
+ * 量编译一样提取出只含这个函数的片段（见 Incremental::extract），写成位码交
+ * 回主线程。主线程随后照常翻译整个翻译单元，已经得到片段的函数只生成声明，
+ * 最后用 llvm::Linker 把片段按原来的顺序链接回来，结果与单线程翻译相同。
+ *
+ * 函数体的翻译只读 ASG，ASG 节点上的 any 只由翻译这个函数的线程写入。不能单
+ * 独成为片段的函数（例如用私有的常量全局变量初始化局部数组的函数）留给主线
+ * 程翻译。
+ */
+class ParallelEmit
+{
+public:
+  Obj::Mgr& mMgr;
+  unsigned mJobs;
+
+  /// 与主线程的 EmitIR::mEntryAllocas 一致
+  bool mEntryAllocas{ true };
+
+  ParallelEmit(Obj::Mgr& mgr, unsigned jobs)
+    : mMgr(mgr)
+    , mJobs(jobs)
+  {
+  }
+
+  /**
+   * 在多个线程上翻译 \p tu 中不在 \p skip 里的函数体，返回已经得到片段的函
+   * 数，主线程的 EmitIR 应当把它们加入 mDeclOnly。
+   */
+  std::unordered_set<asg::FunctionDecl*> operator()(
+    asg::TranslationUnit* tu,
+    const std::unordered_set<asg::FunctionDecl*>& skip);
+
+  /// 把片段链接回 \p mod，失败时返回 false。
+  bool link(llvm::Module& mod);
+
+private:
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> mFrags;
+};
@@ -0,0 +1,284 @@
+#include "Tier.hpp"
+#include "EmitIR.hpp"
+#include <chrono>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+namespace {
+
+/// 本机代码调用运行时库函数的入口，程序要求退出时直接结束进程
+std::int64_t
+call_native(Vm* vm, std::int32_t id, std::int64_t* args)
+{
+  bool halt = false;
+  auto ret = vm->native(id, args, halt);
+  if (halt)
+    vm->exit(int(ret));
+  return ret;
+}
+
+/// 把值扩展为解释器寄存器中的 64 位形式：整数符号扩展，指针取地址
+llvm::Value*
+to_reg(llvm::IRBuilder<>& irb, llvm::Value* val)
+{
+  auto i64 = irb.getInt64Ty();
+  if (val->getType()->isPointerTy())
+    return irb.CreatePtrToInt(val, i64);
+  return irb.CreateSExtOrTrunc(val, i64);
+}
+
+/// to_reg 的逆操作
+llvm::Value*
+from_reg(llvm::IRBuilder<>& irb, llvm::Value* val, llvm::Type* type)
+{
+  if (type->isPointerTy())
+    return irb.CreateIntToPtr(val, type);
+  return irb.CreateTrunc(val, type);
+}
+
+/// 指向宿主进程中 \p ptr 的常量指针
+llvm::Constant*
+host_ptr(llvm::LLVMContext& ctx, const void* ptr)
+{
+  return llvm::ConstantExpr::getIntToPtr(
+    llvm::ConstantInt::get(llvm::Type::getInt64Ty(ctx),
+                           reinterpret_cast<std::uintptr_t>(ptr)),
+    llvm::PointerType::getUnqual(ctx));
+}
+
+/// 调用 \p callee，实参从 \p args 指向的 64 位数组中读取
+llvm::Value*
+call_with_regs(llvm::IRBuilder<>& irb,
+               llvm::FunctionCallee callee,
+               llvm::Value* args)
+{
+  auto fty = callee.getFunctionType();
+  std::vector<llvm::Value*> params;
+  for (unsigned i = 0; i < fty->getNumParams(); ++i) {
+    auto reg = irb.CreateLoad(irb.getInt64Ty(),
+                              irb.CreateConstGEP1_32(irb.getInt64Ty(), args, i));
+    params.push_back(from_reg(irb, reg, fty->getParamType(i)));
+  }
+  auto ret = irb.CreateCall(callee, params);
+  if (fty->getReturnType()->isVoidTy())
+    return irb.getInt64(0);
+  return to_reg(irb, ret);
+}
+
+} // namespace
+
+Tier::Tier(Vm& vm, Obj::Mgr& mgr, asg::TranslationUnit* tu)
+  : mVm(vm)
+  , mMgr(mgr)
+  , mTu(tu)
+{
+  mVm.mProfile = true;
+  mVm.mOnHot = [this](std::int32_t func) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueue.push_back(func);
+    mCv.notify_one();
+  };
+}
+
+Tier::~Tier()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStop = true;
+    mCv.notify_one();
+  }
+  if (mThread.joinable())
+    mThread.join();
+  mVm.mOnHot = nullptr;
+}
+
+llvm::Error
+Tier::start()
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  auto jit = llvm::orc::LLJITBuilder().create();
+  if (!jit)
+    return jit.takeError();
+  mJit = std::move(*jit);
+
+  // memset、memcpy 等由 LLVM 生成的调用到进程中找
+  auto proc = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+    mJit->getDataLayout().getGlobalPrefix());
+  if (!proc)
+    return proc.takeError();
+  mJit->getMainJITDylib().addGenerator(std::move(*proc));
+
+  mDone.assign(mVm.funcs().size(), false);
+  mThread = std::thread([this] { worker(); });
+  return llvm::Error::success();
+}
+
+void
+Tier::worker()
+{
+  for (;;) {
+    std::int32_t func;
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mCv.wait(lock, [this] { return mStop || !mQueue.empty(); });
+      if (mStop)
+        return;
+      func = mQueue.front();
+      mQueue.pop_front();
+    }
+
+    // 编译失败的函数继续解释执行
+    if (auto err = compile(func)) {
+      if (mLog)
+        *mLog << "tier: " << mVm.funcs()[func].name << ": "
+              << llvm::toString(std::move(err)) << '\n';
+      else
+        llvm::consumeError(std::move(err));
+    }
+  }
+}
+
+llvm::Error
+Tier::compile(std::int32_t func)
+{
+  using Clock = std::chrono::steady_clock;
+  auto start = Clock::now();
+  auto& funcs = mVm.funcs();
+
+  // main 只调用一次，编译了也用不上
+  if (mDone[func] || funcs[func].name == "main")
+    return llvm::Error::success();
+
+  // 本机代码不回到解释器，调用到的还没有编译过的函数一起编译
+  std::vector<std::int32_t> group, stack{ func };
+  while (!stack.empty()) {
+    auto i = stack.back();
+    stack.pop_back();
+    if (mDone[i])
+      continue;
+    mDone[i] = true;
+    group.push_back(i);
+    for (auto j : funcs[i].callees)
+      stack.push_back(j);
+  }
+
+  // 其余的函数只生成声明，已经编译过的在 JIT 中按名字找到
+  auto ctx = std::make_unique<llvm::LLVMContext>();
+  std::unique_ptr<llvm::Module> mod;
+  {
+    EmitIR emitIR(mMgr, *ctx);
+    for (auto&& i : funcs) {
+      if (i.decl)
+        emitIR.mDeclOnly.insert(i.decl);
+    }
+    for (auto i : group)
+      emitIR.mDeclOnly.erase(funcs[i].decl);
+    mod = llvm::CloneModule(emitIR(mTu));
+  }
+
+  // 全局变量的初始化已经由解释器完成
+  if (auto ctors = mod->getGlobalVariable("llvm.global_ctors")) {
+    std::vector<llvm::Function*> dead;
+    if (auto arr = llvm::dyn_cast<llvm::ConstantArray>(ctors->getInitializer())) {
+      for (auto&& i : arr->operands()) {
+        auto entry = llvm::cast<llvm::ConstantStruct>(i);
+        if (auto fn = llvm::dyn_cast<llvm::Function>(
+              entry->getOperand(1)->stripPointerCasts()))
+          dead.push_back(fn);
+      }
+    }
+    ctors->eraseFromParent();
+    for (auto fn : dead)
+      fn->eraseFromParent();
+  }
+
+  // 非常量的全局变量换成解释器全局内存中的地址，常量保留私有的副本
+  for (auto&& i : mTu->decls) {
+    auto var = i->dcst<asg::VarDecl>();
+    if (var == nullptr)
+      continue;
+    auto gvar = mod->getGlobalVariable(var->name);
+    if (gvar == nullptr)
+      continue;
+    if (gvar->isConstant()) {
+      gvar->setLinkage(llvm::GlobalValue::PrivateLinkage);
+      continue;
+    }
+    gvar->replaceAllUsesWith(host_ptr(*ctx, mVm.globalAddr(var)));
+    gvar->eraseFromParent();
+  }
+
+  // 运行时库函数定义为调用 Vm::native 的桩
+  auto i64 = llvm::Type::getInt64Ty(*ctx);
+  auto ptr = llvm::PointerType::getUnqual(*ctx);
+  auto nativeTy = llvm::FunctionType::get(
+    i64, { ptr, llvm::Type::getInt32Ty(*ctx), ptr }, false);
+  llvm::FunctionCallee native(nativeTy,
+                              host_ptr(*ctx, reinterpret_cast<void*>(call_native)));
+  for (auto&& i : funcs) {
+    if (i.native < 0)
+      continue;
+    auto fn = mod->getFunction(i.name);
+    if (fn == nullptr || !fn->isDeclaration())
+      continue;
+    llvm::IRBuilder<> irb(llvm::BasicBlock::Create(*ctx, "entry", fn));
+    auto args = irb.CreateAlloca(
+      i64, irb.getInt32(std::max<unsigned>(1, fn->arg_size())));
+    for (auto&& arg : fn->args())
+      irb.CreateStore(to_reg(irb, &arg),
+                      irb.CreateConstGEP1_32(i64, args, arg.getArgNo()));
+    auto ret = irb.CreateCall(
+      native, { host_ptr(*ctx, &mVm), irb.getInt32(i.native), args });
+    if (fn->getReturnType()->isVoidTy())
+      irb.CreateRetVoid();
+    else
+      irb.CreateRet(from_reg(irb, ret, fn->getReturnType()));
+    fn->setLinkage(llvm::GlobalValue::InternalLinkage);
+  }
+
+  // 解释器通过包装函数进入本机代码，实参就在调用者的寄存器窗口中
+  for (auto i : group) {
+    auto fn = mod->getFunction(funcs[i].name);
+    auto wrapper = llvm::Function::Create(
+      llvm::FunctionType::get(i64, { ptr }, false),
+      llvm::GlobalValue::ExternalLinkage,
+      funcs[i].name + ".vm",
+      *mod);
+    llvm::IRBuilder<> irb(llvm::BasicBlock::Create(*ctx, "entry", wrapper));
+    irb.CreateRet(call_with_regs(irb, fn, wrapper->getArg(0)));
+  }
+
+  if (llvm::verifyModule(*mod, mLog))
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "invalid module");
+
+  mod->setDataLayout(mJit->getDataLayout());
+  mOpt(*mod);
+
+  llvm::orc::ThreadSafeModule tsm(std::move(mod),
+                                  llvm::orc::ThreadSafeContext(std::move(ctx)));
+  if (auto err = mJit->addIRModule(std::move(tsm)))
+    return err;
+
+  for (auto i : group) {
+    auto sym = mJit->lookup(funcs[i].name + ".vm");
+    if (!sym)
+      return sym.takeError();
+    mVm.publish(i, sym->toPtr<Vm::Compiled>());
+  }
+
+  if (mLog) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - start)
+                .count();
+    *mLog << "tier: compiled";
+    for (auto i : group)
+      *mLog << ' ' << funcs[i].name;
+    *mLog << " in " << us << "us\n";
+  }
+  return llvm::Error::success();
+}
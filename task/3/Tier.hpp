@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Vm.hpp"
+#include "opt.hpp"
+#include <condition_variable>
+#include <deque>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <thread>
+
+/**
+ * @brief 分层执行
+ *
+ * 程序先在字节码解释器中运行，解释器对每个函数的调用与回边计数。函数变热后
+ * 交给后台线程：用 EmitIR 翻译它和它调用到的、还没有编译过的所有函数，经过
+ * 实验四的优化流水线（Optimizer）后用 ORC 的 LLJIT 编译为本机代码，再交回解
+ * 释器，之后对这些函数的调用都直接进入本机代码。
+ *
+ * 本机代码与解释器共用全局内存：非常量的全局变量在模块中替换为解释器全局内
+ * 存中的地址，常量全局变量保留私有的副本。运行时库函数在模块中定义为调用
+ * Vm::native 的桩，计时器和输入输出都与解释执行时一致。本机代码只会调用本机
+ * 代码，不会回到解释器。
+ *
+ * 没有栈上替换：已经在解释器中运行的调用会一直解释执行下去，所以只在 main
+ * 里循环的程序得不到加速，main 本身也从不编译。
+ */
+class Tier
+{
+public:
+  /// 编译时打印日志的输出流，为空时不打印
+  llvm::raw_ostream* mLog{ nullptr };
+
+  /// 把 \p vm 接入分层执行，应当在 \p vm 翻译 \p tu 之前构造
+  Tier(Vm& vm, Obj::Mgr& mgr, asg::TranslationUnit* tu);
+
+  /// 停止后台线程，等待正在进行的编译结束
+  ~Tier();
+
+  /// 创建 JIT，启动后台线程，应当在 \p vm 翻译之后、运行之前调用
+  llvm::Error start();
+
+private:
+  Vm& mVm;
+  Obj::Mgr& mMgr;
+  asg::TranslationUnit* mTu;
+  std::unique_ptr<llvm::orc::LLJIT> mJit;
+  Optimizer mOpt{ llvm::nulls() };
+
+  std::thread mThread;
+  std::mutex mMutex;
+  std::condition_variable mCv;
+  std::deque<std::int32_t> mQueue;
+  bool mStop{ false };
+
+  /// 已经编译或正在编译的函数，只由后台线程访问
+  std::vector<bool> mDone;
+
+  void worker();
+
+  /// 编译 \p func 及其调用到的还没有编译过的函数，把结果交给解释器
+  llvm::Error compile(std::int32_t func);
+};
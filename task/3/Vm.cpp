@@ -0,0 +1,1889 @@
+#include "Vm.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <llvm/Support/Format.h>
+#include <memory>
+#include <unistd.h>
+
+#define self (*this)
+
+using namespace asg;
+
+// GCC 与 Clang 支持标签的地址，用直接跳转到下一条指令处理代码的线索化分派，
+// 其他编译器退回到 switch
+#if defined(__GNUC__)
+#define VM_THREADED 1
+#endif
+
+namespace {
+
+/// 运行时库函数，名字与 test/rtlib 中的定义一致
+#define VM_NATIVES(X)                                                          \
+  X(kGetInt, "_sysy_getint")                                                   \
+  X(kGetCh, "_sysy_getch")                                                     \
+  X(kGetArray, "_sysy_getarray")                                               \
+  X(kPutInt, "_sysy_putint")                                                   \
+  X(kPutCh, "_sysy_putch")                                                     \
+  X(kPutArray, "_sysy_putarray")                                               \
+  X(kStartTime, "_sysy_starttime")                                             \
+  X(kStopTime, "_sysy_stoptime")                                               \
+  X(kGetChar, "sysu_getchar")                                                  \
+  X(kPutChar, "sysu_putchar")                                                  \
+  X(kPuts, "sysu_puts")                                                        \
+  X(kStrlen, "sysu_strlen")                                                    \
+  X(kStrcmp, "sysu_strcmp")                                                    \
+  X(kAtoi, "sysu_atoi")                                                        \
+  X(kExit, "sysu_exit")                                                        \
+  X(kOpen, "sysu_open")                                                        \
+  X(kFcntl, "sysu_fcntl")                                                      \
+  X(kClose, "sysu_close")                                                      \
+  X(kRead, "sysu_read")                                                        \
+  X(kWrite, "sysu_write")                                                      \
+  X(kLseek64, "sysu_lseek64")                                                  \
+  X(kFork, "sysu_fork")                                                        \
+  X(kGetPid, "sysu_getpid")                                                    \
+  X(kGetPPid, "sysu_getppid")
+
+enum Native : std::int32_t
+{
+#define X(id, name) id,
+  VM_NATIVES(X)
+#undef X
+};
+
+constexpr const char* kNativeNames[] = {
+#define X(id, name) name,
+  VM_NATIVES(X)
+#undef X
+};
+
+constexpr const char* kOpNames[] = {
+#define X(name) #name,
+  VM_OPS(X)
+#undef X
+};
+
+/// 比较运算在比较并跳转指令中的顺序：==、!=、<、<=、>、>=
+int
+cmp_index(BinaryExpr::Op op)
+{
+  switch (op) {
+    case BinaryExpr::kEq:
+      return 0;
+    case BinaryExpr::kNe:
+      return 1;
+    case BinaryExpr::kLt:
+      return 2;
+    case BinaryExpr::kLe:
+      return 3;
+    case BinaryExpr::kGt:
+      return 4;
+    case BinaryExpr::kGe:
+      return 5;
+    default:
+      return -1;
+  }
+}
+
+/// 条件取反、交换两个操作数后的比较
+constexpr int kCmpInvert[] = { 1, 0, 5, 4, 3, 2 };
+constexpr int kCmpSwap[] = { 0, 1, 4, 5, 2, 3 };
+
+bool
+fits(std::int64_t val)
+{
+  return val == std::int32_t(val);
+}
+
+/// 32 位运算的结果：截断后符号扩展，寄存器中的 int 总是符号扩展过的
+std::int64_t
+s32(std::uint64_t val)
+{
+  return std::int32_t(std::uint32_t(val));
+}
+
+template<typename T>
+std::int64_t
+load_mem(std::int64_t addr)
+{
+  T val;
+  std::memcpy(&val, reinterpret_cast<void*>(addr), sizeof(T));
+  return val;
+}
+
+template<typename T>
+void
+store_mem(std::int64_t addr, std::int64_t val)
+{
+  T tmp = T(val);
+  std::memcpy(reinterpret_cast<void*>(addr), &tmp, sizeof(T));
+}
+
+unsigned
+size_of(Type::Spec spec, TypeExpr* texp)
+{
+  if (texp == nullptr) {
+    switch (spec) {
+      case Type::Spec::kChar:
+        return 1;
+      case Type::Spec::kInt:
+        return 4;
+      case Type::Spec::kLong:
+      case Type::Spec::kLongLong:
+        return 8;
+      default:
+        ABORT();
+    }
+  }
+
+  if (texp->dcst<PointerType>())
+    return 8;
+
+  if (auto p = texp->dcst<ArrayType>()) {
+    // 长度未知的数组只会是形参，实际上是指针
+    if (p->len == ArrayType::kUnLen)
+      return 8;
+    return p->len * size_of(spec, p->sub);
+  }
+
+  ABORT();
+}
+
+unsigned
+size_of(const Type* type)
+{
+  return size_of(type->spec, type->texp);
+}
+
+/// 能放进寄存器的类型：整数、指针和作为形参的数组
+bool
+is_scalar(TypeExpr* texp)
+{
+  if (texp == nullptr || texp->dcst<PointerType>())
+    return true;
+  auto p = texp->dcst<ArrayType>();
+  return p && p->len == ArrayType::kUnLen;
+}
+
+/// 把编译期的值按 \p type 截断
+std::int64_t
+fold(std::int64_t val, const Type* type)
+{
+  switch (size_of(type)) {
+    case 1:
+      return std::int8_t(val);
+    case 4:
+      return std::int32_t(val);
+    default:
+      return val;
+  }
+}
+
+Expr*
+strip_parens(Expr* obj)
+{
+  while (auto p = obj->dcst<ParenExpr>())
+    obj = p->sub;
+  return obj;
+}
+
+/// 判断两个左值表达式是否一定指向同一个对象，只接受没有副作用的形式
+bool
+same_lvalue(Expr* a, Expr* b)
+{
+  a = strip_parens(a);
+  b = strip_parens(b);
+
+  if (auto p = a->dcst<DeclRefExpr>()) {
+    auto q = b->dcst<DeclRefExpr>();
+    return q && p->decl == q->decl;
+  }
+
+  if (auto p = a->dcst<IntegerLiteral>()) {
+    auto q = b->dcst<IntegerLiteral>();
+    return q && p->val == q->val;
+  }
+
+  if (auto p = a->dcst<ImplicitCastExpr>()) {
+    auto q = b->dcst<ImplicitCastExpr>();
+    return q && p->kind == q->kind && same_lvalue(p->sub, q->sub);
+  }
+
+  if (auto p = a->dcst<BinaryExpr>()) {
+    auto q = b->dcst<BinaryExpr>();
+    return q && p->op == BinaryExpr::kIndex && q->op == BinaryExpr::kIndex &&
+           same_lvalue(p->lft, q->lft) && same_lvalue(p->rht, q->rht);
+  }
+
+  return false;
+}
+
+} // namespace
+
+//==============================================================================
+// 翻译
+//==============================================================================
+
+bool
+Vm::operator()(TranslationUnit* tu)
+{
+  // 先登记所有函数和全局变量，函数体中可以引用在后面定义的函数
+  for (auto&& i : tu->decls) {
+    if (auto p = i->dcst<FunctionDecl>()) {
+      if (mFuncIdx.count(p->name))
+        continue;
+      mFuncIdx.emplace(p->name, std::int32_t(mFuncs.size()));
+      Func func;
+      func.name = p->name;
+      for (std::size_t j = 0; j < std::size(kNativeNames); ++j) {
+        if (p->name == kNativeNames[j])
+          func.native = std::int32_t(j);
+      }
+      mFuncs.push_back(std::move(func));
+    }
+
+    else if (auto p = i->dcst<VarDecl>())
+      mGlobalOff.emplace(p, allocGlobal(size_of(p->type)));
+  }
+
+  mInit = std::int32_t(mFuncs.size());
+  mFuncs.emplace_back().name = ".init";
+
+  for (auto&& i : tu->decls) {
+    if (auto p = i->dcst<FunctionDecl>(); p && p->body)
+      function(p);
+  }
+
+  // 初始化函数：写入全局变量的初始值，然后调用 main 并以其返回值结束
+  auto main = mFuncIdx.find("main");
+  if (main == mFuncIdx.end() || mFuncs[main->second].entry < 0) {
+    std::cout << "Error: undefined function: main\n";
+    return false;
+  }
+
+  beginFunc(0);
+  mCur = mInit;
+  mFuncs[mInit].entry = std::int32_t(mCode.size());
+  for (auto&& i : tu->decls) {
+    auto p = i->dcst<VarDecl>();
+    if (p == nullptr || p->init == nullptr)
+      continue;
+    LVal base{ LVal::kGlob };
+    base.off = mGlobalOff[p];
+    initStore(base, p->type->spec, p->type->texp, p->init);
+  }
+  mTop = mNumVars;
+  auto ret = temp();
+  emit(kCall, ret, ret, main->second);
+  emit(kHalt, ret);
+  endFunc(mFuncs[mInit]);
+
+  for (auto&& func : mFuncs) {
+    if (func.used && func.entry < 0 && func.native < 0) {
+      std::cout << "Error: undefined function: " << func.name << '\n';
+      return false;
+    }
+  }
+  return true;
+}
+
+std::int32_t
+Vm::emit(Op op, std::int32_t a, std::int32_t b, std::int32_t c, std::int32_t d)
+{
+  mCode.push_back({ op, a, b, c, d });
+  return std::int32_t(mCode.size() - 1);
+}
+
+std::int32_t
+Vm::newLabel()
+{
+  mLabels.push_back(-1);
+  return std::int32_t(mLabels.size() - 1);
+}
+
+void
+Vm::bind(std::int32_t label)
+{
+  mLabels[label] = std::int32_t(mCode.size());
+}
+
+void
+Vm::jump(Op op, std::int32_t a, std::int32_t b, std::int32_t label)
+{
+  mFixups.emplace_back(emit(op, a, b), label);
+}
+
+std::int32_t
+Vm::temp()
+{
+  auto ret = mTop++;
+  mMaxRegs = std::max(mMaxRegs, mTop);
+  return ret;
+}
+
+std::int32_t
+Vm::newVar()
+{
+  // 变量在语句开头分配，这时临时寄存器都已回收，变量总在它们之下
+  auto ret = temp();
+  mNumVars = mTop;
+  return ret;
+}
+
+void
+Vm::li(std::int32_t dst, std::int64_t val)
+{
+  if (fits(val))
+    emit(kLi, dst, std::int32_t(val));
+  else
+    emit(kLi64, dst, std::int32_t(val), std::int32_t(val >> 32));
+}
+
+void
+Vm::beginFunc(std::int32_t nparams)
+{
+  mLocals.clear();
+  mLoops.clear();
+  mFixups.clear();
+  mNumVars = mTop = mMaxRegs = nparams;
+  mFmem = 0;
+}
+
+void
+Vm::endFunc(Func& func)
+{
+  for (auto&& [insn, label] : mFixups) {
+    ASSERT(mLabels[label] >= 0);
+    mCode[insn].d = mLabels[label];
+  }
+  func.nregs = mMaxRegs;
+  func.fmem = mFmem;
+}
+
+std::int32_t
+Vm::allocGlobal(std::uint32_t size)
+{
+  auto off = (mGlobals.size() + 7) & ~std::size_t(7);
+  ASSERT(fits(off + size));
+  mGlobals.resize(off + size);
+  return std::int32_t(off);
+}
+
+void
+Vm::writeGlobal(std::int32_t off, unsigned size, std::int64_t val)
+{
+  // 宿主机是小端序，低位字节在前
+  std::memcpy(mGlobals.data() + off, &val, size);
+}
+
+std::optional<std::int64_t>
+Vm::constOf(Expr* obj)
+{
+  if (auto p = obj->dcst<IntegerLiteral>())
+    return fold(p->val, obj->type);
+
+  if (auto p = obj->dcst<ParenExpr>())
+    return constOf(p->sub);
+
+  if (auto p = obj->dcst<ImplicitCastExpr>()) {
+    switch (p->kind) {
+      case ImplicitCastExpr::kLValueToRValue: {
+        // 读取有常量初始值的 const 标量
+        auto ref = strip_parens(p->sub)->dcst<DeclRefExpr>();
+        if (ref == nullptr)
+          return std::nullopt;
+        auto var = ref->decl->dcst<VarDecl>();
+        if (var == nullptr || !var->type->qual.const_ ||
+            var->type->texp != nullptr || var->init == nullptr)
+          return std::nullopt;
+        auto init = var->init;
+        if (auto list = init->dcst<InitListExpr>()) {
+          if (list->list.empty())
+            return 0;
+          init = list->list[0];
+        }
+        if (auto v = constOf(init))
+          return fold(*v, obj->type);
+        return std::nullopt;
+      }
+      case ImplicitCastExpr::kIntegralCast:
+      case ImplicitCastExpr::kNoOp:
+        if (auto v = constOf(p->sub))
+          return fold(*v, obj->type);
+        return std::nullopt;
+      default:
+        return std::nullopt;
+    }
+  }
+
+  if (auto p = obj->dcst<UnaryExpr>()) {
+    auto v = constOf(p->sub);
+    if (!v)
+      return std::nullopt;
+    switch (p->op) {
+      case UnaryExpr::kPos:
+        return v;
+      case UnaryExpr::kNeg:
+        return fold(-std::uint64_t(*v), obj->type);
+      case UnaryExpr::kNot:
+        return *v == 0;
+      default:
+        ABORT();
+    }
+  }
+
+  if (auto p = obj->dcst<BinaryExpr>()) {
+    if (p->op == BinaryExpr::kAssign || p->op == BinaryExpr::kComma ||
+        p->op == BinaryExpr::kIndex)
+      return std::nullopt;
+    auto l = constOf(p->lft);
+    if (!l)
+      return std::nullopt;
+    auto r = constOf(p->rht);
+    if (!r)
+      return std::nullopt;
+    auto ul = std::uint64_t(*l), ur = std::uint64_t(*r);
+    switch (p->op) {
+      case BinaryExpr::kAdd:
+        return fold(ul + ur, obj->type);
+      case BinaryExpr::kSub:
+        return fold(ul - ur, obj->type);
+      case BinaryExpr::kMul:
+        return fold(ul * ur, obj->type);
+      case BinaryExpr::kDiv:
+      case BinaryExpr::kMod:
+        // 除以零和溢出留到运行时，与本机程序的行为一致
+        if (*r == 0 ||
+            (*r == -1 &&
+             *l == fold(std::int64_t(std::uint64_t(1)
+                                     << (size_of(obj->type) * 8 - 1)),
+                        obj->type)))
+          return std::nullopt;
+        return fold(p->op == BinaryExpr::kDiv ? *l / *r : *l % *r, obj->type);
+      case BinaryExpr::kGt:
+        return *l > *r;
+      case BinaryExpr::kLt:
+        return *l < *r;
+      case BinaryExpr::kGe:
+        return *l >= *r;
+      case BinaryExpr::kLe:
+        return *l <= *r;
+      case BinaryExpr::kEq:
+        return *l == *r;
+      case BinaryExpr::kNe:
+        return *l != *r;
+      case BinaryExpr::kAnd:
+        return *l && *r;
+      case BinaryExpr::kOr:
+        return *l || *r;
+      default:
+        ABORT();
+    }
+  }
+
+  return std::nullopt;
+}
+
+Vm::LVal
+Vm::lval(Expr* obj)
+{
+  if (auto p = obj->dcst<ParenExpr>())
+    return lval(p->sub);
+
+  if (auto p = obj->dcst<DeclRefExpr>()) {
+    if (auto it = mLocals.find(p->decl); it != mLocals.end())
+      return it->second;
+    auto it = mGlobalOff.find(p->decl);
+    ASSERT(it != mGlobalOff.end());
+    LVal ret{ LVal::kGlob };
+    ret.off = it->second;
+    return ret;
+  }
+
+  if (auto p = obj->dcst<StringLiteral>()) {
+    LVal ret{ LVal::kGlob };
+    ret.off = allocGlobal(p->val.size() + 1);
+    std::memcpy(mGlobals.data() + ret.off, p->val.data(), p->val.size());
+    return ret;
+  }
+
+  if (auto p = obj->dcst<ImplicitCastExpr>()) {
+    ASSERT(p->kind == ImplicitCastExpr::kNoOp);
+    return lval(p->sub);
+  }
+
+  auto p = obj->dcst<BinaryExpr>();
+  ASSERT(p && p->op == BinaryExpr::kIndex);
+  std::int32_t scale = size_of(obj->type);
+
+  // 先求基址：数组直接用它的位置，常量偏移折叠进 off
+  LVal base{ LVal::kMem };
+  auto decay = strip_parens(p->lft)->dcst<ImplicitCastExpr>();
+  if (decay && decay->kind == ImplicitCastExpr::kArrayToPointerDecay) {
+    auto arr = lval(decay->sub);
+    switch (arr.kind) {
+      case LVal::kGlob:
+      case LVal::kMem:
+        base = arr;
+        break;
+      default:
+        base.reg = addrOf(arr);
+    }
+  } else
+    base.reg = rval(p->lft);
+
+  if (auto c = constOf(p->rht)) {
+    auto off = base.off + *c * scale;
+    if (fits(off)) {
+      base.off = std::int32_t(off);
+      return base;
+    }
+  }
+
+  auto idx = rval(p->rht);
+  LVal ret{ LVal::kIdx };
+  if (base.kind == LVal::kGlob) {
+    ret.kind = LVal::kGIdx;
+    ret.off = base.off;
+  } else
+    ret.reg = addrOf(base);
+  ret.idx = idx;
+  ret.scale = scale;
+  return ret;
+}
+
+std::int32_t
+Vm::addrOf(const LVal& lv, std::int32_t dst)
+{
+  auto out = [&] { return dst >= 0 ? dst : temp(); };
+
+  switch (lv.kind) {
+    case LVal::kMem:
+      if (lv.off != 0) {
+        auto ret = out();
+        emit(kAddI64, ret, lv.reg, lv.off);
+        return ret;
+      }
+      [[fallthrough]];
+    case LVal::kReg: {
+      // 数组形参的寄存器中就是地址
+      if (dst < 0)
+        return lv.reg;
+      if (dst != lv.reg)
+        emit(kMov, dst, lv.reg);
+      return dst;
+    }
+    case LVal::kGlob: {
+      auto ret = out();
+      emit(kGaddr, ret, lv.off);
+      return ret;
+    }
+    case LVal::kIdx: {
+      auto ret = out();
+      emit(kIdx, ret, lv.reg, lv.idx, lv.scale);
+      return ret;
+    }
+    case LVal::kGIdx: {
+      auto ret = out();
+      emit(kGIdx, ret, lv.off, lv.idx, lv.scale);
+      return ret;
+    }
+  }
+  ABORT();
+}
+
+std::int32_t
+Vm::load(const LVal& lv, unsigned size, std::int32_t dst)
+{
+  if (lv.kind == LVal::kReg) {
+    if (dst < 0)
+      return lv.reg;
+    if (dst != lv.reg)
+      emit(kMov, dst, lv.reg);
+    return dst;
+  }
+
+  auto ret = dst >= 0 ? dst : temp();
+  bool wide = size == 8;
+  if (size != 1) {
+    switch (lv.kind) {
+      case LVal::kGlob:
+        emit(wide ? kLdG64 : kLdG32, ret, lv.off);
+        return ret;
+      case LVal::kMem:
+        emit(wide ? kLd64 : kLd32, ret, lv.reg, lv.off);
+        return ret;
+      case LVal::kIdx:
+        if (lv.scale != std::int32_t(size))
+          break;
+        emit(wide ? kLdX64 : kLdX32, ret, lv.reg, lv.idx);
+        return ret;
+      case LVal::kGIdx:
+        if (lv.scale != std::int32_t(size))
+          break;
+        emit(wide ? kLdGX64 : kLdGX32, ret, lv.off, lv.idx);
+        return ret;
+      default:
+        break;
+    }
+  }
+
+  if (lv.kind == LVal::kMem) {
+    emit(kLd8, ret, lv.reg, lv.off);
+    return ret;
+  }
+  auto addr = addrOf(lv);
+  emit(size == 1 ? kLd8 : wide ? kLd64 : kLd32, ret, addr, 0);
+  return ret;
+}
+
+void
+Vm::store(const LVal& lv, unsigned size, std::int32_t src)
+{
+  if (lv.kind == LVal::kReg) {
+    if (src != lv.reg)
+      emit(kMov, lv.reg, src);
+    return;
+  }
+
+  bool wide = size == 8;
+  if (size != 1) {
+    switch (lv.kind) {
+      case LVal::kGlob:
+        emit(wide ? kStG64 : kStG32, src, lv.off);
+        return;
+      case LVal::kMem:
+        emit(wide ? kSt64 : kSt32, src, lv.reg, lv.off);
+        return;
+      case LVal::kIdx:
+        if (lv.scale != std::int32_t(size))
+          break;
+        emit(wide ? kStX64 : kStX32, src, lv.reg, lv.idx);
+        return;
+      case LVal::kGIdx:
+        if (lv.scale != std::int32_t(size))
+          break;
+        emit(wide ? kStGX64 : kStGX32, src, lv.off, lv.idx);
+        return;
+      default:
+        break;
+    }
+  }
+
+  if (lv.kind == LVal::kMem) {
+    emit(kSt8, src, lv.reg, lv.off);
+    return;
+  }
+  auto addr = addrOf(lv);
+  emit(size == 1 ? kSt8 : wide ? kSt64 : kSt32, src, addr, 0);
+}
+
+std::int32_t
+Vm::rval(Expr* obj, std::int32_t dst)
+{
+  auto out = [&] { return dst >= 0 ? dst : temp(); };
+
+  if (auto c = constOf(obj)) {
+    auto ret = out();
+    li(ret, *c);
+    return ret;
+  }
+
+  if (auto p = obj->dcst<ParenExpr>())
+    return rval(p->sub, dst);
+
+  if (auto p = obj->dcst<ImplicitCastExpr>()) {
+    switch (p->kind) {
+      case ImplicitCastExpr::kLValueToRValue:
+        return load(lval(p->sub), size_of(obj->type), dst);
+
+      case ImplicitCastExpr::kIntegralCast: {
+        // 寄存器中的值总是符号扩展过的，扩展不需要指令
+        auto to = size_of(obj->type);
+        if (to >= size_of(p->sub->type))
+          return rval(p->sub, dst);
+        auto sub = rval(p->sub);
+        auto ret = out();
+        emit(to == 1 ? kTrunc8 : kTrunc32, ret, sub);
+        return ret;
+      }
+
+      case ImplicitCastExpr::kArrayToPointerDecay:
+        return addrOf(lval(p->sub), dst);
+
+      case ImplicitCastExpr::kNoOp:
+        return rval(p->sub, dst);
+
+      default:
+        ABORT();
+    }
+  }
+
+  if (auto p = obj->dcst<UnaryExpr>()) {
+    switch (p->op) {
+      case UnaryExpr::kPos:
+        return rval(p->sub, dst);
+      case UnaryExpr::kNeg: {
+        auto sub = rval(p->sub);
+        auto ret = out();
+        emit(size_of(obj->type) == 8 ? kNeg64 : kNeg, ret, sub);
+        return ret;
+      }
+      case UnaryExpr::kNot: {
+        auto sub = rval(p->sub);
+        auto ret = out();
+        emit(kNot, ret, sub);
+        return ret;
+      }
+      default:
+        ABORT();
+    }
+  }
+
+  if (auto p = obj->dcst<BinaryExpr>()) {
+    switch (p->op) {
+      case BinaryExpr::kAssign:
+        return assign(p, dst, true);
+      case BinaryExpr::kComma:
+        effect(p->lft);
+        return rval(p->rht, dst);
+      case BinaryExpr::kAnd:
+      case BinaryExpr::kOr:
+        return condValue(p, dst);
+      default:
+        if (cmp_index(p->op) >= 0)
+          return condValue(p, dst);
+        return arith(p, dst);
+    }
+  }
+
+  if (auto p = obj->dcst<CallExpr>())
+    return call(p, dst);
+
+  ABORT();
+}
+
+void
+Vm::effect(Expr* obj)
+{
+  obj = strip_parens(obj);
+
+  if (auto p = obj->dcst<BinaryExpr>()) {
+    if (p->op == BinaryExpr::kAssign) {
+      assign(p, -1, false);
+      return;
+    }
+    if (p->op == BinaryExpr::kComma) {
+      effect(p->lft);
+      effect(p->rht);
+      return;
+    }
+  }
+
+  if (auto p = obj->dcst<CallExpr>()) {
+    call(p, -1);
+    return;
+  }
+
+  rval(obj);
+}
+
+std::int32_t
+Vm::arith(BinaryExpr* obj, std::int32_t dst)
+{
+  bool wide = size_of(obj->type) == 8;
+  auto lft = obj->lft, rht = obj->rht;
+
+  // 一个操作数是常量时用带立即数的指令，加法和乘法可以交换
+  auto c = constOf(rht);
+  if (!c && (obj->op == BinaryExpr::kAdd || obj->op == BinaryExpr::kMul)) {
+    if ((c = constOf(lft)))
+      std::swap(lft, rht);
+  }
+
+  if (c) {
+    std::optional<Op> op;
+    auto imm = *c;
+    switch (obj->op) {
+      case BinaryExpr::kSub:
+        imm = -imm;
+        [[fallthrough]];
+      case BinaryExpr::kAdd:
+        op = wide ? kAddI64 : kAddI;
+        break;
+      case BinaryExpr::kMul:
+        op = wide ? kMulI64 : kMulI;
+        break;
+      case BinaryExpr::kDiv:
+        if (!wide)
+          op = kDivI;
+        break;
+      case BinaryExpr::kMod:
+        if (!wide)
+          op = kRemI;
+        break;
+      default:
+        ABORT();
+    }
+    if (op && fits(imm)) {
+      auto l = rval(lft);
+      auto ret = dst >= 0 ? dst : temp();
+      emit(*op, ret, l, std::int32_t(imm));
+      return ret;
+    }
+  }
+
+  Op op;
+  switch (obj->op) {
+    case BinaryExpr::kAdd:
+      op = wide ? kAdd64 : kAdd;
+      break;
+    case BinaryExpr::kSub:
+      op = wide ? kSub64 : kSub;
+      break;
+    case BinaryExpr::kMul:
+      op = wide ? kMul64 : kMul;
+      break;
+    case BinaryExpr::kDiv:
+      op = wide ? kDiv64 : kDiv;
+      break;
+    case BinaryExpr::kMod:
+      op = wide ? kRem64 : kRem;
+      break;
+    default:
+      ABORT();
+  }
+  auto l = rval(lft);
+  auto r = rval(rht);
+  auto ret = dst >= 0 ? dst : temp();
+  emit(op, ret, l, r);
+  return ret;
+}
+
+std::int32_t
+Vm::assign(BinaryExpr* obj, std::int32_t dst, bool used)
+{
+  auto size = size_of(obj->lft->type);
+  auto lv = lval(obj->lft);
+
+  // 寄存器中的变量直接作为右值的目标，不需要额外的移动
+  if (lv.kind == LVal::kReg) {
+    rval(obj->rht, lv.reg);
+    if (dst >= 0 && dst != lv.reg)
+      emit(kMov, dst, lv.reg);
+    return dst >= 0 ? dst : lv.reg;
+  }
+
+  // x = x + e 与 x = e + x 用取数-加-存的超级指令，地址只求一次
+  auto add = strip_parens(obj->rht)->dcst<BinaryExpr>();
+  if (!used && size == 4 && add && add->op == BinaryExpr::kAdd) {
+    auto isSelf = [&](Expr* e) {
+      auto cast = strip_parens(e)->dcst<ImplicitCastExpr>();
+      return cast && cast->kind == ImplicitCastExpr::kLValueToRValue &&
+             same_lvalue(obj->lft, cast->sub);
+    };
+    Expr* other = nullptr;
+    if (isSelf(add->lft))
+      other = add->rht;
+    else if (isSelf(add->rht))
+      other = add->lft;
+    if (other) {
+      auto val = rval(other);
+      switch (lv.kind) {
+        case LVal::kGlob:
+          emit(kAddG32, lv.off, val);
+          return -1;
+        case LVal::kMem:
+          emit(kAddM32, lv.reg, lv.off, val);
+          return -1;
+        case LVal::kIdx:
+          emit(kAddX32, lv.reg, lv.idx, val);
+          return -1;
+        case LVal::kGIdx:
+          emit(kAddGX32, lv.off, lv.idx, val);
+          return -1;
+        default:
+          ABORT();
+      }
+    }
+  }
+
+  auto val = rval(obj->rht, dst);
+  store(lv, size, val);
+  return val;
+}
+
+std::int32_t
+Vm::call(CallExpr* obj, std::int32_t dst)
+{
+  auto head = strip_parens(obj->head);
+  if (auto p = head->dcst<ImplicitCastExpr>())
+    head = strip_parens(p->sub);
+  auto ref = head->dcst<DeclRefExpr>();
+  ASSERT(ref);
+  auto idx = mFuncIdx.at(ref->decl->name);
+  auto& func = mFuncs[idx];
+  func.used = true;
+  auto& callees = mFuncs[mCur].callees;
+  if (func.native < 0 &&
+      std::find(callees.begin(), callees.end(), idx) == callees.end())
+    callees.push_back(idx);
+
+  // 实参依次放在当前最高的临时寄存器中，它们就是被调用者的形参
+  auto argBase = mTop;
+  for (std::size_t i = 0; i < obj->args.size(); ++i)
+    temp();
+  for (std::size_t i = 0; i < obj->args.size(); ++i)
+    rval(obj->args[i], argBase + std::int32_t(i));
+
+  // 没有指定目标时返回值放在第一个实参的位置，其余的寄存器可以回收
+  std::int32_t ret = dst;
+  if (ret < 0) {
+    mTop = argBase;
+    ret = temp();
+  }
+  if (func.native >= 0)
+    emit(kCallN, ret, argBase, func.native);
+  else
+    emit(kCall, ret, argBase, idx);
+  return ret;
+}
+
+std::int32_t
+Vm::condValue(Expr* obj, std::int32_t dst)
+{
+  // 先写到临时寄存器，dst 可能是条件中用到的变量
+  auto ret = temp();
+  auto end = newLabel();
+  emit(kLi, ret, 1);
+  branch(obj, true, end);
+  emit(kLi, ret, 0);
+  bind(end);
+  if (dst < 0)
+    return ret;
+  emit(kMov, dst, ret);
+  return dst;
+}
+
+void
+Vm::branch(Expr* obj, bool jumpIf, std::int32_t label)
+{
+  obj = strip_parens(obj);
+
+  // 常量条件（例如 while (1)）要么总是跳转，要么不生成指令
+  if (auto c = constOf(obj)) {
+    if ((*c != 0) == jumpIf)
+      jump(kJmp, 0, 0, label);
+    return;
+  }
+
+  if (auto p = obj->dcst<UnaryExpr>(); p && p->op == UnaryExpr::kNot)
+    return branch(p->sub, !jumpIf, label);
+
+  if (auto p = obj->dcst<BinaryExpr>()) {
+    if (p->op == BinaryExpr::kAnd || p->op == BinaryExpr::kOr) {
+      // 与的两边都为真、或的两边都为假时才顺序执行
+      bool isAnd = p->op == BinaryExpr::kAnd;
+      if (isAnd != jumpIf) {
+        branch(p->lft, jumpIf, label);
+        branch(p->rht, jumpIf, label);
+      } else {
+        auto skip = newLabel();
+        branch(p->lft, !jumpIf, skip);
+        branch(p->rht, jumpIf, label);
+        bind(skip);
+      }
+      return;
+    }
+
+    if (auto cmp = cmp_index(p->op); cmp >= 0) {
+      if (!jumpIf)
+        cmp = kCmpInvert[cmp];
+      auto lft = p->lft, rht = p->rht;
+      auto c = constOf(rht);
+      if (!c && (c = constOf(lft))) {
+        std::swap(lft, rht);
+        cmp = kCmpSwap[cmp];
+      }
+      auto l = rval(lft);
+      if (c && fits(*c))
+        jump(Op(kJEqI + cmp), l, std::int32_t(*c), label);
+      else
+        jump(Op(kJEq + cmp), l, rval(rht), label);
+      return;
+    }
+  }
+
+  jump(jumpIf ? kJnz : kJz, rval(obj), 0, label);
+}
+
+void
+Vm::stmt(Stmt* obj)
+{
+  // 临时寄存器只在一条语句内有效
+  mTop = mNumVars;
+
+  if (auto p = obj->dcst<CompoundStmt>()) {
+    for (auto&& i : p->subs)
+      stmt(i);
+    return;
+  }
+
+  if (auto p = obj->dcst<DeclStmt>()) {
+    for (auto&& i : p->decls) {
+      if (auto var = i->dcst<VarDecl>())
+        localVar(var);
+    }
+    return;
+  }
+
+  if (auto p = obj->dcst<ExprStmt>()) {
+    if (p->expr)
+      effect(p->expr);
+    return;
+  }
+
+  if (auto p = obj->dcst<IfStmt>()) {
+    auto end = newLabel();
+    if (p->else_ == nullptr) {
+      branch(p->cond, false, end);
+      stmt(p->then);
+    } else {
+      auto els = newLabel();
+      branch(p->cond, false, els);
+      stmt(p->then);
+      jump(kJmp, 0, 0, end);
+      bind(els);
+      stmt(p->else_);
+    }
+    bind(end);
+    return;
+  }
+
+  // 循环把条件放在循环体之后，每次迭代只执行一条比较并跳转
+  if (auto p = obj->dcst<WhileStmt>()) {
+    auto body = newLabel(), cond = newLabel(), end = newLabel();
+    mLoops[p] = { end, cond };
+    jump(kJmp, 0, 0, cond);
+    bind(body);
+    if (mProfile)
+      emit(kProf, mCur);
+    stmt(p->body);
+    bind(cond);
+    mTop = mNumVars;
+    branch(p->cond, true, body);
+    bind(end);
+    return;
+  }
+
+  if (auto p = obj->dcst<DoStmt>()) {
+    auto body = newLabel(), cond = newLabel(), end = newLabel();
+    mLoops[p] = { end, cond };
+    bind(body);
+    if (mProfile)
+      emit(kProf, mCur);
+    stmt(p->body);
+    bind(cond);
+    mTop = mNumVars;
+    branch(p->cond, true, body);
+    bind(end);
+    return;
+  }
+
+  if (auto p = obj->dcst<BreakStmt>()) {
+    jump(kJmp, 0, 0, mLoops.at(p->loop).first);
+    return;
+  }
+
+  if (auto p = obj->dcst<ContinueStmt>()) {
+    jump(kJmp, 0, 0, mLoops.at(p->loop).second);
+    return;
+  }
+
+  if (auto p = obj->dcst<ReturnStmt>()) {
+    if (p->expr)
+      emit(kRet, rval(p->expr));
+    else
+      emit(kRetV);
+    return;
+  }
+
+  if (obj->dcst<NullStmt>())
+    return;
+
+  ABORT();
+}
+
+void
+Vm::localVar(VarDecl* obj)
+{
+  auto type = obj->type;
+
+  if (is_scalar(type->texp)) {
+    auto reg = newVar();
+    mLocals[obj] = { LVal::kReg, reg };
+    if (auto init = obj->init) {
+      if (auto list = init->dcst<InitListExpr>()) {
+        if (list->list.empty()) {
+          emit(kLi, reg, 0);
+          return;
+        }
+        init = list->list[0];
+      }
+      rval(init, reg);
+    }
+    return;
+  }
+
+  // 局部数组放在局部数组栈上，变量的寄存器中保存它的地址
+  auto size = size_of(type);
+  auto off = (std::int64_t(mFmem) + 7) & ~std::int64_t(7);
+  ASSERT(fits(off + size));
+  mFmem = std::int32_t(off + size);
+  auto reg = newVar();
+  emit(kFaddr, reg, std::int32_t(off));
+  LVal base{ LVal::kMem, reg };
+  mLocals[obj] = base;
+
+  if (obj->init) {
+    emit(kMemzero, reg, std::int32_t(size));
+    initStore(base, type->spec, type->texp, obj->init);
+  }
+}
+
+void
+Vm::initStore(const LVal& base, Type::Spec spec, TypeExpr* texp, Expr* init)
+{
+  if (init->dcst<ImplicitInitExpr>())
+    return;
+
+  if (auto p = init->dcst<InitListExpr>()) {
+    auto arr = texp ? texp->dcst<ArrayType>() : nullptr;
+    if (arr == nullptr) {
+      if (!p->list.empty())
+        initStore(base, spec, texp, p->list[0]);
+      return;
+    }
+    auto elem = size_of(spec, arr->sub);
+    for (std::size_t i = 0; i < p->list.size() && i < arr->len; ++i) {
+      auto sub = base;
+      sub.off += std::int32_t(i * elem);
+      initStore(sub, spec, arr->sub, p->list[i]);
+    }
+    return;
+  }
+
+  auto size = size_of(spec, texp);
+  auto c = constOf(init);
+  if (c && *c == 0)
+    return;
+  if (c && base.kind == LVal::kGlob) {
+    writeGlobal(base.off, size, *c);
+    return;
+  }
+  store(base, size, rval(init));
+  mTop = mNumVars;
+}
+
+void
+Vm::function(FunctionDecl* obj)
+{
+  mCur = mFuncIdx.at(obj->name);
+  auto& func = mFuncs[mCur];
+  func.decl = obj;
+  beginFunc(std::int32_t(obj->params.size()));
+  for (std::size_t i = 0; i < obj->params.size(); ++i)
+    mLocals[obj->params[i]] = { LVal::kReg, std::int32_t(i) };
+
+  func.entry = std::int32_t(mCode.size());
+  if (mProfile)
+    emit(kProf, mCur);
+  stmt(obj->body);
+
+  // 执行到函数末尾时返回，main 在这里返回 0
+  auto ftype = obj->type->texp->dcst<FunctionType>();
+  if (obj->type->spec == Type::Spec::kVoid && ftype->sub == nullptr)
+    emit(kRetV);
+  else {
+    mTop = mNumVars;
+    auto ret = temp();
+    emit(kLi, ret, 0);
+    emit(kRet, ret);
+  }
+  endFunc(func);
+}
+
+void
+Vm::dump(llvm::raw_ostream& os)
+{
+  std::unordered_map<std::int32_t, const Func*> entries;
+  for (auto&& func : mFuncs) {
+    if (func.entry >= 0)
+      entries.emplace(func.entry, &func);
+  }
+
+  for (std::size_t i = 0; i < mCode.size(); ++i) {
+    if (auto it = entries.find(std::int32_t(i)); it != entries.end()) {
+      auto func = it->second;
+      os << func->name << ": ; regs " << func->nregs << ", frame "
+         << func->fmem << "\n";
+    }
+    auto& insn = mCode[i];
+    os << llvm::format("%6zu  %-8s %d, %d, %d, %d\n",
+                       i,
+                       kOpNames[insn.op],
+                       insn.a,
+                       insn.b,
+                       insn.c,
+                       insn.d);
+  }
+}
+
+//==============================================================================
+// 解释执行
+//==============================================================================
+
+int
+Vm::run()
+{
+  struct Frame
+  {
+    const Insn* pc; /// 调用指令
+    std::int64_t* fp;
+    std::uint8_t* fm;
+  };
+
+  // 只分配不初始化，用到的部分才会真正占用内存
+  std::unique_ptr<std::int64_t[]> regs(new std::int64_t[mStackRegs]);
+  std::unique_ptr<std::uint8_t[]> mem(new std::uint8_t[mStackBytes]);
+  std::vector<Frame> frames;
+  frames.reserve(1024);
+
+  const Insn* code = mCode.data();
+  const Func* funcs = mFuncs.data();
+  std::uint8_t* gp = mGlobals.data();
+  std::int64_t* fp = regs.get();
+  std::int64_t* regEnd = fp + mStackRegs;
+  std::uint8_t* fm = mem.get();
+  std::uint8_t* memEnd = fm + mStackBytes;
+  std::uint8_t* fmTop = fm + funcs[mInit].fmem;
+  const Insn* pc = code + funcs[mInit].entry;
+  std::int64_t ret = 0;
+  bool halt = false;
+  ASSERT(std::size_t(funcs[mInit].nregs) <= mStackRegs);
+
+#define R(x) fp[pc->x]
+#define G(x) reinterpret_cast<std::int64_t>(gp + pc->x)
+
+#ifdef VM_THREADED
+  static const void* const kDispatch[] = {
+#define X(name) &&L##name,
+    VM_OPS(X)
+#undef X
+  };
+#define CASE(name) L##name:
+#define DISPATCH() goto* kDispatch[pc->op]
+  DISPATCH();
+#else
+#define CASE(name) case k##name:
+#define DISPATCH() continue
+  for (;;) {
+    switch (pc->op) {
+#endif
+#define NEXT()                                                                 \
+  ++pc;                                                                        \
+  DISPATCH()
+#define JUMP_IF(cond)                                                          \
+  if (cond) {                                                                  \
+    pc = code + pc->d;                                                         \
+    DISPATCH();                                                                \
+  }                                                                            \
+  NEXT()
+
+      CASE(Halt)
+      {
+        ret = R(a);
+        goto halt;
+      }
+      CASE(Mov)
+      {
+        R(a) = R(b);
+        NEXT();
+      }
+      CASE(Li)
+      {
+        R(a) = pc->b;
+        NEXT();
+      }
+      CASE(Li64)
+      {
+        R(a) = std::int64_t(std::uint64_t(std::uint32_t(pc->c)) << 32 |
+                            std::uint32_t(pc->b));
+        NEXT();
+      }
+
+      CASE(Add)
+      {
+        R(a) = s32(std::uint64_t(R(b)) + std::uint64_t(R(c)));
+        NEXT();
+      }
+      CASE(Sub)
+      {
+        R(a) = s32(std::uint64_t(R(b)) - std::uint64_t(R(c)));
+        NEXT();
+      }
+      CASE(Mul)
+      {
+        R(a) = s32(std::uint64_t(R(b)) * std::uint64_t(R(c)));
+        NEXT();
+      }
+      CASE(Div)
+      {
+        R(a) = std::int32_t(R(b)) / std::int32_t(R(c));
+        NEXT();
+      }
+      CASE(Rem)
+      {
+        R(a) = std::int32_t(R(b)) % std::int32_t(R(c));
+        NEXT();
+      }
+      CASE(Neg)
+      {
+        R(a) = s32(-std::uint64_t(R(b)));
+        NEXT();
+      }
+      CASE(AddI)
+      {
+        R(a) = s32(std::uint64_t(R(b)) + std::uint64_t(pc->c));
+        NEXT();
+      }
+      CASE(MulI)
+      {
+        R(a) = s32(std::uint64_t(R(b)) * std::uint64_t(pc->c));
+        NEXT();
+      }
+      CASE(DivI)
+      {
+        R(a) = std::int32_t(R(b)) / pc->c;
+        NEXT();
+      }
+      CASE(RemI)
+      {
+        R(a) = std::int32_t(R(b)) % pc->c;
+        NEXT();
+      }
+
+      CASE(Add64)
+      {
+        R(a) = std::int64_t(std::uint64_t(R(b)) + std::uint64_t(R(c)));
+        NEXT();
+      }
+      CASE(Sub64)
+      {
+        R(a) = std::int64_t(std::uint64_t(R(b)) - std::uint64_t(R(c)));
+        NEXT();
+      }
+      CASE(Mul64)
+      {
+        R(a) = std::int64_t(std::uint64_t(R(b)) * std::uint64_t(R(c)));
+        NEXT();
+      }
+      CASE(Div64)
+      {
+        R(a) = R(b) / R(c);
+        NEXT();
+      }
+      CASE(Rem64)
+      {
+        R(a) = R(b) % R(c);
+        NEXT();
+      }
+      CASE(Neg64)
+      {
+        R(a) = std::int64_t(-std::uint64_t(R(b)));
+        NEXT();
+      }
+      CASE(AddI64)
+      {
+        R(a) = std::int64_t(std::uint64_t(R(b)) + std::uint64_t(pc->c));
+        NEXT();
+      }
+      CASE(MulI64)
+      {
+        R(a) = std::int64_t(std::uint64_t(R(b)) * std::uint64_t(pc->c));
+        NEXT();
+      }
+
+      CASE(Not)
+      {
+        R(a) = R(b) == 0;
+        NEXT();
+      }
+      CASE(Trunc8)
+      {
+        R(a) = std::int8_t(R(b));
+        NEXT();
+      }
+      CASE(Trunc32)
+      {
+        R(a) = std::int32_t(R(b));
+        NEXT();
+      }
+
+      CASE(Jmp)
+      {
+        pc = code + pc->d;
+        DISPATCH();
+      }
+      CASE(Jz)
+      {
+        JUMP_IF(R(a) == 0);
+      }
+      CASE(Jnz)
+      {
+        JUMP_IF(R(a) != 0);
+      }
+      CASE(JEq)
+      {
+        JUMP_IF(R(a) == R(b));
+      }
+      CASE(JNe)
+      {
+        JUMP_IF(R(a) != R(b));
+      }
+      CASE(JLt)
+      {
+        JUMP_IF(R(a) < R(b));
+      }
+      CASE(JLe)
+      {
+        JUMP_IF(R(a) <= R(b));
+      }
+      CASE(JGt)
+      {
+        JUMP_IF(R(a) > R(b));
+      }
+      CASE(JGe)
+      {
+        JUMP_IF(R(a) >= R(b));
+      }
+      CASE(JEqI)
+      {
+        JUMP_IF(R(a) == pc->b);
+      }
+      CASE(JNeI)
+      {
+        JUMP_IF(R(a) != pc->b);
+      }
+      CASE(JLtI)
+      {
+        JUMP_IF(R(a) < pc->b);
+      }
+      CASE(JLeI)
+      {
+        JUMP_IF(R(a) <= pc->b);
+      }
+      CASE(JGtI)
+      {
+        JUMP_IF(R(a) > pc->b);
+      }
+      CASE(JGeI)
+      {
+        JUMP_IF(R(a) >= pc->b);
+      }
+
+      CASE(Ld8)
+      {
+        R(a) = load_mem<std::int8_t>(R(b) + pc->c);
+        NEXT();
+      }
+      CASE(Ld32)
+      {
+        R(a) = load_mem<std::int32_t>(R(b) + pc->c);
+        NEXT();
+      }
+      CASE(Ld64)
+      {
+        R(a) = load_mem<std::int64_t>(R(b) + pc->c);
+        NEXT();
+      }
+      CASE(St8)
+      {
+        store_mem<std::int8_t>(R(b) + pc->c, R(a));
+        NEXT();
+      }
+      CASE(St32)
+      {
+        store_mem<std::int32_t>(R(b) + pc->c, R(a));
+        NEXT();
+      }
+      CASE(St64)
+      {
+        store_mem<std::int64_t>(R(b) + pc->c, R(a));
+        NEXT();
+      }
+      CASE(LdG32)
+      {
+        R(a) = load_mem<std::int32_t>(G(b));
+        NEXT();
+      }
+      CASE(LdG64)
+      {
+        R(a) = load_mem<std::int64_t>(G(b));
+        NEXT();
+      }
+      CASE(StG32)
+      {
+        store_mem<std::int32_t>(G(b), R(a));
+        NEXT();
+      }
+      CASE(StG64)
+      {
+        store_mem<std::int64_t>(G(b), R(a));
+        NEXT();
+      }
+      CASE(LdX32)
+      {
+        R(a) = load_mem<std::int32_t>(R(b) + R(c) * 4);
+        NEXT();
+      }
+      CASE(LdX64)
+      {
+        R(a) = load_mem<std::int64_t>(R(b) + R(c) * 8);
+        NEXT();
+      }
+      CASE(StX32)
+      {
+        store_mem<std::int32_t>(R(b) + R(c) * 4, R(a));
+        NEXT();
+      }
+      CASE(StX64)
+      {
+        store_mem<std::int64_t>(R(b) + R(c) * 8, R(a));
+        NEXT();
+      }
+      CASE(LdGX32)
+      {
+        R(a) = load_mem<std::int32_t>(G(b) + R(c) * 4);
+        NEXT();
+      }
+      CASE(LdGX64)
+      {
+        R(a) = load_mem<std::int64_t>(G(b) + R(c) * 8);
+        NEXT();
+      }
+      CASE(StGX32)
+      {
+        store_mem<std::int32_t>(G(b) + R(c) * 4, R(a));
+        NEXT();
+      }
+      CASE(StGX64)
+      {
+        store_mem<std::int64_t>(G(b) + R(c) * 8, R(a));
+        NEXT();
+      }
+
+      CASE(AddG32)
+      {
+        auto addr = G(a);
+        store_mem<std::int32_t>(addr, load_mem<std::int32_t>(addr) + R(b));
+        NEXT();
+      }
+      CASE(AddM32)
+      {
+        auto addr = R(a) + pc->b;
+        store_mem<std::int32_t>(addr, load_mem<std::int32_t>(addr) + R(c));
+        NEXT();
+      }
+      CASE(AddX32)
+      {
+        auto addr = R(a) + R(b) * 4;
+        store_mem<std::int32_t>(addr, load_mem<std::int32_t>(addr) + R(c));
+        NEXT();
+      }
+      CASE(AddGX32)
+      {
+        auto addr = G(a) + R(b) * 4;
+        store_mem<std::int32_t>(addr, load_mem<std::int32_t>(addr) + R(c));
+        NEXT();
+      }
+
+      CASE(Gaddr)
+      {
+        R(a) = G(b);
+        NEXT();
+      }
+      CASE(Faddr)
+      {
+        R(a) = reinterpret_cast<std::int64_t>(fm + pc->b);
+        NEXT();
+      }
+      CASE(Idx)
+      {
+        R(a) = R(b) + R(c) * pc->d;
+        NEXT();
+      }
+      CASE(GIdx)
+      {
+        R(a) = G(b) + R(c) * pc->d;
+        NEXT();
+      }
+      CASE(Memzero)
+      {
+        std::memset(reinterpret_cast<void*>(R(a)), 0, pc->b);
+        NEXT();
+      }
+
+      CASE(Call)
+      {
+        auto& func = funcs[pc->c];
+        auto nfp = fp + pc->b;
+        if (nfp + func.nregs > regEnd || fmTop + func.fmem > memEnd)
+          goto overflow;
+        frames.push_back({ pc, fp, fm });
+        fp = nfp;
+        fm = fmTop;
+        fmTop += func.fmem;
+        pc = code + func.entry;
+        DISPATCH();
+      }
+      CASE(CallN)
+      {
+        auto val = native(pc->c, fp + pc->b, halt);
+        if (halt) {
+          ret = val;
+          goto halt;
+        }
+        R(a) = val;
+        NEXT();
+      }
+      CASE(CallJ)
+      {
+        R(a) = funcs[pc->c].compiled(fp + pc->b);
+        NEXT();
+      }
+      CASE(Ret)
+      {
+        // 回到调用指令，它的 a 是存放返回值的寄存器
+        auto val = R(a);
+        auto& frame = frames.back();
+        fmTop = fm;
+        fm = frame.fm;
+        fp = frame.fp;
+        pc = frame.pc;
+        frames.pop_back();
+        R(a) = val;
+        NEXT();
+      }
+      CASE(RetV)
+      {
+        auto& frame = frames.back();
+        fmTop = fm;
+        fm = frame.fm;
+        fp = frame.fp;
+        pc = frame.pc;
+        frames.pop_back();
+        NEXT();
+      }
+      CASE(Prof)
+      {
+        if (++mFuncs[pc->a].hot == mHotThreshold && mOnHot)
+          mOnHot(pc->a);
+        if (mHasReady.load(std::memory_order_acquire))
+          install();
+        NEXT();
+      }
+
+#ifndef VM_THREADED
+      default:
+        ABORT();
+    }
+  }
+#endif
+
+#undef R
+#undef G
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef JUMP_IF
+
+overflow:
+  std::fflush(stdout);
+  std::fprintf(stderr, "Error: stack overflow\n");
+  ret = -1;
+
+halt:
+  printTimer();
+  return int(ret);
+}
+
+//==============================================================================
+// 分层执行
+//==============================================================================
+
+void*
+Vm::globalAddr(VarDecl* var)
+{
+  return mGlobals.data() + mGlobalOff.at(var);
+}
+
+void
+Vm::publish(std::int32_t func, Compiled code)
+{
+  std::lock_guard<std::mutex> lock(mReadyMutex);
+  mReady.emplace_back(func, code);
+  mHasReady.store(true, std::memory_order_release);
+}
+
+void
+Vm::install()
+{
+  {
+    std::lock_guard<std::mutex> lock(mReadyMutex);
+    for (auto&& [func, code] : mReady)
+      mFuncs[func].compiled = code;
+    mReady.clear();
+    mHasReady.store(false, std::memory_order_relaxed);
+  }
+
+  // 指令只在解释器自己的线程里改写，不会与执行冲突
+  for (auto&& insn : mCode) {
+    if (insn.op == kCall && mFuncs[insn.c].compiled)
+      insn.op = kCallJ;
+  }
+}
+
+//==============================================================================
+// 运行时库
+//==============================================================================
+
+std::int64_t
+Vm::native(std::int32_t id, std::int64_t* args, bool& halt)
+{
+  auto i32 = [&](int i) { return int(args[i]); };
+  auto ptr = [&](int i) { return reinterpret_cast<char*>(args[i]); };
+  auto getint = [] {
+    int val = 0;
+    std::scanf("%d", &val);
+    return val;
+  };
+
+  switch (Native(id)) {
+    case kGetInt:
+      return getint();
+    case kGetCh: {
+      char ch = 0;
+      std::scanf("%c", &ch);
+      return ch;
+    }
+    case kGetArray: {
+      auto arr = reinterpret_cast<int*>(args[0]);
+      int n = getint();
+      for (int i = 0; i < n; ++i)
+        arr[i] = getint();
+      return n;
+    }
+    case kPutInt:
+      std::printf("%d", i32(0));
+      return 0;
+    case kPutCh:
+      std::printf("%c", i32(0));
+      return 0;
+    case kPutArray: {
+      int n = i32(0);
+      auto arr = reinterpret_cast<int*>(args[1]);
+      std::printf("%d:", n);
+      for (int i = 0; i < n; ++i)
+        std::printf(" %d", arr[i]);
+      std::printf("\n");
+      return 0;
+    }
+    case kStartTime:
+      mTimerStart.emplace_back(i32(0), Clock::now());
+      return 0;
+    case kStopTime:
+      mTimerStop.emplace_back(i32(0), Clock::now());
+      return 0;
+
+    case kGetChar:
+      return std::getchar();
+    case kPutChar:
+      return std::putchar(i32(0));
+    case kPuts:
+      return std::puts(ptr(0));
+    case kStrlen:
+      return std::int64_t(std::strlen(ptr(0)));
+    case kStrcmp:
+      return std::strcmp(ptr(0), ptr(1));
+    case kAtoi:
+      return std::atoi(ptr(0));
+    case kExit:
+      halt = true;
+      return i32(0);
+    case kOpen:
+      return ::open(ptr(0), i32(1), i32(2));
+    case kFcntl:
+      return ::fcntl(i32(0), i32(1), i32(2));
+    case kClose:
+      return ::close(i32(0));
+    case kRead:
+      return ::read(i32(0), ptr(1), args[2]);
+    case kWrite:
+      return ::write(i32(0), ptr(1), args[2]);
+    case kLseek64:
+      return ::lseek64(i32(0), args[1], i32(2));
+    case kFork:
+      return ::fork();
+    case kGetPid:
+      return ::getpid();
+    case kGetPPid:
+      return ::getppid();
+  }
+  ABORT();
+}
+
+void
+Vm::exit(int code)
+{
+  printTimer();
+  std::fflush(nullptr);
+  std::_Exit(code);
+}
+
+void
+Vm::printTimer()
+{
+  // 与 test/rtlib/sysy/sylib.cc 在进程退出时的输出完全相同
+  std::fflush(stdout);
+  auto print = [](long long us) {
+    auto s = us / 1000000;
+    us %= 1000000;
+    auto m = s / 60;
+    s %= 60;
+    auto h = m / 60;
+    m %= 60;
+    std::fprintf(
+      stderr, "%dH-%dM-%dS-%dus\n", (int)h, (int)m, (int)s, (int)us);
+  };
+
+  long long sumUs = 0;
+  for (std::size_t i = 0; i < mTimerStop.size() && i < mTimerStart.size();
+       ++i) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                mTimerStop[i].second - mTimerStart[i].second)
+                .count();
+    sumUs += us;
+    std::fprintf(stderr,
+                 "Timer@%04d-%04d: ",
+                 mTimerStart[i].first,
+                 mTimerStop[i].first);
+    print(us);
+  }
+  std::fprintf(stderr, "TOTAL: ");
+  print(sumUs);
+}
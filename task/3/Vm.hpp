@@ -0,0 +1,315 @@
+#pragma once
+
+#include "asg.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <llvm/Support/raw_ostream.h>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 字节码解释器
+ *
+ * 把类型检查后的 ASG 翻译为基于寄存器的字节码并直接解释执行，完全不经过
+ * LLVM，用于快速运行测例。
+ *
+ * 每个函数有一段连续的 64 位寄存器窗口，标量局部变量和形参都放在寄存器里
+ * （SysY 没有取地址运算，它们不会被间接访问）；局部数组放在另一个按字节分
+ * 配的栈上，全局变量和字符串字面量放在一整块全局内存中。指针就是宿主机的地
+ * 址，运行时库函数直接用 C 标准库实现，计时器的输出格式与 test/rtlib 相同。
+ *
+ * 被调用者的寄存器窗口从调用者放置实参的寄存器开始，所以传参不需要复制，形
+ * 参依次就是被调用者的 0、1、2…… 号寄存器。
+ *
+ * 分层执行时由 Tier 在后台把热点函数编译为本机代码，解释器随后把对它们的调
+ * 用改写为直接调用本机代码。基线编译时由 Baseline 把字节码逐条翻译为 x86-64
+ * 机器码后运行，不再解释执行。
+ */
+class Vm
+{
+public:
+  /// 操作码表。寄存器操作数记作 rX，立即数记作 iX，跳转目标总在 d 中
+#define VM_OPS(X)                                                              \
+  X(Halt)    /* 以 ra 为返回码结束 */                                          \
+  X(Mov)     /* ra = rb */                                                     \
+  X(Li)      /* ra = ib */                                                     \
+  X(Li64)    /* ra = ic << 32 | ib */                                          \
+  X(Add)     /* 以下 32 位运算的结果都截断后符号扩展 */                        \
+  X(Sub)                                                                       \
+  X(Mul)                                                                       \
+  X(Div)                                                                       \
+  X(Rem)                                                                       \
+  X(Neg)                                                                       \
+  X(AddI)    /* ra = rb + ic */                                                \
+  X(MulI)                                                                      \
+  X(DivI)                                                                      \
+  X(RemI)                                                                      \
+  X(Add64)                                                                     \
+  X(Sub64)                                                                     \
+  X(Mul64)                                                                     \
+  X(Div64)                                                                     \
+  X(Rem64)                                                                     \
+  X(Neg64)                                                                     \
+  X(AddI64)                                                                    \
+  X(MulI64)                                                                    \
+  X(Not)     /* ra = rb == 0 */                                                \
+  X(Trunc8)                                                                    \
+  X(Trunc32)                                                                   \
+  X(Jmp)                                                                       \
+  X(Jz)      /* ra == 0 时跳转 */                                              \
+  X(Jnz)                                                                       \
+  X(JEq)     /* 比较并跳转：ra 与 rb 比较 */                                   \
+  X(JNe)                                                                       \
+  X(JLt)                                                                       \
+  X(JLe)                                                                       \
+  X(JGt)                                                                       \
+  X(JGe)                                                                       \
+  X(JEqI)    /* 比较并跳转：ra 与 ib 比较 */                                   \
+  X(JNeI)                                                                      \
+  X(JLtI)                                                                      \
+  X(JLeI)                                                                      \
+  X(JGtI)                                                                      \
+  X(JGeI)                                                                      \
+  X(Ld8)     /* ra = *(rb + ic) */                                             \
+  X(Ld32)                                                                      \
+  X(Ld64)                                                                      \
+  X(St8)     /* *(rb + ic) = ra */                                             \
+  X(St32)                                                                      \
+  X(St64)                                                                      \
+  X(LdG32)   /* ra = *(全局内存 + ib) */                                       \
+  X(LdG64)                                                                     \
+  X(StG32)                                                                     \
+  X(StG64)                                                                     \
+  X(LdX32)   /* ra = rb[rc] */                                                 \
+  X(LdX64)                                                                     \
+  X(StX32)   /* rb[rc] = ra */                                                 \
+  X(StX64)                                                                     \
+  X(LdGX32)  /* ra = (全局内存 + ib)[rc] */                                    \
+  X(LdGX64)                                                                    \
+  X(StGX32)                                                                    \
+  X(StGX64)                                                                    \
+  X(AddG32)  /* 取数-加-存：*(全局内存 + ia) += rb */                          \
+  X(AddM32)  /* *(ra + ib) += rc */                                            \
+  X(AddX32)  /* ra[rb] += rc */                                                \
+  X(AddGX32) /* (全局内存 + ia)[rb] += rc */                                   \
+  X(Gaddr)   /* ra = 全局内存 + ib */                                          \
+  X(Faddr)   /* ra = 局部数组栈帧 + ib */                                      \
+  X(Idx)     /* ra = rb + rc * id */                                           \
+  X(GIdx)    /* ra = 全局内存 + ib + rc * id */                                \
+  X(Memzero) /* 把 ra 开始的 ib 个字节清零 */                                  \
+  X(Call)    /* 调用函数 ic，实参从 rb 开始，返回值写到 ra */                  \
+  X(CallN)   /* 调用运行时库函数 ic */                                         \
+  X(CallJ)   /* 同 Call，但函数 ic 已经编译为本机代码 */                       \
+  X(Ret)     /* 返回 ra */                                                     \
+  X(RetV)                                                                      \
+  X(Prof)    /* 函数 ia 的热度计数，只在分层执行时生成 */
+
+  enum Op : std::uint32_t
+  {
+#define X(name) k##name,
+    VM_OPS(X)
+#undef X
+      kOpCount,
+  };
+
+  struct Insn
+  {
+    Op op;
+    std::int32_t a, b, c, d;
+  };
+
+  /// 编译好的本机代码：从寄存器窗口中读取实参，返回值扩展为 64 位
+  using Compiled = std::int64_t (*)(std::int64_t* args);
+
+  struct Func
+  {
+    std::string name;
+    asg::FunctionDecl* decl{ nullptr }; /// 有定义的函数的定义
+    std::int32_t entry{ -1 }; /// 第一条指令的下标，-1 表示没有定义
+    std::int32_t nregs{ 0 };  /// 寄存器窗口的大小
+    std::int32_t fmem{ 0 };   /// 局部数组占用的字节数
+    std::int32_t native{ -1 }; /// 运行时库函数的编号
+    bool used{ false };
+    std::vector<std::int32_t> callees; /// 直接调用的有定义的函数
+    std::uint32_t hot{ 0 };            /// 调用与回边的次数
+    Compiled compiled{ nullptr };
+  };
+
+  /// 寄存器栈的容量（个）与局部数组栈的容量（字节）
+  std::size_t mStackRegs{ std::size_t(1) << 24 };
+  std::size_t mStackBytes{ std::size_t(1) << 28 };
+
+  /// 翻译整个翻译单元，失败时在标准输出打印错误信息并返回 false
+  bool operator()(asg::TranslationUnit* tu);
+
+  /// 执行全局变量的初始化和 main，返回进程应当使用的返回码
+  int run();
+
+  /// 以文本形式打印字节码
+  void dump(llvm::raw_ostream& os);
+
+  //============================================================================
+  // 分层执行
+  //============================================================================
+
+  /**
+   * 在函数入口和循环体开头生成计数指令，某个函数的调用与回边次数之和达到
+   * \p mHotThreshold 时调用一次 \p mOnHot。必须在翻译前设置。
+   */
+  bool mProfile{ false };
+  std::uint32_t mHotThreshold{ 1000 };
+  std::function<void(std::int32_t func)> mOnHot;
+
+  const std::vector<Func>& funcs() const { return mFuncs; }
+
+  /// 全局变量在全局内存中的地址，翻译之后不再变化
+  void* globalAddr(asg::VarDecl* var);
+
+  /**
+   * 登记 \p func 编译好的本机代码，可以在其他线程中调用。解释器在下一条计
+   * 数指令处把调用它的 Call 都改写为 CallJ，正在解释执行的调用不受影响。
+   */
+  void publish(std::int32_t func, Compiled code);
+
+  /// 调用编号为 \p id 的运行时库函数，程序要求退出时设置 \p halt
+  std::int64_t native(std::int32_t id, std::int64_t* args, bool& halt);
+
+  /// 像程序正常结束那样打印计时器并以 \p code 退出进程，供本机代码调用
+  [[noreturn]] void exit(int code);
+
+  //============================================================================
+  // 基线编译
+  //============================================================================
+
+  const std::vector<Insn>& code() const { return mCode; }
+
+  /// 初始化全局变量后调用 main 的合成函数，它以 Halt 结束
+  std::int32_t init() const { return mInit; }
+
+  /// 全局内存的起始地址，翻译之后不再变化
+  std::uint8_t* globals() { return mGlobals.data(); }
+
+  /// 打印运行时库的计时器记录，程序结束时调用
+  void printTimer();
+
+private:
+  std::vector<Insn> mCode;
+  std::vector<Func> mFuncs;
+  std::unordered_map<std::string, std::int32_t> mFuncIdx;
+  std::int32_t mInit{ -1 }; /// 初始化全局变量后调用 main 的合成函数
+  std::int32_t mCur{ -1 };  /// 正在翻译的函数
+
+  /// 已经编译好、等待解释器换用的函数
+  std::mutex mReadyMutex;
+  std::vector<std::pair<std::int32_t, Compiled>> mReady;
+  std::atomic<bool> mHasReady{ false };
+
+  /// 全局内存，翻译时写入常量初始值
+  std::vector<std::uint8_t> mGlobals;
+  std::unordered_map<asg::Decl*, std::int32_t> mGlobalOff;
+
+  /// 运行时库的计时器记录
+  using Clock = std::chrono::high_resolution_clock;
+  std::vector<std::pair<int, Clock::time_point>> mTimerStart, mTimerStop;
+
+  //============================================================================
+  // 翻译
+  //============================================================================
+
+  /// 左值：变量所在的寄存器，或者内存地址的几种形式
+  struct LVal
+  {
+    enum Kind
+    {
+      kReg,  /// 寄存器 reg
+      kGlob, /// 全局内存 + off
+      kMem,  /// reg + off
+      kIdx,  /// reg + idx * scale
+      kGIdx, /// 全局内存 + off + idx * scale
+    } kind;
+    std::int32_t reg{ 0 }, idx{ 0 }, off{ 0 }, scale{ 0 };
+  };
+
+  /// 当前函数的局部变量，数组变量的寄存器中是它在局部数组栈上的地址
+  std::unordered_map<asg::Decl*, LVal> mLocals;
+
+  /// 变量占用的寄存器之上是临时寄存器，每条语句开始时回收
+  std::int32_t mNumVars, mTop, mMaxRegs, mFmem;
+
+  /// 标签的位置和待回填的跳转指令
+  std::vector<std::int32_t> mLabels;
+  std::vector<std::pair<std::int32_t, std::int32_t>> mFixups;
+
+  /// 循环语句对应的 break、continue 标签
+  std::unordered_map<asg::Stmt*, std::pair<std::int32_t, std::int32_t>>
+    mLoops;
+
+  std::int32_t emit(Op op,
+                    std::int32_t a = 0,
+                    std::int32_t b = 0,
+                    std::int32_t c = 0,
+                    std::int32_t d = 0);
+  std::int32_t newLabel();
+  void bind(std::int32_t label);
+  void jump(Op op, std::int32_t a, std::int32_t b, std::int32_t label);
+  std::int32_t temp();
+  std::int32_t newVar();
+  void li(std::int32_t dst, std::int64_t val);
+
+  /// 从空的寄存器窗口开始翻译一个函数，结束时回填跳转并记下窗口大小
+  void beginFunc(std::int32_t nparams);
+  void endFunc(Func& func);
+
+  std::int32_t allocGlobal(std::uint32_t size);
+  void writeGlobal(std::int32_t off, unsigned size, std::int64_t val);
+
+  /// 在编译期对整数表达式求值，结果按表达式的类型截断
+  std::optional<std::int64_t> constOf(asg::Expr* obj);
+
+  LVal lval(asg::Expr* obj);
+
+  /**
+   * 求右值，返回存放结果的寄存器。\p dst 非负时结果必须写到 \p dst；否则可
+   * 能直接返回变量所在的寄存器，调用者不能写它。
+   */
+  std::int32_t rval(asg::Expr* obj, std::int32_t dst = -1);
+
+  /// 只为副作用求值，赋值语句可以用上取数-加-存的超级指令
+  void effect(asg::Expr* obj);
+
+  std::int32_t load(const LVal& lv, unsigned size, std::int32_t dst);
+  void store(const LVal& lv, unsigned size, std::int32_t src);
+  std::int32_t addrOf(const LVal& lv, std::int32_t dst = -1);
+
+  std::int32_t arith(asg::BinaryExpr* obj, std::int32_t dst);
+  std::int32_t assign(asg::BinaryExpr* obj, std::int32_t dst, bool used);
+  std::int32_t call(asg::CallExpr* obj, std::int32_t dst);
+  std::int32_t condValue(asg::Expr* obj, std::int32_t dst);
+
+  /**
+   * 把 \p obj 作为条件翻译为跳转：值为 \p jumpIf 时跳到 \p label，否则顺序
+   * 执行。比较直接生成比较并跳转的指令，&&、||、! 展开成跳转。
+   */
+  void branch(asg::Expr* obj, bool jumpIf, std::int32_t label);
+
+  void stmt(asg::Stmt* obj);
+  void localVar(asg::VarDecl* obj);
+
+  /**
+   * 按初始化列表为 \p base 处的对象写入非零的元素，对象已经清零。全局变量
+   * 中编译期能求值的元素直接写进全局内存，其余的生成代码
+   */
+  void initStore(const LVal& base,
+                 asg::Type::Spec spec,
+                 asg::TypeExpr* texp,
+                 asg::Expr* init);
+
+  void function(asg::FunctionDecl* obj);
+
+  /// 换用已经编译好的函数，改写调用它们的指令
+  void install();
+};
@@ -1,4 +1,7 @@
-#pragma once
+// task/2/common 与 task/3 中各有一份相同的 asg.hpp，编译驱动会同时包含两者，
+// 所以用同名的宏而不是 #pragma once 防止重复定义。
+#ifndef SYSU_ASG_HPP
+#define SYSU_ASG_HPP
 
 #include "Obj.hpp"
 #include <string>
@@ -388,3 +391,5 @@ private:
 };
 
 } // namespace asg
+
+#endif // SYSU_ASG_HPP
@@ -1,54 +1,345 @@
+#include "AsgDigest.hpp"
+#include "Baseline.hpp"
+#include "Bin2Asg.hpp"
+#include "Cache.hpp"
 #include "EmitIR.hpp"
+#include "Incremental.hpp"
 #include "Json2Asg.hpp"
+#include "ParallelEmit.hpp"
+#include "Vm.hpp"
 #include "asg.hpp"
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/MemoryBuffer.h>
+#include <optional>
+#include <thread>
+
+#ifdef TASK3_TIER
+#include "Tier.hpp"
+#endif
+
+namespace {
+
+llvm::cl::opt<std::string> gInputPath(llvm::cl::Positional,
+                                      llvm::cl::Required,
+                                      llvm::cl::desc("<input>"));
+
+llvm::cl::opt<std::string> gOutputPath(llvm::cl::Positional,
+                                       llvm::cl::desc("<output>"));
+
+llvm::cl::opt<bool> gTimeStages(
+  "time-stages",
+  llvm::cl::desc("在标准错误输出中打印各阶段的耗时"));
+
+llvm::cl::opt<std::string> gCacheDir(
+  "cache-dir",
+  llvm::cl::desc("编译缓存目录，不指定时不使用缓存"),
+  llvm::cl::value_desc("dir"));
+
+llvm::cl::opt<std::uint64_t> gCacheSize(
+  "cache-size",
+  llvm::cl::desc("编译缓存的容量上限，单位为 MiB"),
+  llvm::cl::init(1024));
+
+llvm::cl::opt<bool> gCacheStats(
+  "cache-stats",
+  llvm::cl::desc("在标准错误输出中打印编译缓存的累计命中统计"));
+
+llvm::cl::opt<bool> gIncremental(
+  "incremental",
+  llvm::cl::desc("以函数为单位缓存翻译结果，只重新翻译改动过的函数，需要同时"
+                 "指定 -cache-dir"));
+
+llvm::cl::opt<bool> gEntryAllocas(
+  "entry-allocas",
+  llvm::cl::desc("把局部变量的 alloca 都放到函数的入口块"),
+  llvm::cl::init(true));
+
+llvm::cl::opt<bool> gEmitBc(
+  "emit-bc",
+  llvm::cl::desc("以位码格式输出 LLVM IR，输出文件以 .bc 结尾时自动开启"));
+
+llvm::cl::opt<unsigned> gJobs(
+  "j",
+  llvm::cl::desc("翻译函数体的线程数，为 0 时使用硬件线程数"),
+  llvm::cl::init(1));
+
+llvm::cl::opt<bool> gInterp(
+  "interp",
+  llvm::cl::desc("不生成 LLVM IR，用字节码解释器直接运行程序，以程序的返回值"
+                 "作为返回码，这时不需要指定输出文件"));
+
+llvm::cl::opt<bool> gDumpBytecode(
+  "dump-bytecode",
+  llvm::cl::desc("解释执行前在标准错误输出中打印字节码"));
+
+llvm::cl::opt<bool> gTier(
+  "tier",
+  llvm::cl::desc("分层执行：先解释执行，热点函数在后台经过实验四的优化流水线"
+                 "编译为本机代码，隐含 -interp，需要以 TASK3_TIER=ON 配置"));
+
+llvm::cl::opt<unsigned> gTierThreshold(
+  "tier-threshold",
+  llvm::cl::desc("函数的调用与回边次数之和达到多少时编译为本机代码"),
+  llvm::cl::init(1000));
+
+llvm::cl::opt<bool> gTierLog(
+  "tier-log",
+  llvm::cl::desc("在标准错误输出中打印分层执行编译了哪些函数"));
+
+llvm::cl::opt<bool> gBaseline(
+  "baseline",
+  llvm::cl::desc("不经过 LLVM，用基线编译器把字节码直接翻译为 x86-64 机器码"
+                 "运行，隐含 -interp"));
+
+/// 阶段计时器，析构时打印从构造开始经过的时间，格式供 test/task3/bench.py
+/// 解析。
+struct StageTimer
+{
+  using Clock = std::chrono::steady_clock;
+
+  const char* mName;
+  Clock::time_point mStart;
+
+  StageTimer(const char* name)
+    : mName(name)
+    , mStart(Clock::now())
+  {
+  }
+
+  ~StageTimer()
+  {
+    if (!gTimeStages)
+      return;
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - mStart)
+                .count();
+    llvm::errs() << "阶段 " << mName << " 耗时 " << us << "us\n";
+  }
+};
+
+/// 读取 JSON 或二进制格式的 ASG，JSON 解析失败时打印错误信息并返回空
+asg::TranslationUnit*
+read_asg(Obj::Mgr& mgr, llvm::StringRef buf)
+{
+  if (Bin2Asg::is_bin(buf)) {
+    // 读取二进制格式的 ASG，各段在映射的缓冲区上原地访问
+    StageTimer timer("bin2asg");
+    Bin2Asg bin2asg(mgr);
+    return bin2asg(buf);
+  }
+
+  llvm::Expected<llvm::json::Value> json = nullptr;
+  {
+    StageTimer timer("json");
+    json = llvm::json::parse(buf);
+  }
+  if (!json) {
+    llvm::consumeError(json.takeError());
+    std::cout << "Error: unable to parse input file: " << gInputPath << '\n';
+    return nullptr;
+  }
+
+  // 读取 JSON，转换为 ASG
+  StageTimer timer("json2asg");
+  Json2Asg json2asg(mgr);
+  return json2asg(json.get());
+}
+
+} // namespace
 
 int
 main(int argc, char* argv[])
 {
-  if (argc != 3) {
-    std::cout << "Usage: " << argv[0] << " <input> <output>\n";
-    return -1;
-  }
+  llvm::cl::ParseCommandLineOptions(argc, argv);
 
-  auto inFileOrErr = llvm::MemoryBuffer::getFile(argv[1]);
+  // 输入不要求以 '\0' 结尾，这样较大的文件可以直接 mmap 进来
+  auto inFileOrErr = llvm::MemoryBuffer::getFile(
+    gInputPath, /*IsText=*/false, /*RequiresNullTerminator=*/false);
   if (auto err = inFileOrErr.getError()) {
-    std::cout << "Error: unable to open input file: " << argv[1] << '\n';
+    std::cout << "Error: unable to open input file: " << gInputPath << '\n';
     return -2;
   }
   auto inFile = std::move(inFileOrErr.get());
+
+  // 解释执行时不生成 LLVM IR，也不使用缓存
+  if (gInterp || gTier || gBaseline) {
+    Obj::Mgr mgr;
+    auto asg = read_asg(mgr, inFile->getBuffer());
+    if (asg == nullptr)
+      return 1;
+    Vm vm;
+#ifdef TASK3_TIER
+    std::optional<Tier> tier;
+    if (gTier && !gBaseline) {
+      tier.emplace(vm, mgr, asg);
+      vm.mHotThreshold = gTierThreshold;
+      if (gTierLog)
+        tier->mLog = &llvm::errs();
+    }
+#else
+    if (gTier && !gBaseline) {
+      std::cout << "Error: -tier requires configuring with TASK3_TIER=ON\n";
+      return 5;
+    }
+#endif
+    {
+      StageTimer timer("lower");
+      if (!vm(asg))
+        return 1;
+    }
+    if (gDumpBytecode)
+      vm.dump(llvm::errs());
+    if (gBaseline) {
+      Baseline baseline(vm);
+      {
+        StageTimer timer("baseline");
+        if (!baseline())
+          return 5;
+      }
+      return baseline.run();
+    }
+#ifdef TASK3_TIER
+    if (tier) {
+      if (auto err = tier->start()) {
+        std::cout << "Error: unable to start the JIT: "
+                  << llvm::toString(std::move(err)) << '\n';
+        return 5;
+      }
+    }
+#endif
+    return vm.run();
+  }
+
+  if (gOutputPath.empty()) {
+    std::cout << "Usage: " << argv[0] << " <input> <output>\n";
+    return -1;
+  }
   std::error_code ec;
-  llvm::StringRef outPath(argv[2]);
+  llvm::StringRef outPath(gOutputPath);
   llvm::raw_fd_ostream outFile(outPath, ec);
   if (ec) {
-    std::cout << "Error: unable to open output file: " << argv[2] << '\n';
+    std::cout << "Error: unable to open output file: " << gOutputPath << '\n';
     return -3;
   }
 
-  auto json = llvm::json::parse(inFile->getBuffer());
-  if (!json) {
-    std::cout << "Error: unable to parse input file: " << argv[1] << '\n';
-    return 1;
+  // 位码省去了文本的打印和实验四的词法、语法分析，文本仍是评测用的默认格式
+  bool bitcode = gEmitBc || outPath.ends_with(".bc");
+
+  // 输出只由输入内容和编译器本身决定，命中缓存时直接写出上次的结果
+  std::optional<Cache> cache;
+  std::string cacheKey;
+  llvm::StringRef mode = gEntryAllocas ? "entry-allocas" : "";
+  if (!gCacheDir.empty()) {
+    cache.emplace(gCacheDir, gCacheSize << 20);
+    cacheKey = Cache::key(
+      argv[0],
+      { "task3", mode, bitcode ? "bc" : "ll", inFile->getBuffer() });
+    if (auto hit = cache->lookup(cacheKey)) {
+      outFile << hit->getBuffer();
+      if (gCacheStats)
+        cache->print_stats(llvm::errs());
+      return 0;
+    }
   }
 
-  // 读取 JSON，转换为 ASG
   Obj::Mgr mgr;
-  Json2Asg json2asg(mgr);
-  auto asg = json2asg(json.get());
+  auto asg = read_asg(mgr, inFile->getBuffer());
+  if (asg == nullptr)
+    return 1;
   mgr.mRoot = asg;
   mgr.gc();
 
   // 从 ASG 发射到 LLVM IR
   llvm::LLVMContext ctx;
   EmitIR emitIR(mgr, ctx);
-  auto& mod = emitIR(asg);
+  emitIR.mEntryAllocas = gEntryAllocas;
+
+  // 增量编译时，摘要没有变化的函数只生成声明，函数体稍后从缓存链接回来
+  std::optional<Incremental> inc;
+  std::vector<std::pair<asg::FunctionDecl*, std::string>> rebuilt;
+  if (cache && gIncremental) {
+    StageTimer timer("digest");
+    inc.emplace(*cache);
+    AsgDigest digest;
+    for (auto&& i : asg->decls) {
+      auto func = i->dcst<asg::FunctionDecl>();
+      if (func == nullptr || func->body == nullptr)
+        continue;
+      auto key = Cache::key(argv[0], { "task3-func", mode, digest(func) });
+      if (inc->lookup(key))
+        emitIR.mDeclOnly.insert(func);
+      else
+        rebuilt.emplace_back(func, std::move(key));
+    }
+  }
+
+  // 多线程时函数体先在工作线程中翻译为片段，主线程只生成它们的声明
+  std::optional<ParallelEmit> par;
+  unsigned jobs = gJobs ? gJobs : std::thread::hardware_concurrency();
+  llvm::Module* mod;
+  {
+    StageTimer timer("emit");
+    if (jobs > 1) {
+      par.emplace(mgr, jobs);
+      par->mEntryAllocas = gEntryAllocas;
+      auto done = (*par)(asg, emitIR.mDeclOnly);
+      emitIR.mDeclOnly.insert(done.begin(), done.end());
+    }
+    mod = &emitIR(asg);
+  }
   mgr.gc();
 
+  if (par) {
+    StageTimer timer("link");
+    if (!par->link(*mod)) {
+      std::cout << "Error: unable to link functions emitted in parallel\n";
+      return 4;
+    }
+  }
+
+  if (inc) {
+    StageTimer timer("link");
+    if (!inc->link(*mod)) {
+      std::cout << "Error: corrupted function cache in: " << gCacheDir << '\n';
+      return 4;
+    }
+  }
+
   // 先把 LLVM IR 写出到文件里，再检查合不合法
-  mod.print(outFile, nullptr, false, true);
-  if (llvm::verifyModule(mod, &llvm::outs()))
+  std::string text;
+  {
+    StageTimer timer("print");
+    auto write = [&](llvm::raw_ostream& os) {
+      if (bitcode)
+        llvm::WriteBitcodeToFile(*mod, os);
+      else
+        mod->print(os, nullptr, false, true);
+    };
+    if (cache) {
+      // raw_string_ostream 默认不带缓冲，打印时的大量零碎写入会很慢
+      llvm::raw_string_ostream os(text);
+      os.SetBuffered();
+      write(os);
+      outFile << os.str();
+    } else
+      write(outFile);
+  }
+  if (llvm::verifyModule(*mod, &llvm::outs()))
     return 3;
+
+  // 不合法的结果不进缓存，下次仍然会重新编译并报错
+  if (cache) {
+    for (auto&& [func, key] : rebuilt)
+      inc->store(*mod->getFunction(func->name), key);
+    cache->store(cacheKey, text);
+    if (inc && gCacheStats)
+      inc->print_stats(llvm::errs());
+    if (gCacheStats)
+      cache->print_stats(llvm::errs());
+  }
 }
@@ -0,0 +1,228 @@
+#include "ADCE.hpp"
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Analysis/PostDominators.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Operator.h>
+#include <llvm/Transforms/Utils/Local.h>
+
+using namespace llvm;
+
+namespace {
+
+/// 指针（包括由它算出的 GEP）的所有使用都只是作为 store 的地址
+bool
+isWriteOnly(Value* ptr)
+{
+  for (auto user : ptr->users()) {
+    if (auto store = dyn_cast<StoreInst>(user)) {
+      if (store->getValueOperand() == ptr || store->isVolatile())
+        return false;
+    } else if (!isa<GEPOperator>(user) || !isWriteOnly(user)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// 把 \p bb 的条件跳转改为无条件地跳到 \p target
+void
+makeUnconditional(BasicBlock* bb, BasicBlock* target)
+{
+  auto term = bb->getTerminator();
+  bool kept = false;
+  for (auto succ : successors(bb)) {
+    if (succ == target && !kept)
+      kept = true;
+    else
+      succ->removePredecessor(bb, true);
+  }
+  // 原来不是前驱时，target 中的 phi 都是死的，随后会被删除
+  if (!kept) {
+    for (auto& phi : target->phis())
+      phi.addIncoming(UndefValue::get(phi.getType()), bb);
+  }
+  BranchInst::Create(target, term);
+  term->eraseFromParent();
+}
+
+} // namespace
+
+PreservedAnalyses
+ADCE::run(Module& mod, ModuleAnalysisManager& mam)
+{
+  // 与 SCCP 相同，模块是完整的程序时，运行时库不会读取其中的全局变量
+  mWriteOnly.clear();
+  for (auto& gvar : mod.globals()) {
+    if (mWholeProgram && !gvar.isDeclaration() && isWriteOnly(&gvar))
+      mWriteOnly.insert(&gvar);
+  }
+
+  unsigned removed = 0, deadBlocks = 0;
+  for (auto& func : mod) {
+    if (!func.isDeclaration())
+      removed += runOnFunction(func, deadBlocks);
+  }
+
+  mOut << "ADCE running...\nTo eliminate " << removed << " instructions and "
+       << deadBlocks << " blocks\n";
+  return removed || deadBlocks ? PreservedAnalyses::none()
+                               : PreservedAnalyses::all();
+}
+
+unsigned
+ADCE::runOnFunction(Function& func, unsigned& deadBlocks)
+{
+  // 只有默认分支的 switch 先改为无条件跳转，之后的条件跳转都至少有两条出
+  // 边，要么是活的，要么被改为跳到活的后必经块，不会留下条件已被删除的跳转
+  for (auto& bb : func) {
+    auto sw = dyn_cast<SwitchInst>(bb.getTerminator());
+    if (sw && sw->getNumCases() == 0) {
+      BranchInst::Create(sw->getDefaultDest(), sw);
+      sw->eraseFromParent();
+    }
+  }
+
+  for (auto& inst : func.getEntryBlock()) {
+    if (isa<AllocaInst>(inst) && isWriteOnly(&inst))
+      mWriteOnly.insert(&inst);
+  }
+
+  // 控制依赖：块 b 后必经 a 的某个后继但不严格后必经 a 时，b 控制依赖于 a。
+  // 从每个后继沿后必经树向上走到 a 的直接后必经节点为止，经过的都依赖于 a
+  PostDominatorTree pdt(func);
+  DenseMap<BasicBlock*, SmallVector<BasicBlock*, 2>> controlDeps;
+  for (auto& bb : func) {
+    auto node = pdt.getNode(&bb);
+    if (node == nullptr || bb.getTerminator()->getNumSuccessors() < 2)
+      continue;
+    for (auto succ : successors(&bb)) {
+      for (auto runner = pdt.getNode(succ);
+           runner && runner->getBlock() && runner != node->getIDom();
+           runner = runner->getIDom())
+        controlDeps[runner->getBlock()].push_back(&bb);
+    }
+  }
+
+  // 到不了返回的块构成死循环，其中的跳转必须保留
+  DenseSet<BasicBlock*> toExit;
+  std::vector<BasicBlock*> stack;
+  for (auto& bb : func) {
+    auto term = bb.getTerminator();
+    if (isa<ReturnInst>(term) || isa<UnreachableInst>(term)) {
+      toExit.insert(&bb);
+      stack.push_back(&bb);
+    }
+  }
+  while (!stack.empty()) {
+    auto bb = stack.back();
+    stack.pop_back();
+    for (auto pred : predecessors(bb)) {
+      if (toExit.insert(pred).second)
+        stack.push_back(pred);
+    }
+  }
+
+  DenseSet<Instruction*> live;
+  DenseSet<BasicBlock*> liveBlocks;
+  std::vector<Instruction*> work;
+
+  auto markLive = [&](Instruction* inst) {
+    if (live.insert(inst).second)
+      work.push_back(inst);
+  };
+  auto markBlock = [&](BasicBlock* bb) {
+    if (!liveBlocks.insert(bb).second)
+      return;
+    if (auto br = dyn_cast<BranchInst>(bb->getTerminator());
+        br && br->isUnconditional())
+      markLive(br);
+    auto it = controlDeps.find(bb);
+    if (it != controlDeps.end()) {
+      for (auto dep : it->second)
+        markLive(dep->getTerminator());
+    }
+  };
+
+  // 根：有副作用的指令
+  for (auto& inst : instructions(func)) {
+    if (auto store = dyn_cast<StoreInst>(&inst)) {
+      auto obj = getUnderlyingObject(store->getPointerOperand());
+      if (store->isVolatile() || !mWriteOnly.count(obj))
+        markLive(&inst);
+    } else if (isa<BranchInst>(inst) || isa<SwitchInst>(inst)) {
+      if (!toExit.count(inst.getParent()))
+        markLive(&inst);
+    } else if (inst.isTerminator() || inst.mayHaveSideEffects()) {
+      markLive(&inst);
+    }
+  }
+
+  // 死的条件跳转改为跳到最近的活的后必经块
+  auto liveSuccessor = [&](BasicBlock* bb) -> BasicBlock* {
+    auto node = pdt.getNode(bb);
+    for (node = node ? node->getIDom() : nullptr; node && node->getBlock();
+         node = node->getIDom()) {
+      if (liveBlocks.count(node->getBlock()))
+        return node->getBlock();
+    }
+    return nullptr;
+  };
+
+  DenseMap<BasicBlock*, BasicBlock*> retarget;
+  bool again;
+  do {
+    while (!work.empty()) {
+      auto inst = work.back();
+      work.pop_back();
+      markBlock(inst->getParent());
+      // phi 的值取决于从哪个前驱进入，前驱块所依赖的跳转都是活的
+      if (auto phi = dyn_cast<PHINode>(inst)) {
+        for (auto pred : phi->blocks())
+          markBlock(pred);
+      }
+      for (auto& op : inst->operands()) {
+        if (auto opInst = dyn_cast<Instruction>(op))
+          markLive(opInst);
+      }
+    }
+
+    // 找不到活的后必经块的跳转保守地当作活的，再传播一遍
+    again = false;
+    retarget.clear();
+    for (auto& bb : func) {
+      auto term = bb.getTerminator();
+      if (live.count(term) || term->getNumSuccessors() < 2)
+        continue;
+      if (auto target = liveSuccessor(&bb))
+        retarget[&bb] = target;
+      else {
+        markLive(term);
+        again = true;
+      }
+    }
+  } while (again);
+
+  unsigned instsBefore = func.getInstructionCount();
+  unsigned blocksBefore = func.size();
+
+  for (auto [bb, target] : retarget)
+    makeUnconditional(bb, target);
+  removeUnreachableBlocks(func);
+
+  // 死指令之间可能互相引用，先断开再删除
+  std::vector<Instruction*> dead;
+  for (auto& inst : instructions(func)) {
+    if (!inst.isTerminator() && !live.count(&inst))
+      dead.push_back(&inst);
+  }
+  for (auto inst : dead)
+    inst->dropAllReferences();
+  for (auto inst : dead)
+    inst->eraseFromParent();
+
+  deadBlocks += blocksBefore - func.size();
+  return instsBefore - func.getInstructionCount();
+}
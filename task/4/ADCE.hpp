@@ -0,0 +1,54 @@
+#pragma once
+
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Support/raw_ostream.h>
+
+/**
+ * @brief 激进的死代码删除
+ *
+ * 先假定所有指令都是死的，从有副作用的指令（返回、调用、写入可能被读取的内
+ * 存）出发标记活指令：活指令的操作数是活的，活指令所在块控制依赖的条件跳转
+ * 是活的，活的 phi 的各个前驱块也是活的。其余的指令全部删除，死的条件跳转改
+ * 为直接跳到最近的活的后必经块，中间变得不可达的块随之删除，所以计算结果没
+ * 人用的循环会整体消失。
+ *
+ * 函数中的局部变量只被写入、从未被读取时，写入它们的 store 不算副作用；模块
+ * 是完整的程序时，只写不读的全局变量也是如此。到不了返回的块（死循环）中的跳
+ * 转总是活的。
+ */
+class ADCE : public llvm::PassInfoMixin<ADCE>
+{
+public:
+  /// \p wholeProgram 为假时模块中可能缺少其他函数的函数体，写入全局变量的
+  /// store 总是活的
+  ADCE(llvm::raw_ostream& out, bool wholeProgram)
+    : mOut(out)
+    , mWholeProgram(wholeProgram)
+  {
+  }
+
+  llvm::PreservedAnalyses run(llvm::Module& mod,
+                              llvm::ModuleAnalysisManager& mam);
+
+  /// 两种模式的结果不同，流水线描述中要能区分
+  void printPipeline(
+    llvm::raw_ostream& os,
+    llvm::function_ref<llvm::StringRef(llvm::StringRef)> mapClassName2PassName)
+  {
+    os << mapClassName2PassName(name());
+    if (!mWholeProgram)
+      os << "<partial>";
+  }
+
+private:
+  llvm::raw_ostream& mOut;
+  bool mWholeProgram;
+
+  /// 只被写入的全局变量与局部变量
+  llvm::DenseSet<const llvm::Value*> mWriteOnly;
+
+  /// 返回删除的指令数，\p deadBlocks 累加删除的基本块数
+  unsigned runOnFunction(llvm::Function& func, unsigned& deadBlocks);
+};
@@ -0,0 +1,210 @@
+#include "Cache.hpp"
+#include <cinttypes>
+#include <cstring>
+#include <elf.h>
+#include <link.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/SHA1.h>
+
+namespace {
+
+/// 主程序中 GNU build ID 注记的内容，链接时没有生成注记时返回空
+std::string
+gnu_build_id()
+{
+  std::string id;
+  dl_iterate_phdr(
+    [](dl_phdr_info* info, std::size_t, void* data) {
+      auto& id = *static_cast<std::string*>(data);
+      for (int i = 0; i < info->dlpi_phnum; ++i) {
+        auto& phdr = info->dlpi_phdr[i];
+        if (phdr.p_type != PT_NOTE)
+          continue;
+        std::uint64_t align = phdr.p_align == 8 ? 8 : 4;
+        auto p = reinterpret_cast<const char*>(info->dlpi_addr + phdr.p_vaddr);
+        auto end = p + phdr.p_memsz;
+        while (p + sizeof(ElfW(Nhdr)) <= end) {
+          auto nhdr = reinterpret_cast<const ElfW(Nhdr)*>(p);
+          auto name = p + sizeof(*nhdr);
+          auto desc = name + llvm::alignTo(nhdr->n_namesz, align);
+          if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 &&
+              std::memcmp(name, "GNU", 4) == 0) {
+            id.assign(desc, nhdr->n_descsz);
+            return 1;
+          }
+          p = desc + llvm::alignTo(nhdr->n_descsz, align);
+        }
+      }
+      return 1; // 第一个对象就是主程序，不再看共享库
+    },
+    &id);
+  return id;
+}
+
+} // namespace
+
+Cache::Cache(std::string dir, std::uint64_t maxBytes)
+  : mDir(std::move(dir))
+  , mMaxBytes(maxBytes)
+{
+  llvm::sys::fs::create_directories(mDir);
+}
+
+Cache::~Cache()
+{
+  flush_stats();
+}
+
+std::string
+Cache::key(const char* argv0, std::initializer_list<llvm::StringRef> parts)
+{
+  llvm::SHA1 sha1;
+
+  // 每一部分前面加上长度，避免不同的切分方式拼出相同的字节串
+  auto update = [&](llvm::StringRef s) {
+    std::uint64_t size = s.size();
+    sha1.update(llvm::StringRef(reinterpret_cast<const char*>(&size),
+                                sizeof(size)));
+    sha1.update(s);
+  };
+
+  for (auto&& i : parts)
+    update(i);
+
+  // 构建标识只取决于编译器可执行文件的内容，相同的二进制在不同的机器和路径
+  // 下得到相同的键。增量编译时每个函数都要算一次键，只在第一次时计算
+  static const std::string sBuildId = [&] {
+    auto id = gnu_build_id();
+    if (!id.empty())
+      return id;
+    // 没有 build ID 时退而对整个可执行文件求哈希
+    auto exe = llvm::sys::fs::getMainExecutable(
+      argv0, reinterpret_cast<void*>(&Cache::key));
+    auto buf = llvm::MemoryBuffer::getFile(
+      exe, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (exe.empty() || !buf)
+      return std::string();
+    return llvm::toHex(
+      llvm::SHA1::hash(llvm::arrayRefFromStringRef((*buf)->getBuffer())));
+  }();
+  update(sBuildId);
+
+  return llvm::toHex(sha1.final(), /*LowerCase=*/true);
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+Cache::lookup(llvm::StringRef key)
+{
+  auto path = entry_path(key);
+  int fd;
+  if (llvm::sys::fs::openFileForRead(path, fd)) {
+    ++mMisses;
+    return nullptr;
+  }
+
+  auto bufOrErr = llvm::MemoryBuffer::getOpenFile(
+    llvm::sys::fs::convertFDToNativeFile(fd),
+    path,
+    /*FileSize=*/-1,
+    /*RequiresNullTerminator=*/false);
+  // 刷新访问时间，淘汰时按它判断最近是否用过
+  if (bufOrErr)
+    llvm::sys::fs::setLastAccessAndModificationTime(
+      fd, std::chrono::system_clock::now());
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+
+  if (!bufOrErr) {
+    ++mMisses;
+    return nullptr;
+  }
+  ++mHits;
+  return std::move(*bufOrErr);
+}
+
+void
+Cache::store(llvm::StringRef key, llvm::StringRef data, bool prune)
+{
+  // 先写到同一目录下的临时文件，写完后原子地重命名为缓存项
+  auto temp = llvm::sys::fs::TempFile::create(mDir + "/tmp-%%%%%%%%");
+  if (!temp) {
+    llvm::consumeError(temp.takeError());
+    return;
+  }
+  {
+    llvm::raw_fd_ostream os(temp->FD, /*shouldClose=*/false);
+    os << data;
+  }
+  if (auto err = temp->keep(entry_path(key))) {
+    llvm::consumeError(std::move(err));
+    return;
+  }
+  if (!prune)
+    return;
+
+  llvm::CachePruningPolicy policy;
+  policy.Interval = std::chrono::seconds(0); // 每次写入后都检查容量
+  policy.Expiration = std::chrono::seconds(0);
+  policy.MaxSizeBytes = mMaxBytes;
+  llvm::pruneCache(mDir, policy);
+}
+
+void
+Cache::print_stats(llvm::raw_ostream& os)
+{
+  auto [hit, miss] = flush_stats();
+  os << "编译缓存累计命中 " << hit << " 次，未命中 " << miss << " 次";
+  if (hit + miss)
+    os << "，命中率 " << llvm::format("%.1f", 100.0 * hit / (hit + miss))
+       << "%";
+  os << '\n';
+}
+
+std::string
+Cache::entry_path(llvm::StringRef key)
+{
+  return (mDir + "/llvmcache-" + key).str();
+}
+
+std::pair<std::uint64_t, std::uint64_t>
+Cache::flush_stats()
+{
+  std::uint64_t hit = 0, miss = 0;
+  int fd;
+  if (llvm::sys::fs::openFileForReadWrite(mDir + "/stats",
+                                          fd,
+                                          llvm::sys::fs::CD_OpenAlways,
+                                          llvm::sys::fs::OF_None))
+    return { hit, miss };
+
+  // 读出、累加、写回的过程中持有文件锁，并发运行的进程不会互相覆盖
+  if (!llvm::sys::fs::lockFile(fd)) {
+    char buf[64];
+    auto n = llvm::sys::fs::readNativeFile(
+      llvm::sys::fs::convertFDToNativeFile(fd), buf);
+    if (n) {
+      auto [h, m] = llvm::StringRef(buf, *n).trim().split(' ');
+      if (h.getAsInteger(10, hit) || m.trim().getAsInteger(10, miss))
+        hit = miss = 0;
+    } else
+      llvm::consumeError(n.takeError());
+
+    if (mHits || mMisses) {
+      hit += mHits;
+      miss += mMisses;
+      // 定宽写回，文件大小不变，总是覆盖原来的内容
+      llvm::raw_fd_ostream os(fd, /*shouldClose=*/false);
+      os.seek(0);
+      os << llvm::format("%20" PRIu64 " %20" PRIu64 "\n", hit, miss);
+    }
+    llvm::sys::fs::unlockFile(fd);
+  }
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+
+  mHits = mMisses = 0;
+  return { hit, miss };
+}
@@ -0,0 +1,67 @@
+#include "Codegen.hpp"
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/TargetParser/Host.h>
+
+llvm::Error
+emit_object(llvm::Module& mod,
+            llvm::CodeGenOpt::Level level,
+            llvm::StringRef path)
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  auto triple = llvm::sys::getDefaultTargetTriple();
+  std::string msg;
+  auto target = llvm::TargetRegistry::lookupTarget(triple, msg);
+  if (target == nullptr)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(), msg);
+
+  // 与 clang 默认生成的可执行文件一样使用位置无关代码
+  std::unique_ptr<llvm::TargetMachine> tm(
+    target->createTargetMachine(triple,
+                                llvm::sys::getHostCPUName(),
+                                "",
+                                llvm::TargetOptions(),
+                                llvm::Reloc::PIC_,
+                                std::nullopt,
+                                level));
+  mod.setTargetTriple(triple);
+  mod.setDataLayout(tm->createDataLayout());
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_None);
+  if (ec)
+    return llvm::errorCodeToError(ec);
+
+  llvm::legacy::PassManager pm;
+  if (tm->addPassesToEmitFile(pm, os, nullptr, llvm::CGFT_ObjectFile))
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "target cannot emit object files");
+  pm.run(mod);
+  return llvm::Error::success();
+}
+
+llvm::Error
+link_executable(llvm::StringRef obj, llvm::StringRef rtlib, llvm::StringRef exe)
+{
+  auto cxx = llvm::sys::findProgramByName("c++");
+  if (!cxx)
+    return llvm::errorCodeToError(cxx.getError());
+
+  // 运行时库是 C++ 写的，用 C++ 的驱动才会带上 libstdc++
+  std::string rpath = ("-Wl,-rpath," + llvm::sys::path::parent_path(rtlib)).str();
+  llvm::StringRef args[] = { *cxx, "-o", exe, obj, rtlib, rpath };
+  std::string msg;
+  int ret = llvm::sys::ExecuteAndWait(*cxx, args, std::nullopt, {}, 0, 0, &msg);
+  if (ret != 0)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "linker failed: " + msg);
+  return llvm::Error::success();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Support/Error.h>
+
+/**
+ * 用本机目标的 TargetMachine 把 \p mod 编译为目标文件写到 \p path，\p level
+ * 是后端的优化级别。会设置 \p mod 的目标三元组与数据布局。
+ */
+llvm::Error
+emit_object(llvm::Module& mod,
+            llvm::CodeGenOpt::Level level,
+            llvm::StringRef path);
+
+/**
+ * 调用系统的 C++ 编译器驱动把目标文件 \p obj 与运行时库 \p rtlib 链接为可执
+ * 行文件 \p exe，运行时库的目录写入 rpath，可执行文件可以直接运行。
+ */
+llvm::Error
+link_executable(llvm::StringRef obj, llvm::StringRef rtlib, llvm::StringRef exe);
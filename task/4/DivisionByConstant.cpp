@@ -0,0 +1,148 @@
+#include "DivisionByConstant.hpp"
+
+using namespace llvm;
+
+namespace {
+
+/// n 与魔数的 2N 位乘积右移 shift 位，再截断回 N 位
+Value*
+mulShr(IRBuilder<>& b,
+       Value* n,
+       const APInt& magic,
+       unsigned shift,
+       bool isSigned)
+{
+  auto ty = cast<IntegerType>(n->getType());
+  auto wide = b.getIntNTy(ty->getBitWidth() * 2);
+  auto ext = isSigned ? b.CreateSExt(n, wide) : b.CreateZExt(n, wide);
+  auto prod = b.CreateMul(
+    ext, ConstantInt::get(wide, magic.zextOrTrunc(wide->getBitWidth())));
+  auto high = isSigned ? b.CreateAShr(prod, shift) : b.CreateLShr(prod, shift);
+  return b.CreateTrunc(high, ty);
+}
+
+/// 有符号数 n 除以 |d|，向零取整，\p ad 是按无符号数解释的 |d|，不小于 2
+Value*
+emitSDivAbs(IRBuilder<>& b, Value* n, const APInt& ad)
+{
+  unsigned bits = ad.getBitWidth();
+
+  if (ad.isPowerOf2()) {
+    // 负数右移是向下取整，先加上 2^k - 1
+    unsigned k = ad.logBase2();
+    auto bias = b.CreateLShr(b.CreateAShr(n, bits - 1), bits - k);
+    return b.CreateAShr(b.CreateAdd(n, bias), k);
+  }
+
+  unsigned l = ad.ceilLogBase2(), w = 2 * bits + 2;
+  auto magic = APInt::getOneBitSet(w, bits + l - 1).udiv(ad.zext(w)) + 1;
+  auto q = mulShr(b, n, magic, bits + l - 1, true);
+  // 乘积右移是向下取整，n 为负时加 1
+  return b.CreateSub(q, b.CreateAShr(n, bits - 1));
+}
+
+/// 无符号数 n 除以 d，d 不小于 2
+Value*
+emitUDiv(IRBuilder<>& b, Value* n, const APInt& d)
+{
+  if (d.isPowerOf2())
+    return b.CreateLShr(n, d.logBase2());
+
+  unsigned bits = d.getBitWidth(), l = d.ceilLogBase2(), w = 2 * bits + 2;
+  auto wideD = d.zext(w);
+  APInt magic;
+  unsigned s = 0;
+  for (;; ++s) {
+    auto pow = APInt::getOneBitSet(w, bits + s);
+    magic = pow.udiv(wideD) + 1;
+    if ((magic * wideD - pow).ule(APInt::getOneBitSet(w, s)))
+      break;
+  }
+  if (magic.ult(APInt::getOneBitSet(w, bits)))
+    return mulShr(b, n, magic, bits + s, false);
+
+  // 魔数有 N + 1 位，这时 s = l，把最高位拆出来单独加上
+  auto t = mulShr(b, n, magic - APInt::getOneBitSet(w, bits), bits, false);
+  auto half = b.CreateLShr(b.CreateSub(n, t), 1);
+  return b.CreateLShr(b.CreateAdd(half, t), l - 1);
+}
+
+/// 改写 \p binOp，不能改写时返回 nullptr
+Value*
+rewrite(BinaryOperator* binOp)
+{
+  auto c = dyn_cast<ConstantInt>(binOp->getOperand(1));
+  if (c == nullptr || c->isZero())
+    return nullptr;
+  unsigned bits = c->getBitWidth();
+  if (bits < 2 || bits > 32)
+    return nullptr;
+
+  IRBuilder<> b(binOp);
+  auto n = binOp->getOperand(0);
+  const auto& d = c->getValue();
+  auto zero = ConstantInt::get(binOp->getType(), 0);
+
+  switch (binOp->getOpcode()) {
+    case Instruction::SDiv: {
+      if (c->isOne())
+        return n;
+      if (c->isMinusOne())
+        return b.CreateNeg(n);
+      auto q = emitSDivAbs(b, n, d.abs());
+      return d.isNegative() ? b.CreateNeg(q) : q;
+    }
+
+    case Instruction::SRem: {
+      // 余数的符号与被除数相同，n % d == n % |d|
+      if (c->isOne() || c->isMinusOne())
+        return zero;
+      auto ad = d.abs();
+      auto q = emitSDivAbs(b, n, ad);
+      auto prod = ad.isPowerOf2() ? b.CreateShl(q, ad.logBase2())
+                                  : b.CreateMul(q, b.getInt(ad));
+      return b.CreateSub(n, prod);
+    }
+
+    case Instruction::UDiv:
+      if (c->isOne())
+        return n;
+      return emitUDiv(b, n, d);
+
+    case Instruction::URem:
+      if (c->isOne())
+        return zero;
+      if (d.isPowerOf2())
+        return b.CreateAnd(n, b.getInt(d - 1));
+      return b.CreateSub(n, b.CreateMul(emitUDiv(b, n, d), c));
+
+    default:
+      return nullptr;
+  }
+}
+
+} // namespace
+
+PreservedAnalyses
+DivisionByConstant::run(Module& mod, ModuleAnalysisManager& mam)
+{
+  int count = 0;
+
+  for (auto& func : mod) {
+    for (auto& bb : func) {
+      for (auto it = bb.begin(); it != bb.end();) {
+        auto binOp = dyn_cast<BinaryOperator>(&*it++);
+        if (binOp == nullptr)
+          continue;
+        if (auto result = rewrite(binOp)) {
+          binOp->replaceAllUsesWith(result);
+          binOp->eraseFromParent();
+          ++count;
+        }
+      }
+    }
+  }
+
+  mOut << "DivisionByConstant: " << count << " instructions replaced\n";
+  return count ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
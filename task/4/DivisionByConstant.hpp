@@ -0,0 +1,38 @@
+#pragma once
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Support/raw_ostream.h>
+
+/**
+ * @brief 除以常量
+ *
+ * 把除数为常量的 sdiv、udiv、srem、urem 改写为乘法、移位与符号修正
+ * （Granlund–Montgomery）。N 位的被除数扩展到 2N 位后乘以魔数，取高位即为
+ * 商，所以只处理不超过 32 位的整数，乘法总是一条 64 位乘法：
+ *
+ * - 有符号：m = floor(2^(N+l-1) / |d|) + 1，l = ceil(log2 |d|)，商为
+ *   (n * m) >> (N+l-1)，n 为负时再加 1，d 为负时取相反数；
+ * - 无符号：取最小的 s 使 m = floor(2^(N+s) / d) + 1 满足
+ *   m * d - 2^(N+s) <= 2^s，m 不足 N 位时商为 (n * m) >> (N+s)，否则用
+ *   m - 2^N 算出高位 t，商为 (((n - t) >> 1) + t) >> (l-1)；
+ * - 除数为 2 的幂时直接移位，有符号数先给负的被除数加上 2^k - 1，使结果向零
+ *   取整；
+ * - 余数为 n - q * d，2 的幂的无符号余数为按位与。
+ *
+ * 后端以 -O0 生成代码时不会自己做这一改写。
+ */
+class DivisionByConstant : public llvm::PassInfoMixin<DivisionByConstant>
+{
+public:
+  explicit DivisionByConstant(llvm::raw_ostream& out)
+    : mOut(out)
+  {
+  }
+
+  llvm::PreservedAnalyses run(llvm::Module& mod,
+                              llvm::ModuleAnalysisManager& mam);
+
+private:
+  llvm::raw_ostream& mOut;
+};
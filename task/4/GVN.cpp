@@ -0,0 +1,189 @@
+#include "GVN.hpp"
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/ScopedHashTable.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+
+using namespace llvm;
+
+namespace {
+
+/// 值编号的键，两条指令的键相同时计算的值也相同
+struct Expr
+{
+  unsigned opcode{ 0 };
+  Type* type{ nullptr };
+  unsigned pred{ 0 };
+  Type* srcElemType{ nullptr };
+  SmallVector<Value*, 4> ops;
+
+  bool operator==(const Expr& other) const
+  {
+    return std::tie(opcode, type, pred, srcElemType, ops) ==
+           std::tie(other.opcode,
+                    other.type,
+                    other.pred,
+                    other.srcElemType,
+                    other.ops);
+  }
+};
+
+} // namespace
+
+template<>
+struct llvm::DenseMapInfo<Expr>
+{
+  // 不存在的操作码作为空键与墓碑键
+  static Expr getEmptyKey() { return { ~0U, nullptr, 0, nullptr, {} }; }
+
+  static Expr getTombstoneKey() { return { ~1U, nullptr, 0, nullptr, {} }; }
+
+  static unsigned getHashValue(const Expr& expr)
+  {
+    return hash_combine(expr.opcode,
+                        expr.type,
+                        expr.pred,
+                        expr.srcElemType,
+                        hash_combine_range(expr.ops.begin(), expr.ops.end()));
+  }
+
+  static bool isEqual(const Expr& a, const Expr& b) { return a == b; }
+};
+
+namespace {
+
+Expr
+makeExpr(Instruction* inst)
+{
+  Expr expr{ inst->getOpcode(), inst->getType(), 0, nullptr, {} };
+  expr.ops.assign(inst->op_begin(), inst->op_end());
+
+  // 操作数按地址排列，a + b 与 b + a、a < b 与 b > a 得到同样的键
+  if (auto cmp = dyn_cast<CmpInst>(inst)) {
+    auto pred = cmp->getPredicate();
+    if (expr.ops[1] < expr.ops[0]) {
+      std::swap(expr.ops[0], expr.ops[1]);
+      pred = cmp->getSwappedPredicate();
+    }
+    expr.pred = pred;
+  } else if (isa<BinaryOperator>(inst) && inst->isCommutative()) {
+    if (expr.ops[1] < expr.ops[0])
+      std::swap(expr.ops[0], expr.ops[1]);
+  } else if (auto gep = dyn_cast<GetElementPtrInst>(inst)) {
+    expr.srcElemType = gep->getSourceElementType();
+  }
+  return expr;
+}
+
+} // namespace
+
+PreservedAnalyses
+GVN::run(Module& mod, ModuleAnalysisManager& mam)
+{
+  findPureFunctions(mod);
+
+  unsigned removed = 0;
+  for (auto& func : mod) {
+    if (!func.isDeclaration())
+      removed += runOnFunction(func);
+  }
+
+  mOut << "GVN: " << removed << " redundant instructions removed\n";
+  if (removed == 0)
+    return PreservedAnalyses::all();
+  PreservedAnalyses pa;
+  pa.preserveSet<CFGAnalyses>();
+  return pa;
+}
+
+void
+GVN::findPureFunctions(Module& mod)
+{
+  // 先假定所有定义都是纯的，再反复去掉读写内存或调用了非纯函数的，这样互相
+  // 递归的纯函数也能识别出来。模块只是程序的一部分时，调用者的结果不能依赖于
+  // 被调用者的函数体，不做这样的推断
+  mPure.clear();
+  for (auto& func : mod) {
+    if (func.isDeclaration() ? func.doesNotAccessMemory() : mWholeProgram)
+      mPure.insert(&func);
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto& func : mod) {
+      if (func.isDeclaration() || !mPure.count(&func))
+        continue;
+      bool pure = llvm::all_of(instructions(func), [&](Instruction& inst) {
+        if (auto call = dyn_cast<CallInst>(&inst))
+          return mPure.count(call->getCalledFunction()) != 0;
+        return !inst.mayReadOrWriteMemory();
+      });
+      if (!pure) {
+        mPure.erase(&func);
+        changed = true;
+      }
+    }
+  }
+}
+
+unsigned
+GVN::runOnFunction(Function& func)
+{
+  auto numberable = [&](Instruction* inst) {
+    if (auto call = dyn_cast<CallInst>(inst))
+      return mPure.count(call->getCalledFunction()) != 0;
+    return isa<BinaryOperator>(inst) || isa<UnaryOperator>(inst) ||
+           isa<CmpInst>(inst) || isa<CastInst>(inst) ||
+           isa<SelectInst>(inst) || isa<GetElementPtrInst>(inst);
+  };
+
+  // 每个块一个作用域，离开块时撤销本块加入的表项
+  using Table = ScopedHashTable<Expr, Instruction*>;
+  Table table;
+
+  struct Frame
+  {
+    DomTreeNode* node;
+    DomTreeNode::const_iterator child;
+    std::unique_ptr<Table::ScopeTy> scope;
+  };
+  std::vector<Frame> stack;
+
+  unsigned removed = 0;
+  auto enter = [&](DomTreeNode* node) {
+    stack.push_back(
+      { node, node->begin(), std::make_unique<Table::ScopeTy>(table) });
+    auto bb = node->getBlock();
+    for (auto it = bb->begin(); it != bb->end();) {
+      auto inst = &*it++;
+      if (!numberable(inst))
+        continue;
+      auto expr = makeExpr(inst);
+      auto leader = table.lookup(expr);
+      if (leader == nullptr) {
+        table.insert(std::move(expr), inst);
+        continue;
+      }
+      // 两条指令上 nsw、inbounds 等标志不同时只保留共有的
+      leader->andIRFlags(inst);
+      inst->replaceAllUsesWith(leader);
+      inst->eraseFromParent();
+      ++removed;
+    }
+  };
+
+  // 支配树可能很深，用显式的栈代替递归；作用域必须按后进先出的顺序销毁
+  DominatorTree dt(func);
+  enter(dt.getRootNode());
+  while (!stack.empty()) {
+    auto& top = stack.back();
+    if (top.child != top.node->end()) {
+      auto child = *top.child++;
+      enter(child);
+      continue;
+    }
+    stack.pop_back();
+  }
+  return removed;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Support/raw_ostream.h>
+
+/**
+ * @brief 全局值编号
+ *
+ * 以操作码、结果类型、比较谓词和各个操作数为键给没有副作用的指令编号，可交
+ * 换运算的两个操作数、比较的两边按固定顺序排列后再编号。沿支配树先序遍历，
+ * 散列表按支配树分作用域：进入一个块时继承支配它的所有块中的表项，离开时撤
+ * 销本块加入的表项。遇到已经有编号的指令时，支配它的同号指令一定已经算出了
+ * 同样的值，用后者替换并删除它。
+ *
+ * 覆盖算术与位运算、比较、类型转换、select、GEP，以及对纯函数的调用。模块是
+ * 完整的程序时，不读写内存、只调用纯函数的函数视为纯函数，这样的调用多次执行
+ * 的结果相同。
+ */
+class GVN : public llvm::PassInfoMixin<GVN>
+{
+public:
+  /// \p wholeProgram 为假时模块中的函数体可能在之后单独改变，只有声明为不访
+  /// 问内存的函数是纯函数
+  GVN(llvm::raw_ostream& out, bool wholeProgram)
+    : mOut(out)
+    , mWholeProgram(wholeProgram)
+  {
+  }
+
+  llvm::PreservedAnalyses run(llvm::Module& mod,
+                              llvm::ModuleAnalysisManager& mam);
+
+  /// 两种模式的结果不同，流水线描述中要能区分
+  void printPipeline(
+    llvm::raw_ostream& os,
+    llvm::function_ref<llvm::StringRef(llvm::StringRef)> mapClassName2PassName)
+  {
+    os << mapClassName2PassName(name());
+    if (!mWholeProgram)
+      os << "<partial>";
+  }
+
+private:
+  llvm::raw_ostream& mOut;
+  bool mWholeProgram;
+
+  /// 模块中的纯函数
+  llvm::DenseSet<llvm::Function*> mPure;
+
+  void findPureFunctions(llvm::Module& mod);
+
+  /// 返回删除的指令数
+  unsigned runOnFunction(llvm::Function& func);
+};
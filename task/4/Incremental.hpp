@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Cache.hpp"
+#include <llvm/IR/Module.h>
+
+/**
+ * @brief 函数粒度的增量编译
+ *
+ * 以函数为单位缓存编译结果：每个函数的结果保存为一个模块片段，其中只有这个
+ * 函数的定义和它引用到的全局对象的声明，以位码格式存放在编译缓存中。再次编
+ * 译时，键没有变化的函数只生成声明，不再翻译或优化函数体，最后用
+ * llvm::Linker 把缓存的片段链接回模块，于是编译耗时只与改动的函数有关。
+ *
+ * 这要求一个函数的结果只取决于它自己和它引用的声明。实验三的翻译逐个函数进
+ * 行，自然满足这一点；实验四的优化流水线在增量编译时以 wholeProgram 为假构
+ * 造，SCCP、GVN、ADCE 等不再根据其他函数的函数体推断全局变量只读、只写或函
+ * 数是纯的，流水线描述随之改变，与完整编译的缓存互不混用。以后加入过程间的
+ * 变换时，同样要在这种模式下关闭它。局部链接的函数，以及引用了局部链接的全局
+ * 对象的函数无法单独成为片段，总是重新编译。
+ *
+ * 本文件在 task/3 与 task/4 中各有一份，两者必须保持一致。
+ */
+class Incremental
+{
+public:
+  Cache& mCache;
+
+  Incremental(Cache& cache)
+    : mCache(cache)
+  {
+  }
+
+  /// 提取 \p func 的片段，函数不能单独缓存时返回空。
+  static std::unique_ptr<llvm::Module> extract(const llvm::Function& func);
+
+  /**
+   * 计算 \p func 的指纹：片段的位码，再加上它引用的全局变量的初始值，后者虽
+   * 然不在片段中，但优化时可能用到。函数不能单独缓存时返回 false。
+   */
+  static bool fingerprint(const llvm::Function& func, std::string& out);
+
+  /// 查找缓存的片段，命中时记下片段留待 link 链接回模块。
+  bool lookup(llvm::StringRef key);
+
+  /// 提取 \p func 的片段写入缓存。
+  void store(const llvm::Function& func, llvm::StringRef key);
+
+  /// 把命中的片段链接回 \p mod，函数保持原来的顺序，失败时返回 false。
+  bool link(llvm::Module& mod);
+
+  /// 把位码格式的片段 \p frags 链接进 \p mod，全局对象保持 \p mod 中原来的
+  /// 顺序，失败时返回 false。
+  static bool link(llvm::Module& mod,
+                   llvm::ArrayRef<std::unique_ptr<llvm::MemoryBuffer>> frags);
+
+  /// 打印本次编译复用和重新编译的函数个数。
+  void print_stats(llvm::raw_ostream& os);
+
+private:
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> mHits;
+  std::size_t mReused{ 0 }, mRebuilt{ 0 };
+};
@@ -0,0 +1,49 @@
+#include "Jit.hpp"
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/Support/TargetSelect.h>
+
+llvm::Expected<int>
+run_jit(std::unique_ptr<llvm::Module> mod,
+        std::unique_ptr<llvm::LLVMContext> ctx,
+        llvm::StringRef rtlib)
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  auto jit = llvm::orc::LLJITBuilder().create();
+  if (!jit)
+    return jit.takeError();
+
+  // 运行时库的符号优先，找不到的再到进程中找
+  auto& jd = (*jit)->getMainJITDylib();
+  char prefix = (*jit)->getDataLayout().getGlobalPrefix();
+  auto lib = llvm::orc::DynamicLibrarySearchGenerator::Load(
+    rtlib.str().c_str(), prefix);
+  if (!lib)
+    return lib.takeError();
+  jd.addGenerator(std::move(*lib));
+  auto proc =
+    llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(prefix);
+  if (!proc)
+    return proc.takeError();
+  jd.addGenerator(std::move(*proc));
+
+  mod->setDataLayout((*jit)->getDataLayout());
+  llvm::orc::ThreadSafeModule tsm(std::move(mod),
+                                  llvm::orc::ThreadSafeContext(std::move(ctx)));
+  if (auto err = (*jit)->addIRModule(std::move(tsm)))
+    return std::move(err);
+
+  auto sym = (*jit)->lookup("main");
+  if (!sym)
+    return sym.takeError();
+
+  // 全局变量的构造函数登记在 llvm.global_ctors 中，由 initialize 调用
+  if (auto err = (*jit)->initialize(jd))
+    return std::move(err);
+  int ret = sym->toPtr<int (*)()>()();
+  if (auto err = (*jit)->deinitialize(jd))
+    return std::move(err);
+  return ret;
+}
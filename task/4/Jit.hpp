@@ -0,0 +1,18 @@
+#pragma once
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+
+/**
+ * @brief 在进程内用 ORC 的 LLJIT 运行 \p mod 的 main，返回它的返回值
+ *
+ * 外部符号先在 \p rtlib 指定的测试运行时库中查找，再在进程自身中查找（例如
+ * memset）。程序的标准输入输出就是本进程的标准输入输出。运行时库的计时器在
+ * 进程退出时才打印，调用者应当随后直接以返回值退出，这样输出与单独编译出的
+ * 可执行文件完全相同。
+ */
+llvm::Expected<int>
+run_jit(std::unique_ptr<llvm::Module> mod,
+        std::unique_ptr<llvm::LLVMContext> ctx,
+        llvm::StringRef rtlib);
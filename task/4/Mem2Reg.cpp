@@ -886,7 +886,7 @@ PromoteMemToReg(ArrayRef<AllocaInst*> Allocas, DominatorTree& DT)
 }
 
 static bool
-promoteMemoryToRegister(Function& F, DominatorTree& DT)
+promoteMemoryToRegister(Function& F, DominatorTree& DT, unsigned& NumPromoted)
 {
   std::vector<AllocaInst*> Allocas;
   BasicBlock& BB = F.getEntryBlock(); // Get the entry node for the function
@@ -905,6 +905,7 @@ promoteMemoryToRegister(Function& F, DominatorTree& DT)
     if (Allocas.empty())
       break;
 
+    NumPromoted += Allocas.size();
     PromoteMemToReg(Allocas, DT);
     Changed = true;
   }
@@ -919,14 +920,20 @@ Mem2Reg::run(llvm::Module& mod, llvm::ModuleAnalysisManager& mam)
   PassBuilder pb;
   pb.registerFunctionAnalyses(fam);
   bool flag = true;
+  unsigned promoted = 0, left = 0;
   for (Function& func : mod) {
     if (func.isDeclaration())
       continue;
     auto& DT = fam.getResult<DominatorTreeAnalysis>(func);
-    if (promoteMemoryToRegister(func, DT)) {
+    bool changed = promoteMemoryToRegister(func, DT, promoted);
+    for (auto& inst : instructions(func))
+      left += isa<AllocaInst>(inst);
+    if (changed) {
       flag = false;
     }
   }
+  mOut << "Mem2Reg running...\nTo promote " << promoted << " allocas, "
+       << left << " left\n";
   if (flag) {
     return PreservedAnalyses::all();
   }
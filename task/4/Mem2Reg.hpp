@@ -7,15 +7,23 @@
 #include <llvm/IR/Dominators.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/PassManager.h>
 #include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/raw_ostream.h>
 
 class Mem2Reg : public llvm::PassInfoMixin<Mem2Reg>
 {
 public:
-  Mem2Reg() {}
+  explicit Mem2Reg(llvm::raw_ostream& out)
+    : mOut(out)
+  {
+  }
 
   llvm::PreservedAnalyses run(llvm::Module& mod,
                               llvm::ModuleAnalysisManager& mam);
+
+private:
+  llvm::raw_ostream& mOut;
 };
@@ -0,0 +1,366 @@
+#include "SCCP.hpp"
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/Analysis/ConstantFolding.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Local.h>
+
+using namespace llvm;
+
+namespace {
+
+/// 格值：未定 < 常量 < 非常量
+struct LatticeVal
+{
+  enum Kind
+  {
+    kUnknown,
+    kConst,
+    kOverdefined,
+  } kind{ kUnknown };
+  ConstantInt* val{ nullptr };
+
+  static LatticeVal overdefined() { return { kOverdefined, nullptr }; }
+};
+
+/// 两个格值的交汇
+LatticeVal
+meet(LatticeVal a, LatticeVal b)
+{
+  if (a.kind == LatticeVal::kUnknown)
+    return b;
+  if (b.kind == LatticeVal::kUnknown)
+    return a;
+  if (a.kind == LatticeVal::kConst && b.kind == LatticeVal::kConst &&
+      a.val == b.val)
+    return a;
+  return LatticeVal::overdefined();
+}
+
+class Solver
+{
+public:
+  Solver(Function& func, const DenseMap<Value*, ConstantInt*>& readOnly)
+    : mFunc(func)
+    , mDl(func.getParent()->getDataLayout())
+    , mReadOnly(readOnly)
+  {
+  }
+
+  /// 传播到不动点
+  void solve();
+
+  /// 值的格值，只有整数类型的值才可能是常量
+  LatticeVal get(Value* val);
+
+  bool executable(BasicBlock* bb) const { return mLive.count(bb); }
+
+private:
+  Function& mFunc;
+  const DataLayout& mDl;
+  const DenseMap<Value*, ConstantInt*>& mReadOnly;
+
+  DenseMap<Instruction*, LatticeVal> mVals;
+  DenseSet<BasicBlock*> mLive;
+  DenseSet<std::pair<BasicBlock*, BasicBlock*>> mEdges;
+
+  std::vector<std::pair<BasicBlock*, BasicBlock*>> mCfgWork;
+  std::vector<Instruction*> mSsaWork;
+
+  /// 标记一条边可达，返回是否是新的
+  bool markEdge(BasicBlock* from, BasicBlock* to);
+
+  /// 把指令的格值提升到 \p val，有变化时把可达的使用者放进 SSA 工作表
+  void raise(Instruction* inst, LatticeVal val);
+
+  void propagate();
+
+  /**
+   * 条件一直未定的跳转（条件只依赖于未定的值）当作条件非常量处理，否则它
+   * 的出边都不可达，返回是否标记了新的边
+   */
+  bool resolveUnknownBranches();
+
+  void visit(Instruction* inst);
+  void visitPhi(PHINode* phi);
+  void visitTerminator(Instruction* term);
+};
+
+LatticeVal
+Solver::get(Value* val)
+{
+  if (!val->getType()->isIntegerTy())
+    return LatticeVal::overdefined();
+  if (auto c = dyn_cast<ConstantInt>(val))
+    return { LatticeVal::kConst, c };
+  if (auto inst = dyn_cast<Instruction>(val)) {
+    auto it = mVals.find(inst);
+    return it == mVals.end() ? LatticeVal() : it->second;
+  }
+  // 形参、undef 等
+  return LatticeVal::overdefined();
+}
+
+bool
+Solver::markEdge(BasicBlock* from, BasicBlock* to)
+{
+  if (!mEdges.insert({ from, to }).second)
+    return false;
+  mCfgWork.emplace_back(from, to);
+  return true;
+}
+
+void
+Solver::raise(Instruction* inst, LatticeVal val)
+{
+  auto cur = get(inst);
+  if (val.kind == LatticeVal::kUnknown ||
+      cur.kind == LatticeVal::kOverdefined)
+    return;
+  if (cur.kind == LatticeVal::kConst) {
+    if (val.kind == LatticeVal::kConst && val.val == cur.val)
+      return;
+    val = LatticeVal::overdefined();
+  }
+
+  mVals[inst] = val;
+  for (auto user : inst->users()) {
+    auto userInst = cast<Instruction>(user);
+    if (mLive.count(userInst->getParent()))
+      mSsaWork.push_back(userInst);
+  }
+}
+
+void
+Solver::solve()
+{
+  markEdge(nullptr, &mFunc.getEntryBlock());
+  do
+    propagate();
+  while (resolveUnknownBranches());
+}
+
+void
+Solver::propagate()
+{
+  while (!mCfgWork.empty() || !mSsaWork.empty()) {
+    // 先处理新的边，块中的指令第一次变为可达时全部访问一遍
+    while (!mCfgWork.empty()) {
+      auto to = mCfgWork.back().second;
+      mCfgWork.pop_back();
+      if (mLive.insert(to).second) {
+        for (auto& inst : *to)
+          visit(&inst);
+      } else {
+        for (auto& phi : to->phis())
+          visitPhi(&phi);
+      }
+    }
+
+    while (!mSsaWork.empty()) {
+      auto inst = mSsaWork.back();
+      mSsaWork.pop_back();
+      visit(inst);
+    }
+  }
+}
+
+bool
+Solver::resolveUnknownBranches()
+{
+  bool changed = false;
+  for (auto& bb : mFunc) {
+    if (!mLive.count(&bb))
+      continue;
+    auto term = bb.getTerminator();
+    Value* cond = nullptr;
+    if (auto br = dyn_cast<BranchInst>(term); br && br->isConditional())
+      cond = br->getCondition();
+    else if (auto sw = dyn_cast<SwitchInst>(term))
+      cond = sw->getCondition();
+    if (cond == nullptr || get(cond).kind != LatticeVal::kUnknown)
+      continue;
+    for (auto succ : successors(&bb))
+      changed |= markEdge(&bb, succ);
+  }
+  return changed;
+}
+
+void
+Solver::visit(Instruction* inst)
+{
+  if (auto phi = dyn_cast<PHINode>(inst))
+    return visitPhi(phi);
+  if (inst->isTerminator())
+    return visitTerminator(inst);
+  if (!inst->getType()->isIntegerTy())
+    return;
+
+  if (auto sel = dyn_cast<SelectInst>(inst)) {
+    auto cond = get(sel->getCondition());
+    if (cond.kind == LatticeVal::kConst)
+      raise(inst,
+            get(cond.val->isZero() ? sel->getFalseValue()
+                                   : sel->getTrueValue()));
+    else if (cond.kind == LatticeVal::kOverdefined)
+      raise(inst, meet(get(sel->getTrueValue()), get(sel->getFalseValue())));
+    return;
+  }
+
+  // 只读的全局变量总是初始值，其余的取数、调用等的结果都不是常量
+  if (auto load = dyn_cast<LoadInst>(inst)) {
+    auto it = mReadOnly.find(load->getPointerOperand());
+    if (it != mReadOnly.end() && !load->isVolatile() &&
+        load->getType() == it->second->getType())
+      return raise(inst, { LatticeVal::kConst, it->second });
+  }
+  if (!isa<BinaryOperator>(inst) && !isa<ICmpInst>(inst) &&
+      !isa<CastInst>(inst))
+    return raise(inst, LatticeVal::overdefined());
+
+  // 操作数中有非常量时结果是非常量，有未定的时结果仍未定
+  SmallVector<Constant*, 2> ops;
+  for (auto& op : inst->operands()) {
+    auto val = get(op);
+    if (val.kind == LatticeVal::kOverdefined)
+      return raise(inst, LatticeVal::overdefined());
+    if (val.kind == LatticeVal::kUnknown)
+      return;
+    ops.push_back(val.val);
+  }
+
+  // 除以零、移位过多等折叠为 poison 的运算保留原样，在运行时照常出错
+  Constant* folded;
+  if (auto cmp = dyn_cast<ICmpInst>(inst))
+    folded =
+      ConstantFoldCompareInstOperands(cmp->getPredicate(), ops[0], ops[1], mDl);
+  else if (auto cast = dyn_cast<CastInst>(inst))
+    folded =
+      ConstantFoldCastOperand(cast->getOpcode(), ops[0], cast->getType(), mDl);
+  else
+    folded =
+      ConstantFoldBinaryOpOperands(inst->getOpcode(), ops[0], ops[1], mDl);
+
+  if (auto c = dyn_cast_or_null<ConstantInt>(folded))
+    raise(inst, { LatticeVal::kConst, c });
+  else
+    raise(inst, LatticeVal::overdefined());
+}
+
+void
+Solver::visitPhi(PHINode* phi)
+{
+  if (!phi->getType()->isIntegerTy())
+    return;
+
+  // 只合并来自可达边的值
+  LatticeVal val;
+  for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
+    if (mEdges.count({ phi->getIncomingBlock(i), phi->getParent() }))
+      val = meet(val, get(phi->getIncomingValue(i)));
+  }
+  raise(phi, val);
+}
+
+void
+Solver::visitTerminator(Instruction* term)
+{
+  auto bb = term->getParent();
+
+  if (auto br = dyn_cast<BranchInst>(term); br && br->isConditional()) {
+    auto cond = get(br->getCondition());
+    if (cond.kind == LatticeVal::kConst)
+      markEdge(bb, br->getSuccessor(cond.val->isZero() ? 1 : 0));
+    else if (cond.kind == LatticeVal::kOverdefined) {
+      markEdge(bb, br->getSuccessor(0));
+      markEdge(bb, br->getSuccessor(1));
+    }
+    return;
+  }
+
+  if (auto sw = dyn_cast<SwitchInst>(term)) {
+    auto cond = get(sw->getCondition());
+    if (cond.kind == LatticeVal::kConst) {
+      markEdge(bb, sw->findCaseValue(cond.val)->getCaseSuccessor());
+      return;
+    }
+    if (cond.kind == LatticeVal::kUnknown)
+      return;
+  }
+
+  for (auto succ : successors(bb))
+    markEdge(bb, succ);
+}
+
+} // namespace
+
+PreservedAnalyses
+SCCP::run(Module& mod, ModuleAnalysisManager& mam)
+{
+  // 模块是完整的程序时，运行时库不会访问其中的全局变量，所以在模块里只被
+  // 直接读取的整数全局变量一直保持初始值
+  mReadOnly.clear();
+  for (auto& gvar : mod.globals()) {
+    if (!mWholeProgram || !gvar.hasDefinitiveInitializer())
+      continue;
+    auto init = dyn_cast<ConstantInt>(gvar.getInitializer());
+    if (init == nullptr)
+      continue;
+    bool readOnly = llvm::all_of(gvar.users(), [](User* user) {
+      return isa<LoadInst>(user);
+    });
+    if (readOnly)
+      mReadOnly[&gvar] = init;
+  }
+
+  unsigned replaced = 0, deadBlocks = 0;
+  for (auto& func : mod) {
+    if (!func.isDeclaration())
+      replaced += runOnFunction(func, deadBlocks);
+  }
+
+  mOut << "SCCP running...\nTo eliminate " << replaced
+       << " instructions and " << deadBlocks << " blocks\n";
+  return replaced || deadBlocks ? PreservedAnalyses::none()
+                                : PreservedAnalyses::all();
+}
+
+unsigned
+SCCP::runOnFunction(Function& func, unsigned& deadBlocks)
+{
+  Solver solver(func, mReadOnly);
+  solver.solve();
+
+  // 先把常量替换进所有可达块中的使用处，没有副作用的指令随即删除。跳转的
+  // 条件可能定义在布局靠后的块中，所以要全部替换完才能折叠跳转
+  unsigned replaced = 0;
+  std::vector<BasicBlock*> dead;
+  for (auto& bb : func) {
+    if (!solver.executable(&bb)) {
+      dead.push_back(&bb);
+      continue;
+    }
+    for (auto it = bb.begin(); it != bb.end();) {
+      auto inst = &*it++;
+      auto val = solver.get(inst);
+      if (val.kind != LatticeVal::kConst)
+        continue;
+      inst->replaceAllUsesWith(val.val);
+      if (isInstructionTriviallyDead(inst))
+        inst->eraseFromParent();
+      ++replaced;
+    }
+  }
+
+  // 条件已经替换为常量，改为无条件跳转，同时更新另一个后继中的 phi
+  for (auto& bb : func) {
+    if (solver.executable(&bb))
+      ConstantFoldTerminator(&bb);
+  }
+
+  // 可达的块不再跳到不可达的块，可以整体删除
+  DeleteDeadBlocks(dead);
+  deadBlocks += dead.size();
+  return replaced;
+}
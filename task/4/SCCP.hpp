@@ -0,0 +1,56 @@
+#pragma once
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Support/raw_ostream.h>
+
+/**
+ * @brief 稀疏条件常量传播
+ *
+ * 每个整数值在格上取未定、常量、非常量三者之一，只升不降。用两个工作表同时
+ * 推进：CFG 工作表放新变为可达的边，SSA 工作表放操作数的格值变化了的指令。
+ * phi 只合并来自可达边的值，条件跳转的条件为常量时只有一条出边可达，所以能
+ * 发现普通常量折叠发现不了的常量，例如循环中一直不变的变量。
+ *
+ * 模块是完整的程序时，其中从未被写入、也没有取地址传出去的整数全局变量，
+ * 读取它得到的总是初始值，也当作常量。
+ *
+ * 收敛后把常量值替换进所有使用处，条件为常量的跳转改为无条件跳转，删除不可
+ * 达的基本块。应当在 Mem2Reg 之后运行。
+ */
+class SCCP : public llvm::PassInfoMixin<SCCP>
+{
+public:
+  /// \p wholeProgram 为假时模块中可能缺少其他函数的函数体，不把全局变量当
+  /// 作常量
+  SCCP(llvm::raw_ostream& out, bool wholeProgram)
+    : mOut(out)
+    , mWholeProgram(wholeProgram)
+  {
+  }
+
+  llvm::PreservedAnalyses run(llvm::Module& mod,
+                              llvm::ModuleAnalysisManager& mam);
+
+  /// 两种模式的结果不同，流水线描述中要能区分
+  void printPipeline(
+    llvm::raw_ostream& os,
+    llvm::function_ref<llvm::StringRef(llvm::StringRef)> mapClassName2PassName)
+  {
+    os << mapClassName2PassName(name());
+    if (!mWholeProgram)
+      os << "<partial>";
+  }
+
+private:
+  llvm::raw_ostream& mOut;
+  bool mWholeProgram;
+
+  /// 只读的全局变量及其初始值
+  llvm::DenseMap<llvm::Value*, llvm::ConstantInt*> mReadOnly;
+
+  /// 返回替换掉的指令数，\p deadBlocks 累加删除的基本块数
+  unsigned runOnFunction(llvm::Function& func, unsigned& deadBlocks);
+};
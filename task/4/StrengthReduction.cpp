@@ -2,6 +2,86 @@
 
 using namespace llvm;
 
+namespace {
+
+/// 乘以常量至多改写为这么多条移位与加减，再多就不如一条乘法快
+constexpr unsigned kMulBudget = 3;
+
+/// 常量的一项 ±(x << shift)
+struct Term
+{
+  unsigned shift;
+  bool negative;
+};
+
+/**
+ * 常量的非相邻形式（NAF）：每一位取 -1、0、1，且没有两个相邻的非零位，非零
+ * 位数在所有带符号二进制表示中最少。第 N 位及更高的项乘以任何数都是 0，丢弃
+ */
+SmallVector<Term, 8>
+naf(const APInt& c)
+{
+  unsigned bits = c.getBitWidth();
+  auto rest = c.zext(bits + 1);
+  SmallVector<Term, 8> terms;
+  for (unsigned i = 0; i < bits && !rest.isZero(); ++i, rest.lshrInPlace(1)) {
+    if (!rest[0])
+      continue;
+    // 低两位为 11 时取 -1，把一串连续的 1 变为高位的一个进位
+    bool negative = rest[1];
+    if (negative)
+      ++rest;
+    else
+      --rest;
+    terms.push_back({ i, negative });
+  }
+  return terms;
+}
+
+/// 按 \p terms 展开 x * c 需要的指令数
+unsigned
+cost(ArrayRef<Term> terms)
+{
+  if (terms.empty())
+    return 0;
+  unsigned ret = terms.size() - 1;
+  for (auto& term : terms)
+    ret += term.shift != 0;
+  // 全部为负时第一项要从 0 减去
+  if (llvm::all_of(terms, [](const Term& term) { return term.negative; }))
+    ++ret;
+  return ret;
+}
+
+/// 把 \p mul 展开为移位与加减，代价超出预算时返回 nullptr
+Value*
+decompose(BinaryOperator* mul, Value* x, const APInt& c)
+{
+  auto terms = naf(c);
+  if (cost(terms) > kMulBudget)
+    return nullptr;
+  if (terms.empty())
+    return ConstantInt::get(mul->getType(), 0);
+
+  // 先放正的项，减少一次取负
+  std::stable_partition(terms.begin(), terms.end(), [](const Term& term) {
+    return !term.negative;
+  });
+
+  IRBuilder<> b(mul);
+  Value* acc = nullptr;
+  for (auto& term : terms) {
+    Value* val = term.shift ? b.CreateShl(x, term.shift) : x;
+    if (acc == nullptr)
+      acc = term.negative ? b.CreateNeg(val) : val;
+    else
+      acc = term.negative ? b.CreateSub(acc, val) : b.CreateAdd(acc, val);
+  }
+  return acc;
+}
+
+} // namespace
+
 PreservedAnalyses
 StrengthReduction::run(Module& mod, ModuleAnalysisManager& mam)
 {
@@ -9,53 +89,32 @@ StrengthReduction::run(Module& mod, ModuleAnalysisManager& mam)
 
   for (auto& func : mod) {
     for (auto& bb : func) {
-      std::vector<Instruction*> instToErase;
-      for (auto& inst : bb) {
-        if (auto binOp = dyn_cast<BinaryOperator>(&inst)) {
-          Value* lhs = binOp->getOperand(0);
-          Value* rhs = binOp->getOperand(1);
-          auto constLhs = dyn_cast<ConstantInt>(lhs);
-          auto constRhs = dyn_cast<ConstantInt>(rhs);
-          switch (binOp->getOpcode()) {
-            case Instruction::Mul: {
-              if (constLhs && constRhs) {
-                if (constLhs->getSExtValue() == 2) {
-                  binOp->replaceAllUsesWith(BinaryOperator::Create(Instruction::Shl, rhs, ConstantInt::getSigned(rhs->getType(), 1), "", &inst));
-                  instToErase.push_back(binOp);
-                  ++strengthReductionCount;
-                } else if (constRhs->getSExtValue() == 2) {
-                  binOp->replaceAllUsesWith(BinaryOperator::Create(Instruction::Shl, lhs, ConstantInt::getSigned(lhs->getType(), 1), "", &inst));
-                  instToErase.push_back(binOp);
-                  ++strengthReductionCount;
-                }
-              }
-              break;
-            }
-            case Instruction::SDiv: {
-              if (constRhs && constRhs->getSExtValue() == 2) {
-                binOp->replaceAllUsesWith(BinaryOperator::Create(Instruction::AShr, lhs, ConstantInt::getSigned(lhs->getType(), 1), "", &inst));
-                instToErase.push_back(binOp);
-                ++strengthReductionCount;
-              }
-              break;
-            }
-            case Instruction::UDiv: {
-              if (constRhs && constRhs->getSExtValue() == 2) {
-                binOp->replaceAllUsesWith(BinaryOperator::Create(Instruction::LShr, lhs, ConstantInt::getSigned(lhs->getType(), 1), "", &inst));
-                instToErase.push_back(binOp);
-                ++strengthReductionCount;
-              }
-              break;
-            }
-          }
+      for (auto it = bb.begin(); it != bb.end();) {
+        auto binOp = dyn_cast<BinaryOperator>(&*it++);
+        if (binOp == nullptr || binOp->getOpcode() != Instruction::Mul)
+          continue;
+
+        // 常量可能在任意一边，循环中归纳变量乘以常量也在这里一并改写
+        Value* x = binOp->getOperand(0);
+        auto c = dyn_cast<ConstantInt>(binOp->getOperand(1));
+        if (c == nullptr) {
+          c = dyn_cast<ConstantInt>(x);
+          x = binOp->getOperand(1);
+        }
+        if (c == nullptr)
+          continue;
+
+        if (auto result = decompose(binOp, x, c->getValue())) {
+          binOp->replaceAllUsesWith(result);
+          binOp->eraseFromParent();
+          ++strengthReductionCount;
         }
-      }
-      for (Instruction *inst : instToErase) {
-        inst->eraseFromParent();
       }
     }
   }
 
-  mOut << "StrengthReduction: " << strengthReductionCount << " instructions removed\n";
-  return PreservedAnalyses::all();
-}
\ No newline at end of file
+  mOut << "StrengthReduction: " << strengthReductionCount
+       << " instructions removed\n";
+  return strengthReductionCount ? PreservedAnalyses::none()
+                                : PreservedAnalyses::all();
+}
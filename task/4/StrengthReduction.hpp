@@ -4,6 +4,13 @@
 #include <llvm/IR/PassManager.h>
 #include <llvm/Support/raw_ostream.h>
 
+/**
+ * @brief 乘以常量的强度削减
+ *
+ * 把常量写成非相邻形式，x * c 展开为各项 ±(x << k) 之和，例如 x * 9 为
+ * (x << 3) + x，x * 15 为 (x << 4) - x。展开需要的移位与加减超过预算时保留
+ * 乘法。
+ */
 class StrengthReduction : public llvm::PassInfoMixin<StrengthReduction>
 {
 public:
@@ -16,5 +23,5 @@ public:
                               llvm::ModuleAnalysisManager& mam);
 
 private:
-    llvm::raw_ostream& mOut;
-};
\ No newline at end of file
+  llvm::raw_ostream& mOut;
+};
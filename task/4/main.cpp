@@ -1,84 +1,248 @@
 #include <iostream>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IRReader/IRReader.h>
-#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/raw_ostream.h>
+#include <optional>
 
-#include "AlgebraicIdentityPass.hpp"
-#include "ConstantFolding.hpp"
-#include "DeadInstEliminationPass.hpp"
-#include "Mem2Reg.hpp"
-#include "StaticCallCounter.hpp"
-#include "StaticCallCounterPrinter.hpp"
-#include "StrengthReduction.hpp"
+#include "Cache.hpp"
+#include "Codegen.hpp"
+#include "Incremental.hpp"
+#include "Jit.hpp"
+#include "opt.hpp"
 
-void
-opt(llvm::Module& mod)
-{
-  using namespace llvm;
-
-  // 定义分析pass的管理器
-  LoopAnalysisManager lam;
-  FunctionAnalysisManager fam;
-  CGSCCAnalysisManager cgam;
-  ModuleAnalysisManager mam;
-  ModulePassManager mpm;
-
-  // 注册分析pass的管理器
-  PassBuilder pb;
-  pb.registerModuleAnalyses(mam);
-  pb.registerCGSCCAnalyses(cgam);
-  pb.registerFunctionAnalyses(fam);
-  pb.registerLoopAnalyses(lam);
-  pb.crossRegisterProxies(lam, fam, cgam, mam);
-
-  // 添加分析pass到管理器中
-  mam.registerPass([]() { return StaticCallCounter(); });
-
-  // 添加优化pass到管理器中
-  mpm.addPass(StaticCallCounterPrinter(llvm::errs()));
-  mpm.addPass(ConstantFolding(llvm::errs()));
-  mpm.addPass(AlgebraicIdentityPass(llvm::errs()));
-  mpm.addPass(StrengthReduction(llvm::errs()));
-
-  mpm.addPass(Mem2Reg());
-
-  mpm.addPass(DeadInstEliminationPass(llvm::errs()));
-  // 运行优化pass
-  mpm.run(mod, mam);
-}
+namespace {
+
+llvm::cl::opt<std::string> gInputPath(llvm::cl::Positional,
+                                      llvm::cl::Required,
+                                      llvm::cl::desc("<input>"));
+
+llvm::cl::opt<std::string> gOutputPath(llvm::cl::Positional,
+                                       llvm::cl::Required,
+                                       llvm::cl::desc("<output>"));
+
+llvm::cl::opt<std::string> gCacheDir(
+  "cache-dir",
+  llvm::cl::desc("编译缓存目录，不指定时不使用缓存"),
+  llvm::cl::value_desc("dir"));
+
+llvm::cl::opt<std::uint64_t> gCacheSize(
+  "cache-size",
+  llvm::cl::desc("编译缓存的容量上限，单位为 MiB"),
+  llvm::cl::init(1024));
+
+llvm::cl::opt<bool> gCacheStats(
+  "cache-stats",
+  llvm::cl::desc("在标准错误输出中打印编译缓存的累计命中统计"));
+
+llvm::cl::opt<bool> gIncremental(
+  "incremental",
+  llvm::cl::desc("以函数为单位缓存优化结果，只重新优化改动过的函数，需要同时"
+                 "指定 -cache-dir"));
+
+llvm::cl::opt<bool> gEmitBc(
+  "emit-bc",
+  llvm::cl::desc("以位码格式输出 LLVM IR，输出文件以 .bc 结尾时自动开启"));
+
+llvm::cl::opt<bool> gNoOpt(
+  "no-opt",
+  llvm::cl::desc("不运行优化流水线，原样输出输入的 IR，可与 -run 一起用来运行"
+                 "已经优化过的结果"));
+
+llvm::cl::opt<bool> gRun(
+  "run",
+  llvm::cl::desc("写出结果后在进程内用 JIT 运行 main，以 main 的返回值退出，"
+                 "程序的输入输出即 task4 的标准输入输出"));
+
+llvm::cl::opt<std::string> gObjPath(
+  "obj",
+  llvm::cl::desc("把结果编译为本机的目标文件"),
+  llvm::cl::value_desc("path"));
+
+llvm::cl::opt<std::string> gExePath(
+  "exe",
+  llvm::cl::desc("把结果编译为本机的目标文件，再用系统的链接器与测试运行时库"
+                 "链接为可执行文件"),
+  llvm::cl::value_desc("path"));
+
+llvm::cl::opt<unsigned> gCodegenOpt(
+  "codegen-opt",
+  llvm::cl::desc("-obj、-exe 生成目标代码时后端的优化级别，0 到 3"),
+  llvm::cl::init(2));
+
+llvm::cl::opt<std::string> gRtlib(
+  "rtlib",
+  llvm::cl::desc("测试运行时库，-run 时加载，-exe 时链接"),
+  llvm::cl::value_desc("path"),
+  llvm::cl::init(TASK4_RTLIB));
+
+} // namespace
 
 int
 main(int argc, char** argv)
 {
-  if (argc != 3) {
-    std::cout << "Usage: " << argv[0] << " <input> <output>\n";
-    return -1;
+  llvm::cl::ParseCommandLineOptions(argc, argv);
+
+  auto inFileOrErr = llvm::MemoryBuffer::getFile(gInputPath);
+  if (!inFileOrErr) {
+    std::cout << "Error: unable to open input file: " << gInputPath << '\n';
+    return -2;
+  }
+  auto inFile = std::move(inFileOrErr.get());
+
+  std::error_code ec;
+  llvm::StringRef outPath(gOutputPath);
+  llvm::raw_fd_ostream outFile(outPath, ec);
+  if (ec) {
+    std::cout << "Error: unable to open output file: " << gOutputPath << '\n';
+    return -3;
   }
 
-  llvm::LLVMContext ctx;
+  // 输入是文本还是位码由 parseIR 根据文件头自动判断
+  bool bitcode = gEmitBc || outPath.ends_with(".bc");
+
+  // 增量编译时复用的函数在优化时只剩声明，各个函数的结果又要能单独复用，
+  // 所以不能做依赖于其他函数内容的假定
+  Optimizer optimizer(llvm::errs(), !(gIncremental && !gCacheDir.empty()));
+  auto pipeline = gNoOpt ? std::string() : optimizer.pipeline();
+
+  // 流水线描述也是键的一部分，调整 pass 的组合后不会误用旧的结果。输出的
+  // ModuleID 不取输入路径，所以不同目录中的相同输入可以共享缓存项
+  std::optional<Cache> cache;
+  std::string cacheKey;
+  if (!gCacheDir.empty()) {
+    cache.emplace(gCacheDir, gCacheSize << 20);
+    cacheKey = Cache::key(argv[0],
+                          { "task4",
+                            pipeline,
+                            bitcode ? "bc" : "ll",
+                            inFile->getBuffer() });
+    // 命中时没有模块可以运行或生成目标代码，-run、-obj、-exe 时只写入缓存、
+    // 不查找
+    bool needModule = gRun || !gObjPath.empty() || !gExePath.empty();
+    if (auto hit = needModule ? nullptr : cache->lookup(cacheKey)) {
+      outFile << hit->getBuffer();
+      if (gCacheStats)
+        cache->print_stats(llvm::errs());
+      return 0;
+    }
+  }
+
+  // -run 时上下文连同模块一起交给 JIT
+  auto ctx = std::make_unique<llvm::LLVMContext>();
 
   llvm::SMDiagnostic err;
-  auto mod = llvm::parseIRFile(argv[1], err, ctx);
+  auto mod = llvm::parseIR(inFile->getMemBufferRef(), err, *ctx);
   if (!mod) {
-    std::cout << "Error: unable to parse input file: " << argv[1] << '\n';
+    std::cout << "Error: unable to parse input file: " << gInputPath << '\n';
     err.print(argv[0], llvm::errs());
     return -2;
   }
+  // ModuleID 和输入中没有写明的 source_filename 默认都是输入路径，改为实验三
+  // 输出中的“-”或写明的源文件名，使输出只由输入内容决定
+  if (mod->getSourceFileName() == gInputPath)
+    mod->setSourceFileName("-");
+  mod->setModuleIdentifier(mod->getSourceFileName());
 
-  std::error_code ec;
-  llvm::StringRef outPath(argv[2]);
-  llvm::raw_fd_ostream outFile(outPath, ec);
-  if (ec) {
-    std::cout << "Error: unable to open output file: " << argv[2] << '\n';
-    return -3;
+  // 增量编译时，指纹没有变化的函数删去函数体，不参与优化，稍后从缓存链接回来
+  std::optional<Incremental> inc;
+  std::vector<std::pair<llvm::Function*, std::string>> rebuilt;
+  if (cache && gIncremental && !optimizer.wholeProgram()) {
+    inc.emplace(*cache);
+    for (auto& func : *mod) {
+      std::string fp;
+      if (!Incremental::fingerprint(func, fp))
+        continue;
+      auto key = Cache::key(argv[0], { "task4-func", pipeline, fp });
+      if (inc->lookup(key))
+        func.deleteBody();
+      else
+        rebuilt.emplace_back(&func, std::move(key));
+    }
   }
 
-  opt(*mod); // IR的优化发生在这里
+  if (!gNoOpt)
+    optimizer(*mod); // IR的优化发生在这里
 
-  mod->print(outFile, nullptr, false, true);
+  if (inc && !inc->link(*mod)) {
+    std::cout << "Error: corrupted function cache in: " << gCacheDir << '\n';
+    return 4;
+  }
+
+  auto write = [&](llvm::raw_ostream& os) {
+    if (bitcode)
+      llvm::WriteBitcodeToFile(*mod, os);
+    else
+      mod->print(os, nullptr, false, true);
+  };
+  std::string text;
+  if (cache) {
+    // raw_string_ostream 默认不带缓冲，打印时的大量零碎写入会很慢
+    llvm::raw_string_ostream os(text);
+    os.SetBuffered();
+    write(os);
+    outFile << os.str();
+  } else
+    write(outFile);
   if (llvm::verifyModule(*mod, &llvm::outs()))
     return 3;
+
+  if (cache) {
+    for (auto&& [func, key] : rebuilt)
+      inc->store(*func, key);
+    cache->store(cacheKey, text);
+    if (inc && gCacheStats)
+      inc->print_stats(llvm::errs());
+    if (gCacheStats)
+      cache->print_stats(llvm::errs());
+  }
+
+  // 目标代码生成会改动模块的目标三元组和数据布局，放在写出 IR 之后
+  if (!gObjPath.empty() || !gExePath.empty()) {
+    if (gCodegenOpt > 3) {
+      std::cout << "Error: invalid codegen optimization level: "
+                << gCodegenOpt << '\n';
+      return -1;
+    }
+    auto level = llvm::CodeGenOpt::Level(unsigned(gCodegenOpt));
+
+    // 只要可执行文件时，目标文件放在临时文件里
+    llvm::SmallString<128> objPath(gObjPath);
+    bool tmpObj = objPath.empty();
+    if (tmpObj) {
+      if (auto ec = llvm::sys::fs::createTemporaryFile("task4", "o", objPath)) {
+        std::cout << "Error: unable to create temporary file: "
+                  << ec.message() << '\n';
+        return -3;
+      }
+    }
+
+    auto ret = emit_object(*mod, level, objPath);
+    if (!ret && !gExePath.empty())
+      ret = link_executable(objPath, gRtlib, gExePath);
+    if (tmpObj)
+      llvm::sys::fs::remove(objPath);
+    if (ret) {
+      std::cout << "Error: unable to generate native code: "
+                << llvm::toString(std::move(ret)) << '\n';
+      return 6;
+    }
+  }
+
+  if (gRun) {
+    outFile.close();
+    auto ret = run_jit(std::move(mod), std::move(ctx), gRtlib);
+    if (!ret) {
+      std::cout << "Error: unable to run the module: "
+                << llvm::toString(ret.takeError()) << '\n';
+      return 5;
+    }
+    return *ret;
+  }
 }
@@ -0,0 +1,67 @@
+#include "opt.hpp"
+
+#include "ADCE.hpp"
+#include "AlgebraicIdentityPass.hpp"
+#include "DivisionByConstant.hpp"
+#include "GVN.hpp"
+#include "Mem2Reg.hpp"
+#include "SCCP.hpp"
+#include "StaticCallCounter.hpp"
+#include "StaticCallCounterPrinter.hpp"
+#include "StrengthReduction.hpp"
+
+Optimizer::Optimizer(llvm::raw_ostream& out, bool wholeProgram)
+  : mWholeProgram(wholeProgram)
+{
+  // 注册分析pass的管理器
+  mPb.registerModuleAnalyses(mMam);
+  mPb.registerCGSCCAnalyses(mCgam);
+  mPb.registerFunctionAnalyses(mFam);
+  mPb.registerLoopAnalyses(mLam);
+  mPb.crossRegisterProxies(mLam, mFam, mCgam, mMam);
+
+  // 添加分析pass到管理器中
+  mMam.registerPass([]() { return StaticCallCounter(); });
+
+  // 添加优化pass到管理器中
+  mMpm.addPass(StaticCallCounterPrinter(out));
+
+  // 常量传播要在 SSA 形式上沿 phi 进行，其余的窥孔优化也能看到传播的结果
+  mMpm.addPass(Mem2Reg(out));
+  mMpm.addPass(SCCP(out, wholeProgram));
+  mMpm.addPass(AlgebraicIdentityPass(out));
+  mMpm.addPass(DivisionByConstant(out));
+  mMpm.addPass(StrengthReduction(out));
+  mMpm.addPass(GVN(out, wholeProgram));
+
+  mMpm.addPass(ADCE(out, wholeProgram));
+}
+
+void
+Optimizer::operator()(llvm::Module& mod)
+{
+  // 运行优化pass
+  mMpm.run(mod, mMam);
+
+  // 分析结果以 IR 对象的地址为键，下一个模块可能恰好复用同样的地址
+  mLam.clear();
+  mFam.clear();
+  mCgam.clear();
+  mMam.clear();
+}
+
+std::string
+Optimizer::pipeline()
+{
+  std::string ret;
+  llvm::raw_string_ostream os(ret);
+  mMpm.printPipeline(os, [](llvm::StringRef name) { return name; });
+  return ret;
+}
+
+void
+opt(llvm::Module& mod)
+{
+  Optimizer optimizer;
+  optimizer(mod);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/raw_ostream.h>
+
+/**
+ * @brief 实验四的优化流水线
+ *
+ * PassBuilder 与各级分析管理器的构造和注册开销不小，批量编译时每个工作线程
+ * 持有一个实例，在多个模块之间复用。每次运行结束后会清空分析结果，所以前后
+ * 两个模块之间不会互相影响。
+ */
+class Optimizer
+{
+public:
+  /**
+   * \p out 用于输出各个 pass 的信息。\p wholeProgram 为假时模块可能只是程
+   * 序的一部分，例如增量编译时复用的函数只剩声明，各个 pass 不再假定能看到
+   * 全部函数体，每个函数的结果只取决于它自己和它引用的声明。
+   */
+  Optimizer(llvm::raw_ostream& out = llvm::errs(), bool wholeProgram = true);
+
+  void operator()(llvm::Module& mod);
+
+  /// 流水线的文本描述，编译缓存用它区分不同的优化配置
+  std::string pipeline();
+
+  /// 是否假定模块是完整的程序，为真时不能删去任何函数的函数体
+  bool wholeProgram() const { return mWholeProgram; }
+
+private:
+  bool mWholeProgram;
+
+  // 分析管理器之间互相引用，必须按这个顺序声明才能按正确的顺序析构
+  llvm::LoopAnalysisManager mLam;
+  llvm::FunctionAnalysisManager mFam;
+  llvm::CGSCCAnalysisManager mCgam;
+  llvm::ModuleAnalysisManager mMam;
+  llvm::PassBuilder mPb;
+  llvm::ModulePassManager mMpm;
+};
+
+/// 在 \p mod 上运行一次优化流水线，task4 与编译驱动共用。
+void
+opt(llvm::Module& mod);
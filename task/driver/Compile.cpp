@@ -0,0 +1,224 @@
+#include "Compile.hpp"
+#include "Asg2Bin.hpp"
+#include "Asg2Json.hpp"
+#include "Ast2Asg.hpp"
+#include "EmitIR.hpp"
+#include "LexerAdapter.hpp"
+#include "Typing.hpp"
+#include <chrono>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+namespace {
+
+/// 阶段计时器，析构时向 \p log 打印从构造开始经过的时间。
+struct StageTimer
+{
+  using Clock = std::chrono::steady_clock;
+
+  const CompileOptions& mOpts;
+  llvm::raw_ostream& mLog;
+  const char* mName;
+  Clock::time_point mStart;
+
+  StageTimer(const CompileOptions& opts, llvm::raw_ostream& log, const char* name)
+    : mOpts(opts)
+    , mLog(log)
+    , mName(name)
+    , mStart(Clock::now())
+  {
+  }
+
+  ~StageTimer()
+  {
+    if (!mOpts.mTimeStages)
+      return;
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - mStart)
+                .count();
+    mLog << "阶段 " << mName << " 耗时 " << us << "us\n";
+  }
+};
+
+/// 把 ANTLR 的语法错误写到日志里，而不是直接打印到标准错误输出。
+class ErrorListener : public antlr4::BaseErrorListener
+{
+public:
+  llvm::StringRef mName;
+  llvm::raw_ostream& mLog;
+
+  ErrorListener(llvm::StringRef name, llvm::raw_ostream& log)
+    : mName(name)
+    , mLog(log)
+  {
+  }
+
+  void syntaxError(antlr4::Recognizer* recognizer,
+                   antlr4::Token* offendingSymbol,
+                   std::size_t line,
+                   std::size_t charPositionInLine,
+                   const std::string& msg,
+                   std::exception_ptr e) override
+  {
+    mLog << mName << ':' << line << ':' << charPositionInLine + 1 << ": "
+         << msg << '\n';
+  }
+};
+
+/// 打开转储文件，失败时打印错误信息并返回空。
+std::unique_ptr<llvm::raw_fd_ostream>
+open_dump(const std::string& path, llvm::raw_ostream& log)
+{
+  if (path.empty())
+    return nullptr;
+  std::error_code ec;
+  auto ret = std::make_unique<llvm::raw_fd_ostream>(path, ec);
+  if (ec) {
+    log << "Error: unable to open dump file: " << path << '\n';
+    return nullptr;
+  }
+  return ret;
+}
+
+/// 输出 ASG，\p bin 为真时写出二进制格式，否则写出 JSON。
+void
+write_asg(asg::TranslationUnit* tu, bool bin, llvm::raw_ostream& os)
+{
+  if (bin) {
+    asg::Asg2Bin asg2bin;
+    asg2bin(tu, os);
+  } else {
+    asg::Asg2Json asg2json;
+    os << llvm::json::Value(asg2json(tu)) << '\n';
+  }
+}
+
+} // namespace
+
+int
+compile(llvm::StringRef source,
+        llvm::StringRef name,
+        const CompileOptions& opts,
+        llvm::raw_ostream& out,
+        llvm::LLVMContext& ctx,
+        Optimizer& optimizer,
+        llvm::raw_ostream& log)
+{
+  // 词法分析与语法分析，记号流在两者之间按需流动
+  antlr4::ANTLRInputStream input(std::string_view(source.data(), source.size()));
+  input.name = name.str();
+  ErrorListener errorListener(name, log);
+
+  SYsULexer lexer(&input);
+  lexer.removeErrorListeners();
+  lexer.addErrorListener(&errorListener);
+  LexerAdapter adapter(lexer);
+
+  antlr4::CommonTokenStream tokens(&adapter);
+  SYsUParser parser(&tokens);
+  parser.removeErrorListeners();
+  parser.addErrorListener(&errorListener);
+  adapter.map_to(parser.getVocabulary());
+
+  if (opts.mEmit == Stage::kTokens) {
+    adapter.mDump = &out;
+    tokens.fill();
+    return 0;
+  }
+
+  auto tokensDump = open_dump(opts.mDumpTokens, log);
+  adapter.mDump = tokensDump.get();
+
+  SYsUParser::CompilationUnitContext* ast;
+  {
+    StageTimer timer(opts, log, "parse");
+    ast = parser.compilationUnit();
+  }
+  if (parser.getNumberOfSyntaxErrors())
+    return 1;
+
+  // 构建 ASG 并推导类型
+  Obj::Mgr mgr;
+  asg::TranslationUnit* asg;
+  {
+    StageTimer timer(opts, log, "ast2asg");
+    asg::Ast2Asg ast2asg(mgr);
+    asg = ast2asg(ast->translationUnit());
+  }
+  mgr.mRoot = asg;
+  mgr.gc();
+
+  {
+    StageTimer timer(opts, log, "typing");
+    asg::Typing inferType(mgr);
+    inferType(asg);
+  }
+  mgr.gc();
+
+  if (auto dump = open_dump(opts.mDumpAsg, log))
+    write_asg(asg, llvm::StringRef(opts.mDumpAsg).ends_with(".asg"), *dump);
+  if (opts.mEmit == Stage::kAsg || opts.mEmit == Stage::kAsgBin) {
+    write_asg(asg, opts.mEmit == Stage::kAsgBin, out);
+    return 0;
+  }
+
+  // 生成 LLVM IR
+  EmitIR emitIR(mgr, ctx, name);
+  llvm::Module* mod;
+  {
+    StageTimer timer(opts, log, "emit");
+    mod = &emitIR(asg);
+  }
+  mgr.gc();
+
+  if (auto dump = open_dump(opts.mDumpIr, log))
+    mod->print(*dump, nullptr, false, true);
+  if (llvm::verifyModule(*mod, &log))
+    return 3;
+
+  // 优化
+  if (opts.mEmit == Stage::kOpt) {
+    StageTimer timer(opts, log, "opt");
+    optimizer(*mod);
+  }
+
+  {
+    StageTimer timer(opts, log, "print");
+    mod->print(out, nullptr, false, true);
+  }
+  if (llvm::verifyModule(*mod, &log))
+    return 3;
+
+  return 0;
+}
+
+int
+compile_file(const std::string& inPath,
+             const std::string& outPath,
+             const CompileOptions& opts,
+             llvm::LLVMContext& ctx,
+             Optimizer& optimizer,
+             llvm::raw_ostream& log)
+{
+  auto inFileOrErr = llvm::MemoryBuffer::getFile(
+    inPath, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+  if (!inFileOrErr) {
+    log << "Error: unable to open input file: " << inPath << '\n';
+    return -2;
+  }
+
+  std::error_code ec;
+  llvm::raw_fd_ostream outFile(outPath, ec);
+  if (ec) {
+    log << "Error: unable to open output file: " << outPath << '\n';
+    return -3;
+  }
+
+  return compile((*inFileOrErr)->getBuffer(),
+                 inPath,
+                 opts,
+                 outFile,
+                 ctx,
+                 optimizer,
+                 log);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Stage.hpp"
+#include "opt.hpp"
+#include <llvm/IR/LLVMContext.h>
+
+struct CompileOptions
+{
+  Stage mEmit{ Stage::kOpt };
+
+  /// 中间结果的转储路径，为空表示不转储
+  std::string mDumpTokens, mDumpAsg, mDumpIr;
+
+  /// 是否在日志中打印各阶段的耗时
+  bool mTimeStages{ false };
+};
+
+/**
+ * @brief 编译一段预处理后的源代码
+ *
+ * 在同一个进程内依次运行词法分析、语法分析、ASG 构建与类型检查、IR 生成和
+ * 优化，各阶段之间直接传递内存中的数据结构，运行到 opts.mEmit 指定的阶段后
+ * 把结果写到 \p out。
+ *
+ * \p ctx 与 \p optimizer 由调用者持有，可以在多次编译之间复用；所有诊断信息
+ * （包括语法错误）都写到 \p log。返回值即单文件模式下的进程返回码。
+ */
+int
+compile(llvm::StringRef source,
+        llvm::StringRef name,
+        const CompileOptions& opts,
+        llvm::raw_ostream& out,
+        llvm::LLVMContext& ctx,
+        Optimizer& optimizer,
+        llvm::raw_ostream& log);
+
+/// 编译 \p inPath 到 \p outPath，打开文件失败时分别返回 -2 与 -3。
+int
+compile_file(const std::string& inPath,
+             const std::string& outPath,
+             const CompileOptions& opts,
+             llvm::LLVMContext& ctx,
+             Optimizer& optimizer,
+             llvm::raw_ostream& log);
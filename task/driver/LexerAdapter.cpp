@@ -0,0 +1,59 @@
+#include "LexerAdapter.hpp"
+#include <unordered_map>
+
+void
+LexerAdapter::map_to(const antlr4::dfa::Vocabulary& vocab)
+{
+  // 语法分析器的符号名到编号
+  std::unordered_map<std::string, std::size_t> names;
+  for (std::size_t i = 0; i <= vocab.getMaxTokenType(); ++i) {
+    // 4.13 的 getSymbolicName 返回 string_view，unordered_map 不支持异构查找
+    std::string name(vocab.getSymbolicName(i));
+    if (!name.empty())
+      names.emplace(std::move(name), i);
+  }
+
+  auto& lexVocab = mLexer.getVocabulary();
+  mTypeMap.assign(lexVocab.getMaxTokenType() + 1,
+                  antlr4::Token::INVALID_TYPE);
+  for (std::size_t i = 0; i < mTypeMap.size(); ++i) {
+    std::string name(lexVocab.getSymbolicName(i));
+    if (name == "LineAfterPreprocessing" || name == "Whitespace" ||
+        name == "Newline")
+      mTypeMap[i] = kSkip;
+    else if (auto iter = names.find(name); iter != names.end())
+      mTypeMap[i] = iter->second;
+    // 语法分析器不认识的记号保持 INVALID_TYPE，交由语法分析器报错
+  }
+}
+
+std::unique_ptr<antlr4::Token>
+LexerAdapter::nextToken()
+{
+  while (true) {
+    auto tok = mLexer.nextToken();
+    auto type = tok->getType();
+
+    std::size_t mapped = antlr4::Token::EOF;
+    if (type != antlr4::Token::EOF) {
+      mapped = type < mTypeMap.size() ? mTypeMap[type]
+                                      : antlr4::Token::INVALID_TYPE;
+      if (mapped == kSkip)
+        continue;
+    }
+
+    if (mDump) {
+      if (type == antlr4::Token::EOF)
+        *mDump << "EOF ''";
+      else
+        *mDump << mLexer.getVocabulary().getSymbolicName(type) << " '"
+               << tok->getText() << '\'';
+      *mDump << " Loc=<" << tok->getLine() << ':'
+             << tok->getCharPositionInLine() + 1 << ">\n";
+    }
+
+    if (type != antlr4::Token::EOF)
+      static_cast<antlr4::CommonToken*>(tok.get())->setType(mapped);
+    return tok;
+  }
+}
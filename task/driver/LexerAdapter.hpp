@@ -0,0 +1,58 @@
+#pragma once
+
+#include "SYsULexer.h"
+#include <llvm/Support/raw_ostream.h>
+
+/**
+ * @brief 把实验一的词法分析器接到实验二的语法分析器上
+ *
+ * 实验一的 ANTLR 词法分析器与实验二语法分析器所用的 SYsULexer.tokens 虽然
+ * 符号名相同，但编号不同，而且前者会产生空白、换行和预处理行记号。这个适配
+ * 器按符号名把记号类型翻译为语法分析器的编号，并丢弃语法分析器不需要的记号，
+ * 使两者可以在同一个进程内直接衔接，不再经过文本形式的记号流。
+ */
+class LexerAdapter : public antlr4::TokenSource
+{
+public:
+  SYsULexer& mLexer;
+
+  /// 若不为空，则把交给语法分析器的每个记号按“符号名 '文本' Loc=<行:列>”
+  /// 的格式转储到这里。
+  llvm::raw_ostream* mDump{ nullptr };
+
+  LexerAdapter(SYsULexer& lexer)
+    : mLexer(lexer)
+  {
+  }
+
+  /// 建立从词法分析器编号到语法分析器编号 \p vocab 的映射，必须在取第一个
+  /// 记号之前调用。
+  void map_to(const antlr4::dfa::Vocabulary& vocab);
+
+  std::unique_ptr<antlr4::Token> nextToken() override;
+
+  std::size_t getLine() const override { return mLexer.getLine(); }
+
+  std::size_t getCharPositionInLine() override
+  {
+    return mLexer.getCharPositionInLine();
+  }
+
+  antlr4::CharStream* getInputStream() override
+  {
+    return mLexer.getInputStream();
+  }
+
+  std::string getSourceName() override { return mLexer.getSourceName(); }
+
+  antlr4::TokenFactory<antlr4::CommonToken>* getTokenFactory() override
+  {
+    return mLexer.getTokenFactory();
+  }
+
+private:
+  /// 需要丢弃的记号在映射表中的值
+  static constexpr std::size_t kSkip = std::size_t(-1);
+
+  std::vector<std::size_t> mTypeMap;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Stage.hpp"
+#include <cstdint>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief 编译服务器与客户端之间的通信协议
+ *
+ * 两端在同一台机器上，通过 Unix 域套接字通信，每个连接只处理一个请求。整数
+ * 按本机字节序传输，字符串为“4 字节长度 + 内容”。本文件不依赖 LLVM，客户端
+ * 只需要它和 Stage.hpp。
+ */
+namespace proto {
+
+/// 不是编译阶段，而是让服务器退出
+constexpr std::uint8_t kShutdown = 0xff;
+
+/// 请求中字符串长度的上限，超过时视为格式错误，服务器不会为其分配内存
+constexpr std::uint32_t kMaxRequestStr = 8u << 20;
+
+struct Request
+{
+  std::uint8_t mStage{ std::uint8_t(Stage::kOpt) };
+  bool mTimeStages{ false };
+  bool mHasSource{ false }; /// 为假时由服务器从 mPath 读取源代码
+  std::string mPath;
+  std::string mSource;
+};
+
+struct Response
+{
+  std::int32_t mRet{ 0 };
+  std::string mOutput;
+  std::string mLog;
+};
+
+inline bool
+write_all(int fd, const void* data, std::size_t size)
+{
+  auto p = static_cast<const char*>(data);
+  while (size) {
+    // 对端提前关闭时不要因为 SIGPIPE 而退出
+    auto n = send(fd, p, size, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    p += n, size -= n;
+  }
+  return true;
+}
+
+inline bool
+read_all(int fd, void* data, std::size_t size)
+{
+  auto p = static_cast<char*>(data);
+  while (size) {
+    auto n = read(fd, p, size);
+    if (n <= 0)
+      return false;
+    p += n, size -= n;
+  }
+  return true;
+}
+
+template<typename T>
+bool
+write_pod(int fd, const T& v)
+{
+  return write_all(fd, &v, sizeof(v));
+}
+
+template<typename T>
+bool
+read_pod(int fd, T& v)
+{
+  return read_all(fd, &v, sizeof(v));
+}
+
+inline bool
+write_str(int fd, const std::string& s)
+{
+  return write_pod(fd, std::uint32_t(s.size())) &&
+         write_all(fd, s.data(), s.size());
+}
+
+inline bool
+read_str(int fd, std::string& s, std::uint32_t maxSize = UINT32_MAX)
+{
+  std::uint32_t size;
+  if (!read_pod(fd, size) || size > maxSize)
+    return false;
+  s.resize(size);
+  return read_all(fd, s.data(), size);
+}
+
+inline bool
+write_request(int fd, const Request& req)
+{
+  return write_pod(fd, req.mStage) && write_pod(fd, req.mTimeStages) &&
+         write_pod(fd, req.mHasSource) && write_str(fd, req.mPath) &&
+         (!req.mHasSource || write_str(fd, req.mSource));
+}
+
+inline bool
+read_request(int fd, Request& req)
+{
+  return read_pod(fd, req.mStage) && read_pod(fd, req.mTimeStages) &&
+         read_pod(fd, req.mHasSource) &&
+         read_str(fd, req.mPath, kMaxRequestStr) &&
+         (!req.mHasSource || read_str(fd, req.mSource, kMaxRequestStr));
+}
+
+inline bool
+write_response(int fd, const Response& res)
+{
+  return write_pod(fd, res.mRet) && write_str(fd, res.mOutput) &&
+         write_str(fd, res.mLog);
+}
+
+inline bool
+read_response(int fd, Response& res)
+{
+  return read_pod(fd, res.mRet) && read_str(fd, res.mOutput) &&
+         read_str(fd, res.mLog);
+}
+
+} // namespace proto
@@ -0,0 +1,128 @@
+#include "Server.hpp"
+#include "Compile.hpp"
+#include "Protocol.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <llvm/Support/MemoryBuffer.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+
+namespace {
+
+/// 已接受的连接上读写的超时，停在请求中途的客户端不会一直占住工作线程
+constexpr timeval kIoTimeout{ 10, 0 };
+
+proto::Response
+handle(const proto::Request& req,
+       llvm::LLVMContext& ctx,
+       Optimizer& optimizer,
+       llvm::raw_ostream& log)
+{
+  proto::Response res;
+  if (req.mStage >= std::size(kStageNames)) {
+    log << "Error: invalid stage: " << unsigned(req.mStage) << '\n';
+    res.mRet = -1;
+    return res;
+  }
+
+  CompileOptions opts;
+  opts.mEmit = Stage(req.mStage);
+  opts.mTimeStages = req.mTimeStages;
+  llvm::raw_string_ostream out(res.mOutput);
+
+  if (req.mHasSource) {
+    res.mRet =
+      compile(req.mSource, req.mPath, opts, out, ctx, optimizer, log);
+    return res;
+  }
+
+  auto inFileOrErr = llvm::MemoryBuffer::getFile(
+    req.mPath, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+  if (!inFileOrErr) {
+    log << "Error: unable to open input file: " << req.mPath << '\n';
+    res.mRet = -2;
+    return res;
+  }
+  res.mRet = compile(
+    (*inFileOrErr)->getBuffer(), req.mPath, opts, out, ctx, optimizer, log);
+  return res;
+}
+
+} // namespace
+
+int
+serve(const std::string& path, unsigned nThreads)
+{
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    llvm::errs() << "Error: socket path too long: " << path << '\n';
+    return -1;
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    llvm::errs() << "Error: unable to create socket\n";
+    return -2;
+  }
+
+  // 清理上次异常退出时留下的套接字文件
+  unlink(path.c_str());
+  if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      listen(listenFd, SOMAXCONN) < 0) {
+    llvm::errs() << "Error: unable to listen on socket: " << path << '\n';
+    close(listenFd);
+    return -2;
+  }
+
+  std::atomic<bool> stop{ false };
+
+  auto worker = [&]() {
+    // 每个工作线程独占一个 LLVMContext 和一条优化流水线，在请求之间复用
+    std::string logBuf;
+    llvm::raw_string_ostream log(logBuf);
+    llvm::LLVMContext ctx;
+    Optimizer optimizer(log);
+
+    while (!stop) {
+      int fd = accept(listenFd, nullptr, nullptr);
+      if (fd < 0) {
+        if (errno == EINTR)
+          continue;
+        break; // 监听套接字已被关闭
+      }
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &kIoTimeout, sizeof(kIoTimeout));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &kIoTimeout, sizeof(kIoTimeout));
+
+      // 读取失败、超时或格式错误时直接关闭连接
+      proto::Request req;
+      if (proto::read_request(fd, req)) {
+        if (req.mStage == proto::kShutdown) {
+          stop = true;
+          // 唤醒阻塞在 accept 上的其他工作线程
+          shutdown(listenFd, SHUT_RDWR);
+          proto::write_response(fd, {});
+        } else {
+          auto res = handle(req, ctx, optimizer, log);
+          res.mLog = logBuf;
+          logBuf.clear();
+          proto::write_response(fd, res);
+        }
+      }
+      close(fd);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < std::max(1u, nThreads); ++i)
+    threads.emplace_back(worker);
+  for (auto& i : threads)
+    i.join();
+
+  close(listenFd);
+  unlink(path.c_str());
+  return 0;
+}
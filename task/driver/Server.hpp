@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+/**
+ * @brief 编译服务器
+ *
+ * 在 \p path 上监听 Unix 域套接字，用 \p nThreads 个工作线程处理编译请求。
+ * 每个工作线程持有自己的 LLVMContext 和 Optimizer，在请求之间复用，从而省去
+ * 每次启动进程、初始化 LLVM 与构建 pass 流水线的开销。收到退出请求后返回 0，
+ * 无法监听时返回非零值。
+ */
+int
+serve(const std::string& path, unsigned nThreads);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+/// 编译的终止阶段，决定编译驱动输出的内容。本文件不依赖 LLVM，客户端也会
+/// 包含它。
+enum struct Stage : std::uint8_t
+{
+  kTokens, /// 记号流
+  kAsg,    /// JSON 格式的 ASG
+  kAsgBin, /// 二进制格式的 ASG
+  kIr,     /// 优化前的 LLVM IR
+  kOpt,    /// 优化后的 LLVM IR
+};
+
+constexpr const char* kStageNames[] = {
+  "tokens", "asg", "asg-bin", "ir", "opt",
+};
+
+/// 按名字查找阶段，找不到时返回 false。
+inline bool
+parse_stage(const char* name, Stage& stage)
+{
+  for (std::size_t i = 0; i < std::size(kStageNames); ++i) {
+    if (std::strcmp(name, kStageNames[i]) == 0) {
+      stage = Stage(i);
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,104 @@
+#include "Protocol.hpp"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/un.h>
+#include <vector>
+
+/**
+ * 编译服务器的客户端。它只负责转发请求和写出结果，不链接 LLVM 与 ANTLR，
+ * 启动开销与普通的小程序相同。
+ */
+int
+main(int argc, char* argv[])
+{
+  proto::Request req;
+  req.mHasSource = true;
+  bool shutdownServer = false;
+  std::vector<std::string> positional;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.rfind("-emit=", 0) == 0) {
+      Stage stage;
+      if (!parse_stage(arg.c_str() + 6, stage)) {
+        std::cout << "Error: unknown stage: " << arg.substr(6) << '\n';
+        return -1;
+      }
+      req.mStage = std::uint8_t(stage);
+    } else if (arg == "-time-stages")
+      req.mTimeStages = true;
+    else if (arg == "-send-path")
+      req.mHasSource = false;
+    else if (arg == "-shutdown")
+      shutdownServer = true;
+    else
+      positional.push_back(std::move(arg));
+  }
+
+  if (positional.size() != (shutdownServer ? 1 : 3)) {
+    std::cout << "Usage: " << argv[0]
+              << " [-emit=<stage>] [-time-stages] [-send-path] <socket> "
+                 "<input> <output>\n"
+              << "       " << argv[0] << " -shutdown <socket>\n";
+    return -1;
+  }
+
+  if (shutdownServer)
+    req.mStage = proto::kShutdown;
+  else {
+    req.mPath = positional[1];
+    if (req.mHasSource) {
+      std::ifstream inFile(req.mPath, std::ios::binary);
+      if (!inFile) {
+        std::cout << "Error: unable to open input file: " << req.mPath
+                  << '\n';
+        return -2;
+      }
+      std::ostringstream ss;
+      ss << inFile.rdbuf();
+      req.mSource = std::move(ss).str();
+    }
+  }
+
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  auto& sockPath = positional[0];
+  if (sockPath.size() >= sizeof(addr.sun_path)) {
+    std::cout << "Error: socket path too long: " << sockPath << '\n';
+    return -1;
+  }
+  std::memcpy(addr.sun_path, sockPath.c_str(), sockPath.size() + 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 ||
+      connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    std::cout << "Error: unable to connect to server: " << sockPath << '\n';
+    return -4;
+  }
+
+  proto::Response res;
+  if (!proto::write_request(fd, req) || !proto::read_response(fd, res)) {
+    std::cout << "Error: connection to server lost\n";
+    close(fd);
+    return -4;
+  }
+  close(fd);
+
+  std::cerr << res.mLog;
+  if (shutdownServer)
+    return 0;
+
+  auto& outPath = positional[2];
+  if (outPath == "-")
+    std::cout << res.mOutput;
+  else {
+    std::ofstream outFile(outPath, std::ios::binary);
+    if (!outFile) {
+      std::cout << "Error: unable to open output file: " << outPath << '\n';
+      return -3;
+    }
+    outFile << res.mOutput;
+  }
+  return res.mRet;
+}
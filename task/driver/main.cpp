@@ -0,0 +1,186 @@
+#include "Compile.hpp"
+#include "Server.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <llvm/Support/CommandLine.h>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+llvm::cl::opt<std::string> gInputPath(llvm::cl::Positional,
+                                      llvm::cl::desc("<input>"));
+
+llvm::cl::opt<std::string> gOutputPath(llvm::cl::Positional,
+                                       llvm::cl::desc("<output>"));
+
+llvm::cl::opt<Stage> gEmit(
+  "emit",
+  llvm::cl::desc("输出哪个阶段的结果"),
+  llvm::cl::values(
+    clEnumValN(Stage::kTokens, kStageNames[0], "记号流"),
+    clEnumValN(Stage::kAsg, kStageNames[1], "JSON 格式的 ASG"),
+    clEnumValN(Stage::kAsgBin, kStageNames[2], "二进制格式的 ASG"),
+    clEnumValN(Stage::kIr, kStageNames[3], "优化前的 LLVM IR"),
+    clEnumValN(Stage::kOpt, kStageNames[4], "优化后的 LLVM IR（默认）")),
+  llvm::cl::init(Stage::kOpt));
+
+llvm::cl::opt<std::string> gBatch(
+  "batch",
+  llvm::cl::desc("批量编译清单中的全部文件，清单每行为“输入 输出”，以 # 开头"
+                 "的行为注释"),
+  llvm::cl::value_desc("manifest"));
+
+llvm::cl::opt<std::string> gServe(
+  "serve",
+  llvm::cl::desc("作为编译服务器在指定的 Unix 域套接字上监听请求"),
+  llvm::cl::value_desc("socket"));
+
+llvm::cl::opt<unsigned> gJobs(
+  "j",
+  llvm::cl::desc("批量编译或编译服务器的工作线程数，默认为硬件线程数"),
+  llvm::cl::init(0));
+
+llvm::cl::opt<std::string> gDumpTokens(
+  "dump-tokens",
+  llvm::cl::desc("把词法分析得到的记号流写到指定文件"),
+  llvm::cl::value_desc("path"));
+
+llvm::cl::opt<std::string> gDumpAsg(
+  "dump-asg",
+  llvm::cl::desc("把类型检查后的 ASG 写到指定文件，以 .asg 结尾时写出二进制"
+                 "格式，否则写出 JSON"),
+  llvm::cl::value_desc("path"));
+
+llvm::cl::opt<std::string> gDumpIr(
+  "dump-ir",
+  llvm::cl::desc("把优化前的 LLVM IR 写到指定文件"),
+  llvm::cl::value_desc("path"));
+
+llvm::cl::opt<bool> gTimeStages(
+  "time-stages",
+  llvm::cl::desc("打印各阶段的耗时"));
+
+unsigned
+num_threads()
+{
+  return gJobs ? gJobs : std::max(1u, std::thread::hardware_concurrency());
+}
+
+struct Job
+{
+  std::string mInput, mOutput;
+};
+
+/// 批量编译清单中的全部文件，返回失败的文件数。
+std::size_t
+run_batch(const std::vector<Job>& jobs, const CompileOptions& opts)
+{
+  unsigned nThreads = std::max(1u, std::min<unsigned>(num_threads(), jobs.size()));
+
+  std::atomic<std::size_t> next{ 0 }, failed{ 0 };
+  std::mutex logMutex;
+
+  auto worker = [&]() {
+    // 每个工作线程独占一个 LLVMContext 和一条优化流水线，在多个文件之间复用；
+    // ANTLR 的 DFA 缓存是按文法全局共享的，进程不退出就一直有效。
+    std::string logBuf;
+    llvm::raw_string_ostream log(logBuf);
+    llvm::LLVMContext ctx;
+    Optimizer optimizer(log);
+
+    for (std::size_t i; (i = next++) < jobs.size();) {
+      auto& job = jobs[i];
+      if (auto ret =
+            compile_file(job.mInput, job.mOutput, opts, ctx, optimizer, log)) {
+        ++failed;
+        log << "失败 " << job.mInput << " 返回码 " << ret << '\n';
+      }
+
+      // 按文件整段输出日志，避免不同线程的输出交错
+      std::lock_guard<std::mutex> lock(logMutex);
+      llvm::errs() << log.str();
+      logBuf.clear();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < nThreads; ++i)
+    threads.emplace_back(worker);
+  for (auto& i : threads)
+    i.join();
+
+  return failed;
+}
+
+} // namespace
+
+/**
+ * 编译驱动，有三种工作方式：
+ *
+ * - 单文件：编译 <input> 到 <output>；
+ * - 批量：读取 -batch 指定的清单，在 -j 个工作线程上编译其中的全部文件；
+ * - 服务器：在 -serve 指定的套接字上监听，由 driver-client 发来请求。
+ */
+int
+main(int argc, char* argv[])
+{
+  llvm::cl::ParseCommandLineOptions(argc, argv);
+
+  CompileOptions opts;
+  opts.mEmit = gEmit;
+  opts.mDumpTokens = gDumpTokens;
+  opts.mDumpAsg = gDumpAsg;
+  opts.mDumpIr = gDumpIr;
+  opts.mTimeStages = gTimeStages;
+
+  bool dumps = !gDumpTokens.empty() || !gDumpAsg.empty() || !gDumpIr.empty();
+  if (dumps && (!gBatch.empty() || !gServe.empty())) {
+    std::cout << "Error: -dump-* options are only supported for a single file\n";
+    return -1;
+  }
+
+  if (!gServe.empty())
+    return serve(gServe, num_threads());
+
+  if (gBatch.empty()) {
+    if (gInputPath.empty() || gOutputPath.empty()) {
+      std::cout << "Usage: " << argv[0] << " <input> <output>\n";
+      return -1;
+    }
+
+    llvm::LLVMContext ctx;
+    Optimizer optimizer;
+    return compile_file(
+      gInputPath, gOutputPath, opts, ctx, optimizer, llvm::errs());
+  }
+
+  std::ifstream manifest(gBatch);
+  if (!manifest) {
+    std::cout << "Error: unable to open manifest file: " << gBatch << '\n';
+    return -2;
+  }
+
+  std::vector<Job> jobs;
+  for (std::string line; std::getline(manifest, line);) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream ss(line);
+    Job job;
+    if (!(ss >> job.mInput))
+      continue; // 空白行
+    if (!(ss >> job.mOutput)) {
+      std::cout << "Error: invalid manifest line: " << line << '\n';
+      return -2;
+    }
+    jobs.push_back(std::move(job));
+  }
+
+  auto failed = run_batch(jobs, opts);
+  llvm::errs() << "共编译 " << jobs.size() << " 个文件，失败 " << failed
+               << " 个\n";
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,35 @@
+#include <sysy/sylib.h>
+
+int loopCount = 0;
+
+int func()
+{
+  int result = 0;
+  int k = 0;
+  while(k<loopCount)
+  {
+    int sum = 0;
+    int j = 0;
+    while(j<1000)
+    {
+      sum = sum + j * 3 + j * 5 + j * 6 + j * 7 + j * 9 + j * 10 + j * 12 + j * 15;
+      sum = sum + j * 17 + j * 18 + j * 20 + j * 24 + j * 31 + j * 33 + j * 36 + j * 40;
+      j = j + 1;
+    }
+    result = result + sum % 65536;
+    result = result % 1500000001;
+    k = k + 1;
+  }
+  return result;
+}
+
+int main()
+{
+  loopCount = getint();
+  starttime();
+  int result = func();
+  stoptime();
+  putint(result);
+  putch(10);
+  return 0;
+}
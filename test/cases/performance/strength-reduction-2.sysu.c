@@ -0,0 +1,42 @@
+#include <sysy/sylib.h>
+
+int loopCount = 0;
+int a[100000];
+
+int func()
+{
+  int result = 0;
+  int k = 0;
+  while(k<loopCount)
+  {
+    int i = 0;
+    while(i<1000)
+    {
+      a[i * 10] = a[i * 10] + i * 3;
+      a[i * 10 + 1] = a[i * 10 + 1] + i * 5;
+      a[i * 10 + 2] = a[i * 10 + 2] + i * 9;
+      a[i * 10 + 3] = a[i * 10 + 3] + i * 15;
+      a[i * 10 + 4] = a[i * 10 + 4] + i * 17;
+      a[i * 10 + 5] = a[i * 10 + 5] + i * 31;
+      a[i * 10 + 6] = a[i * 10 + 6] + i * 33;
+      a[i * 10 + 7] = a[i * 10 + 7] + i * 63;
+      a[i * 10 + 8] = a[i * 10 + 8] + i * 65;
+      a[i * 10 + 9] = a[i * 10 + 9] + i * 127;
+      i = i + 1;
+    }
+    result = (result + a[k % 10000]) % 65536;
+    k = k + 1;
+  }
+  return result;
+}
+
+int main()
+{
+  loopCount = getint();
+  starttime();
+  int result = func();
+  stoptime();
+  putint(result);
+  putch(10);
+  return 0;
+}
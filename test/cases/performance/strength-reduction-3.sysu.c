@@ -0,0 +1,37 @@
+#include <sysy/sylib.h>
+
+int loopCount = 0;
+
+int func(int seed)
+{
+  int h1 = 5381;
+  int h2 = 0;
+  int h3 = 1;
+  int h4 = 7;
+  int i = 0;
+  while(i<loopCount)
+  {
+    int x = (seed + i) % 65521;
+    h1 = (h1 * 33 + x) % 65521;
+    h2 = (h2 * 31 + x) % 65521;
+    h3 = (h3 * 129 + x) % 65521;
+    h4 = (h4 * 255 + x) % 65521;
+    h1 = (h1 * 257 + h2) % 65521;
+    h2 = (h2 * 1023 + h3) % 65521;
+    h3 = (h3 * 4097 + h4) % 65521;
+    h4 = (h4 * 17 + h1) % 65521;
+    i = i + 1;
+  }
+  return h1 + h2 + h3 + h4;
+}
+
+int main()
+{
+  loopCount = getint();
+  starttime();
+  int result = func(getint());
+  stoptime();
+  putint(result);
+  putch(10);
+  return 0;
+}
@@ -0,0 +1,90 @@
+"""比较编译服务器与每次启动新进程两种方式的单文件编译延迟。
+
+对测例表中的每个测例，分别用 `driver <input> <output>` 和
+`driver-client <socket> <input> <output>` 编译若干次，取最小耗时。
+"""
+
+import os
+import sys
+import time
+import argparse
+import tempfile
+import subprocess as subps
+import os.path as osp
+
+sys.path.append(osp.abspath(__file__ + "/../.."))
+from common import CasesHelper, print_parsed_args
+
+
+def min_time(cmd: list[str], repeat: int) -> float:
+    """运行命令若干次，返回最小耗时（毫秒），失败时返回负数"""
+
+    best = None
+    for _ in range(repeat):
+        start = time.perf_counter()
+        result = subps.run(cmd, stdout=subps.DEVNULL, stderr=subps.DEVNULL)
+        elapsed = (time.perf_counter() - start) * 1000
+        if result.returncode != 0:
+            return -1.0
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser("编译服务器延迟测试", description=__doc__)
+    parser.add_argument("srcdir", type=str, help="测例目录")
+    parser.add_argument("bindir", type=str, help="输出目录")
+    parser.add_argument("cases_file", type=str, help="测例表路径")
+    parser.add_argument("task0_bindir", type=str, help="实验零标准答案目录")
+    parser.add_argument("driver_exe", type=str, help="driver 程序路径")
+    parser.add_argument("client_exe", type=str, help="driver-client 程序路径")
+    parser.add_argument("--repeat", type=int, default=5, help="每个测例的重复次数")
+    args = parser.parse_args()
+    print_parsed_args(parser, args)
+
+    print("加载测例表...", end="", flush=True)
+    cases_helper = CasesHelper.load_file(
+        args.srcdir,
+        args.bindir,
+        args.cases_file,
+    )
+    print("完成")
+
+    sock_dir = tempfile.mkdtemp()
+    sock = osp.join(sock_dir, "driver.sock")
+    server = subps.Popen(
+        [args.driver_exe, f"-serve={sock}"], stdout=subps.DEVNULL, stderr=subps.DEVNULL
+    )
+    while not osp.exists(sock):
+        if server.poll() is not None:
+            print("编译服务器启动失败")
+            sys.exit(1)
+        time.sleep(0.01)
+
+    total_fresh, total_server, count = 0.0, 0.0, 0
+    try:
+        print()
+        print(f"{'测例':<54}{'新进程(ms)':>14}{'服务器(ms)':>14}")
+        for case in cases_helper.cases:
+            input_path = osp.join(args.task0_bindir, case.name)
+            output_path = cases_helper.of_case_bindir("latency.ll", case, True)
+            fresh = min_time([args.driver_exe, input_path, output_path], args.repeat)
+            served = min_time(
+                [args.client_exe, sock, input_path, output_path], args.repeat
+            )
+            if fresh < 0 or served < 0:
+                print(f"{case.name:<56}  编译失败")
+                continue
+            total_fresh += fresh
+            total_server += served
+            count += 1
+            print(f"{case.name:<56}{fresh:>14.2f}{served:>14.2f}")
+    finally:
+        subps.run([args.client_exe, "-shutdown", sock])
+        server.wait()
+        os.rmdir(sock_dir)
+
+    print("=" * 84)
+    print(f"{'总计（' + str(count) + ' 个测例）':<52}{total_fresh:>14.2f}{total_server:>14.2f}")
+    if total_server > 0:
+        print(f"加速比：{total_fresh / total_server:.2f}")
@@ -0,0 +1,110 @@
+"""对实验三的各个阶段计时：以实验二的标准答案（JSON）为输入多次运行 task3，
+取每个阶段的最小耗时，用于比较 Json2Asg 等阶段在优化前后的性能。
+
+如果给出了 task2 程序，还会用它把实验零的预处理结果编译为二进制格式的 ASG
+（.asg 文件），比较两种格式的文件大小与加载耗时。
+
+参考数据：以全部 112 个测例（JSON 共 54.5MB）、每个测例重复 10 次取最小值，
+json 阶段合计约 6.9-7.5s，json2asg 约 0.39-0.43s，emit 与 print 各约 0.08s
+与 0.13s。Json2Asg 的种类分派改为 switch、十六进制 id 就地解析、类型表改
+为 StringMap 前后，json2asg 的差别在几次运行之间的波动以内（前 386-443ms，
+后 403-455ms），最大的单个测例（8.3MB）上后者还慢 2%-4%。json2asg 在每个
+结点上约花 0.5us，种类分派与 id 解析只占其中很小一部分，整体的瓶颈在 json
+阶段的解析。以上为 LLVM 14、clang 14 生成的 JSON 在单核机器上的结果。
+"""
+
+import re
+import sys
+import argparse
+import subprocess as subps
+import os.path as osp
+
+sys.path.append(osp.abspath(__file__ + "/../.."))
+from common import CasesHelper, print_parsed_args
+
+STAGES = ("json", "json2asg", "bin2asg", "emit", "print")
+
+
+def bench_one(
+    task3_exe: str, input_path: str, output_path: str, repeat: int
+) -> dict[str, int]:
+    """对单个输入计时，返回各阶段的最小耗时（微秒）"""
+
+    best: dict[str, int] = {}
+    for _ in range(repeat):
+        result = subps.run(
+            [task3_exe, "-time-stages", input_path, output_path],
+            stdout=subps.DEVNULL,
+            stderr=subps.PIPE,
+        )
+        if result.returncode != 0:
+            raise RuntimeError(f"task3 返回码 {result.returncode}")
+        err = result.stderr.decode("utf-8")
+        for stage, us in re.findall("阶段 (\\w+) 耗时 (\\d+)us", err):
+            us = int(us)
+            best[stage] = min(best.get(stage, us), us)
+    return best
+
+
+def print_row(name: str, size: int, best: dict[str, int]):
+    print(f"{name:<56}{size:>12}" + "".join(f"{best.get(i, 0):>10}" for i in STAGES))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser("实验三阶段计时脚本", description=__doc__)
+    parser.add_argument("srcdir", type=str, help="测例目录")
+    parser.add_argument("bindir", type=str, help="测评输出目录")
+    parser.add_argument("cases_file", type=str, help="测例表路径")
+    parser.add_argument("task2_bindir", type=str, help="实验二标准答案目录")
+    parser.add_argument("task3_exe", type=str, help="task3 程序路径")
+    parser.add_argument("--repeat", type=int, default=5, help="每个测例的重复次数")
+    parser.add_argument("--task0-bindir", type=str, help="实验零标准答案目录")
+    parser.add_argument("--task2-exe", type=str, help="用于生成 .asg 的 task2 程序")
+    args = parser.parse_args()
+    print_parsed_args(parser, args)
+
+    print("加载测例表...", end="", flush=True)
+    cases_helper = CasesHelper.load_file(
+        args.srcdir,
+        args.bindir,
+        args.cases_file,
+    )
+    print("完成")
+
+    inputs = {"json": (0, dict.fromkeys(STAGES, 0))}
+    if args.task2_exe and args.task0_bindir:
+        inputs["asg"] = (0, dict.fromkeys(STAGES, 0))
+
+    print()
+    print(f"{'输入':<54}{'字节数':>9}" + "".join(f"{i:>10}" for i in STAGES))
+    for case in cases_helper.cases:
+        paths = {"json": osp.join(args.task2_bindir, case.name, "answer.json")}
+        if "asg" in inputs:
+            paths["asg"] = cases_helper.of_case_bindir("bench.asg", case, True)
+            subps.run(
+                [args.task2_exe, osp.join(args.task0_bindir, case.name), paths["asg"]],
+                stdout=subps.DEVNULL,
+                stderr=subps.DEVNULL,
+            )
+
+        output_path = cases_helper.of_case_bindir("bench.ll", case, True)
+        for fmt, input_path in paths.items():
+            name = f"{case.name} ({fmt})"
+            if not osp.exists(input_path):
+                print(f"{name:<56}  没有输入文件")
+                continue
+            try:
+                best = bench_one(args.task3_exe, input_path, output_path, args.repeat)
+            except RuntimeError as e:
+                print(f"{name:<56}  {e}")
+                continue
+            size = osp.getsize(input_path)
+            total_size, total = inputs[fmt]
+            for i in STAGES:
+                total[i] += best.get(i, 0)
+            inputs[fmt] = (total_size + size, total)
+            print_row(name, size, best)
+
+    print("=" * (56 + 12 + 10 * len(STAGES)))
+    for fmt, (size, total) in inputs.items():
+        print_row(f"总计 ({fmt})", size, total)
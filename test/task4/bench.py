@@ -0,0 +1,89 @@
+"""比较实验三到实验四之间用文本（.ll）与位码（.bc）传递 LLVM IR 的耗时：以实
+验二的标准答案（JSON）为输入，分别以两种格式运行 task3 与 task4，多次运行取
+最小的墙钟时间。
+"""
+
+import sys
+import time
+import argparse
+import subprocess as subps
+import os.path as osp
+
+sys.path.append(osp.abspath(__file__ + "/../.."))
+from common import CasesHelper, print_parsed_args
+
+FORMATS = ("ll", "bc")
+
+
+def run_best(cmd: list[str], repeat: int) -> int:
+    """多次运行 cmd，返回最小耗时（微秒）"""
+
+    best = None
+    for _ in range(repeat):
+        start = time.perf_counter()
+        result = subps.run(cmd, stdout=subps.DEVNULL, stderr=subps.DEVNULL)
+        us = int((time.perf_counter() - start) * 1000000)
+        if result.returncode != 0:
+            raise RuntimeError(f"{osp.basename(cmd[0])} 返回码 {result.returncode}")
+        best = us if best is None else min(best, us)
+    return best
+
+
+def print_row(name: str, size: int, task3_us: int, task4_us: int):
+    print(f"{name:<56}{size:>12}{task3_us:>12}{task4_us:>12}{task3_us + task4_us:>12}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser("实验四 IR 格式计时脚本", description=__doc__)
+    parser.add_argument("srcdir", type=str, help="测例目录")
+    parser.add_argument("bindir", type=str, help="测评输出目录")
+    parser.add_argument("cases_file", type=str, help="测例表路径")
+    parser.add_argument("task2_bindir", type=str, help="实验二标准答案目录")
+    parser.add_argument("task3_exe", type=str, help="task3 程序路径")
+    parser.add_argument("task4_exe", type=str, help="task4 程序路径")
+    parser.add_argument("--repeat", type=int, default=5, help="每个测例的重复次数")
+    args = parser.parse_args()
+    print_parsed_args(parser, args)
+
+    print("加载测例表...", end="", flush=True)
+    cases_helper = CasesHelper.load_file(
+        args.srcdir,
+        args.bindir,
+        args.cases_file,
+    )
+    print("完成")
+
+    totals = {fmt: [0, 0, 0] for fmt in FORMATS}
+
+    print()
+    print(f"{'输入':<54}{'字节数':>9}{'task3':>12}{'task4':>12}{'合计':>10}")
+    for case in cases_helper.cases:
+        input_path = osp.join(args.task2_bindir, case.name, "answer.json")
+        if not osp.exists(input_path):
+            print(f"{case.name:<56}  没有输入文件")
+            continue
+
+        for fmt in FORMATS:
+            name = f"{case.name} ({fmt})"
+            ir_path = cases_helper.of_case_bindir(f"bench.{fmt}", case, True)
+            opt_path = cases_helper.of_case_bindir(f"bench-opt.{fmt}", case, True)
+            try:
+                task3_us = run_best(
+                    [args.task3_exe, input_path, ir_path], args.repeat
+                )
+                task4_us = run_best(
+                    [args.task4_exe, ir_path, opt_path], args.repeat
+                )
+            except RuntimeError as e:
+                print(f"{name:<56}  {e}")
+                continue
+            size = osp.getsize(ir_path)
+            total = totals[fmt]
+            total[0] += size
+            total[1] += task3_us
+            total[2] += task4_us
+            print_row(name, size, task3_us, task4_us)
+
+    print("=" * (56 + 12 * 4))
+    for fmt, (size, task3_us, task4_us) in totals.items():
+        print_row(f"总计 ({fmt})", size, task3_us, task4_us)
@@ -0,0 +1,153 @@
+"""比较几种运行测例的方式从输入到得出结果的墙钟时间：
+
+- vm：task3 -interp 直接解释执行实验二的标准答案；
+- tier：task3 -tier 先解释执行，热点函数在后台编译为本机代码，需要以
+  TASK3_TIER=ON 配置，否则这一列全部失败；
+- base：task3 -baseline 不经过 LLVM，把字节码直接翻译为机器码运行；
+- jit：task3 翻译为位码，再用 task4 -run 在进程内优化并运行；
+- aot：task3 翻译为位码，task4 -exe 优化并链接为可执行文件，再运行它。
+
+每种方式的时间都从读入 JSON 开始算起，包含各自的翻译与编译开销，并核对标准
+输出与返回码是否与实验四的标准答案一致。
+"""
+
+import re
+import sys
+import time
+import argparse
+import subprocess as subps
+import os.path as osp
+
+sys.path.append(osp.abspath(__file__ + "/../.."))
+from common import CasesHelper, print_parsed_args
+
+MODES = ("vm", "tier", "base", "jit", "aot")
+
+# 只用 task3 就能运行的方式
+TASK3_FLAGS = {"vm": "-interp", "tier": "-tier", "base": "-baseline"}
+
+
+class Mismatch(Exception):
+    pass
+
+
+def run_timed(cmd: list[str], input_path: str, timeout: int) -> tuple[int, bytes, int]:
+    """运行 cmd，返回耗时（微秒）、标准输出和返回码"""
+
+    with open(input_path or osp.devnull, "rb") as fin:
+        start = time.perf_counter()
+        result = subps.run(
+            cmd, stdin=fin, stdout=subps.PIPE, stderr=subps.DEVNULL, timeout=timeout
+        )
+        us = int((time.perf_counter() - start) * 1000000)
+    return us, result.stdout, result.returncode
+
+
+def run_checked(cmd: list[str], timeout: int) -> int:
+    """运行编译步骤，失败时抛出异常，返回耗时（微秒）"""
+
+    us, _, ret = run_timed(cmd, None, timeout)
+    if ret != 0:
+        raise Mismatch(f"{osp.basename(cmd[0])} 返回码 {ret}")
+    return us
+
+
+def run_mode(mode: str, case, json_path: str, expect) -> int:
+    """以 mode 方式运行测例，结果不对时抛出异常，返回总耗时（微秒）"""
+
+    bc_path = cases_helper.of_case_bindir("exec-bench.bc", case, True)
+    exe_path = cases_helper.of_case_bindir("exec-bench.exe", case, True)
+
+    us = 0
+    if mode in TASK3_FLAGS:
+        cmd = [args.task3_exe, TASK3_FLAGS[mode], json_path]
+    else:
+        us += run_checked([args.task3_exe, json_path, bc_path], args.timeout)
+        if mode == "jit":
+            cmd = [args.task4_exe, "-run", bc_path, osp.devnull]
+        else:
+            us += run_checked(
+                [args.task4_exe, "-exe", exe_path, bc_path, osp.devnull], args.timeout
+            )
+            cmd = [exe_path]
+
+    run_us, out, ret = run_timed(cmd, case.input, args.timeout)
+    if (out, ret & 0xFF) != expect:
+        raise Mismatch(f"结果与标准答案不符（返回码 {ret}）")
+    return us + run_us
+
+
+def load_expect(case) -> tuple[bytes, int]:
+    """读取实验四标准答案的输出与返回码"""
+
+    with open(cases_helper.of_case_bindir("answer.out", case), "rb") as f:
+        out = f.read()
+    with open(cases_helper.of_case_bindir("answer.err", case), "r") as f:
+        ret = re.findall("Return Code: (\\d*)", f.read())
+    return out, int(ret[-1]) & 0xFF
+
+
+def print_row(name: str, cols: list):
+    cells = "".join(f"{c:>14}" for c in cols)
+    print(f"{name:<56}{cells}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser("实验四运行方式计时脚本", description=__doc__)
+    parser.add_argument("srcdir", type=str, help="测例目录")
+    parser.add_argument("bindir", type=str, help="测评输出目录")
+    parser.add_argument("cases_file", type=str, help="测例表路径")
+    parser.add_argument("task2_bindir", type=str, help="实验二标准答案目录")
+    parser.add_argument("task3_exe", type=str, help="task3 程序路径")
+    parser.add_argument("task4_exe", type=str, help="task4 程序路径")
+    parser.add_argument(
+        "--filter",
+        type=str,
+        default="^(functional|mini-performance)",
+        help="只运行名字匹配该正则表达式的测例",
+    )
+    parser.add_argument("--timeout", type=int, default=60, help="每一步的超时秒数")
+    args = parser.parse_args()
+    print_parsed_args(parser, args)
+
+    print("加载测例表...", end="", flush=True)
+    cases_helper = CasesHelper.load_file(
+        args.srcdir,
+        args.bindir,
+        args.cases_file,
+    )
+    print("完成")
+
+    totals = {mode: 0 for mode in MODES}
+    failed = {mode: 0 for mode in MODES}
+
+    print()
+    print_row("测例", [f"{mode} (us)" for mode in MODES])
+    for case in cases_helper.cases:
+        if not re.search(args.filter, case.name):
+            continue
+        json_path = osp.join(args.task2_bindir, case.name, "answer.json")
+        try:
+            expect = load_expect(case)
+        except (OSError, IndexError):
+            print(f"{case.name:<56}  没有标准答案")
+            continue
+        if not osp.exists(json_path):
+            print(f"{case.name:<56}  没有输入文件")
+            continue
+
+        cols = []
+        for mode in MODES:
+            try:
+                us = run_mode(mode, case, json_path, expect)
+                totals[mode] += us
+                cols.append(us)
+            except (Mismatch, subps.TimeoutExpired) as e:
+                failed[mode] += 1
+                cols.append("失败")
+                print(f"{case.name} ({mode}): {e}", file=sys.stderr)
+        print_row(case.name, cols)
+
+    print("=" * (56 + 14 * len(MODES)))
+    print_row("总计", [totals[mode] for mode in MODES])
+    print_row("失败", [failed[mode] for mode in MODES])
@@ -0,0 +1,109 @@
+"""增量编译的回归测试：修改 main 后重新编译，复用缓存中的 init。
+
+init 写入的全局变量只由 main 读取。第一次编译时 main 不读取它，如果优化流水
+线据此认为它只写不读，缓存的 init 中的写入就会被删除；第二次编译只重新优化
+main，运行结果便不再是 init 写入的值。
+
+最后用同样的输入和缓存再编译一次并指定 -exe，此时整个输出都在缓存中，仍然
+必须生成可执行文件。另外，同样的输入放在不同的目录中编译，整个文件的缓存项
+要能共享。
+"""
+
+import os
+import sys
+import shutil
+import subprocess as subps
+import os.path as osp
+
+INIT = """\
+@g = global i32 0
+
+define void @init() {
+entry:
+  store i32 42, ptr @g
+  ret void
+}
+"""
+
+# 只有 main 在两个版本之间改变
+MAIN_V1 = """
+define i32 @main() {
+entry:
+  call void @init()
+  ret i32 0
+}
+"""
+
+MAIN_V2 = """
+define i32 @main() {
+entry:
+  call void @init()
+  %v = load i32, ptr @g
+  ret i32 %v
+}
+"""
+
+
+def main(task4: str, work_dir: str) -> int:
+    cache_dir = osp.join(work_dir, "cache")
+    shutil.rmtree(cache_dir, ignore_errors=True)
+
+    for ver, body in (("v1", MAIN_V1), ("v2", MAIN_V2)):
+        input_path = osp.join(work_dir, ver + ".ll")
+        with open(input_path, "w") as f:
+            f.write(INIT + body)
+        output_path = osp.join(work_dir, ver + ".out.ll")
+        cmd = [task4, "-incremental", "-cache-dir", cache_dir, input_path, output_path]
+        if subps.run(cmd, stderr=subps.DEVNULL).returncode != 0:
+            print("编译失败：", " ".join(cmd))
+            return 1
+
+    ret = subps.run([task4, "-no-opt", "-run", output_path, osp.devnull]).returncode
+    if ret != 42:
+        print(f"返回值为 {ret}，应为 42：init 对 @g 的写入丢失")
+        return 1
+
+    exe_path = osp.join(work_dir, "v2.exe")
+    if osp.exists(exe_path):
+        os.remove(exe_path)
+    cmd = [task4, "-incremental", "-cache-dir", cache_dir, "-exe", exe_path,
+           input_path, output_path]
+    if subps.run(cmd, stderr=subps.DEVNULL).returncode != 0:
+        print("编译失败：", " ".join(cmd))
+        return 1
+    if not osp.exists(exe_path):
+        print("缓存命中时没有生成可执行文件：", " ".join(cmd))
+        return 1
+    ret = subps.run([exe_path]).returncode
+    if ret != 42:
+        print(f"可执行文件的返回值为 {ret}，应为 42")
+        return 1
+
+    # 输出中不含输入路径，两个目录中的同一份输入命中同一个缓存项
+    shared_dir = osp.join(work_dir, "shared")
+    shutil.rmtree(shared_dir, ignore_errors=True)
+    outputs = []
+    for sub in ("a", "b"):
+        os.makedirs(osp.join(shared_dir, sub))
+        input_path = osp.join(shared_dir, sub, "v2.ll")
+        shutil.copy(osp.join(work_dir, "v2.ll"), input_path)
+        output_path = osp.join(shared_dir, sub, "v2.out.ll")
+        cmd = [task4, "-cache-dir", osp.join(shared_dir, "cache"), "-cache-stats",
+               input_path, output_path]
+        res = subps.run(cmd, stderr=subps.PIPE, text=True)
+        if res.returncode != 0:
+            print("编译失败：", " ".join(cmd))
+            return 1
+        with open(output_path) as f:
+            outputs.append(f.read())
+    if "累计命中 1 次" not in res.stderr:
+        print("不同目录中的相同输入没有命中缓存：", res.stderr.strip())
+        return 1
+    if outputs[0] != outputs[1]:
+        print("不同目录中的相同输入得到了不同的输出")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1], sys.argv[2]))
@@ -0,0 +1,53 @@
+"""SCCP 的回归测试：跳转的条件定义在布局靠后的块中。
+
+use 块排在 def 块前面，而 use 的条件跳转依赖 def 中算出的 %c。如果逐块替换
+常量、逐块折叠跳转，处理 use 时 %c 还没有被替换，跳转不会折叠，no 块却因为
+不可达被删除，use 就跳到了已删除的块。
+"""
+
+import sys
+import subprocess as subps
+import os.path as osp
+
+INPUT = """\
+define i32 @main() {
+entry:
+  br label %def
+
+use:
+  br i1 %c, label %yes, label %no
+
+yes:
+  ret i32 42
+
+no:
+  ret i32 7
+
+def:
+  %x = add i32 3, 4
+  %c = icmp slt i32 %x, 10
+  br label %use
+}
+"""
+
+
+def main(task4: str, work_dir: str) -> int:
+    input_path = osp.join(work_dir, "sccp.ll")
+    with open(input_path, "w") as f:
+        f.write(INPUT)
+    output_path = osp.join(work_dir, "sccp.out.ll")
+    cmd = [task4, input_path, output_path]
+    ret = subps.run(cmd, stderr=subps.DEVNULL).returncode
+    if ret != 0:
+        print(f"编译失败，返回值为 {ret}：", " ".join(cmd))
+        return 1
+
+    ret = subps.run([task4, "-no-opt", "-run", output_path, osp.devnull]).returncode
+    if ret != 42:
+        print(f"返回值为 {ret}，应为 42")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1], sys.argv[2]))
@@ -12,6 +12,7 @@ from common import CasesHelper, ScoreReport, print_parsed_args
 TIME_OUT: int = 10
 COMP_PATH: str = None
 RTLIB_PATH: str = None
+JIT_PATH: str = None
 
 
 class Error(Exception):
@@ -86,32 +87,36 @@ def score_one(
                 fprint("运行时库不存在， 点击test-rtlib生成：", RTLIB_PATH)
                 raise Error()
 
-            # 尝试编译学生答案
+            # 尝试编译学生答案，用 task4 -run 在进程内运行时不需要编译
             output_exe_path = cases_helper.of_case_bindir("output.exe", case)
-            try:
-                with open(
-                    cases_helper.of_case_bindir("output.compile", case),
-                    "w",
-                    encoding="utf-8",
-                ) as f:
-                    subps.run(
-                        [
-                            COMP_PATH,
-                            "-o",
-                            output_exe_path,
-                            "-O0",
-                            RTLIB_PATH,
-                            judge_answer_path,
-                        ],
-                        stdout=f,
-                        stderr=f,
-                        timeout=TIME_OUT,
-                    )
-            except Exception as e:
-                output = "编译输出结果时出错"
-                fprint("编译输出结果时出错：", e)
-                fprint("出错行数：", e.__traceback__.tb_lineno)
-                raise Error(e)
+            if JIT_PATH:
+                run_cmd = [JIT_PATH, "-run", "-no-opt", judge_answer_path, osp.devnull]
+            else:
+                run_cmd = [output_exe_path]
+                try:
+                    with open(
+                        cases_helper.of_case_bindir("output.compile", case),
+                        "w",
+                        encoding="utf-8",
+                    ) as f:
+                        subps.run(
+                            [
+                                COMP_PATH,
+                                "-o",
+                                output_exe_path,
+                                "-O0",
+                                RTLIB_PATH,
+                                judge_answer_path,
+                            ],
+                            stdout=f,
+                            stderr=f,
+                            timeout=TIME_OUT,
+                        )
+                except Exception as e:
+                    output = "编译输出结果时出错"
+                    fprint("编译输出结果时出错：", e)
+                    fprint("出错行数：", e.__traceback__.tb_lineno)
+                    raise Error(e)
 
             # 尝试运行用户答案
             try:
@@ -121,7 +126,7 @@ def score_one(
                     output_err_path, "w", encoding="utf-8"
                 ) as ferr:
                     retn = subps.run(
-                        [output_exe_path],
+                        run_cmd,
                         stdin=input_fp,
                         stdout=f,
                         stderr=ferr,
@@ -249,6 +254,9 @@ if __name__ == "__main__":
     parser.add_argument("comp_path", type=str, help="编译器路径")
     parser.add_argument("rtlib_path", type=str, help="运行时库路径")
     parser.add_argument("--single", type=str, help="运行单个测例")
+    parser.add_argument(
+        "--jit", type=str, help="用此 task4 程序的 -run 在进程内运行答案，不再调用编译器"
+    )
     args = parser.parse_args()
     print_parsed_args(parser, args)
 
@@ -262,6 +270,7 @@ if __name__ == "__main__":
 
     COMP_PATH = args.comp_path
     RTLIB_PATH = args.rtlib_path
+    JIT_PATH = args.jit
 
     if case_name := args.single:
         for case in cases_helper.cases: